@@ -0,0 +1,255 @@
+/*++
+
+Module Name:
+
+    goodixsim.c
+
+Abstract:
+
+    Register-level model of a GT9xx controller; see goodixsim.h.
+
+Environment:
+
+    Kernel mode or user mode
+
+--*/
+
+#include "goodixsim.h"
+
+#define GOODIX_SIM_REG(Sim, Address)    ((Sim)->Registers[(Address) - GOODIX_SIM_REG_FIRST])
+
+UCHAR
+GoodixSimConfigChecksum(
+    _In_reads_bytes_(GOODIX_CONFIG_LENGTH) const UCHAR* Config
+)
+{
+    return GoodixConfigChecksum(Config);
+}
+
+VOID
+GoodixSimInit(
+    _Out_ PGOODIX_SIM Sim,
+    _In_ USHORT XResolution,
+    _In_ USHORT YResolution,
+    _In_ UCHAR MaxContacts
+)
+/*++
+
+  Routine Description:
+
+    Puts the model in its power-on state: an empty point buffer, a valid
+    configuration block for the given resolution and contact count, and
+    the identification registers of a GT911.
+
+  Arguments:
+
+    Sim - the model
+
+    XResolution - X output maximum reported in the configuration
+
+    YResolution - Y output maximum reported in the configuration
+
+    MaxContacts - touch number reported in the configuration
+
+--*/
+{
+    PUCHAR config;
+
+    RtlZeroMemory(Sim, sizeof(GOODIX_SIM));
+
+    config = &GOODIX_SIM_REG(Sim, GOODIX_REG_CONFIG);
+    config[0] = 0x41;                               // config version
+    config[1] = (UCHAR)XResolution;
+    config[2] = (UCHAR)(XResolution >> 8);
+    config[3] = (UCHAR)YResolution;
+    config[4] = (UCHAR)(YResolution >> 8);
+    config[5] = (UCHAR)min(MaxContacts, MAX_POINT_NUM);
+    config[6] = 0x0D;                               // module switch 1: falling edge INT
+    GOODIX_SIM_REG(Sim, GOODIX_REG_CONFIG_CHECKSUM) = GoodixSimConfigChecksum(config);
+
+    RtlCopyMemory(&GOODIX_SIM_REG(Sim, GOODIX_REG_PRODUCT_ID), "911", GOODIX_PRODUCT_ID_LENGTH);
+    GOODIX_SIM_REG(Sim, GOODIX_REG_FW_VERSION) = 0x60;
+    GOODIX_SIM_REG(Sim, GOODIX_REG_FW_VERSION + 1) = 0x10;
+    GOODIX_SIM_REG(Sim, GOODIX_REG_X_RESOLUTION) = (UCHAR)XResolution;
+    GOODIX_SIM_REG(Sim, GOODIX_REG_X_RESOLUTION + 1) = (UCHAR)(XResolution >> 8);
+    GOODIX_SIM_REG(Sim, GOODIX_REG_Y_RESOLUTION) = (UCHAR)YResolution;
+    GOODIX_SIM_REG(Sim, GOODIX_REG_Y_RESOLUTION + 1) = (UCHAR)(YResolution >> 8);
+}
+
+NTSTATUS
+GoodixSimTransfer(
+    _Inout_ PGOODIX_SIM Sim,
+    _In_reads_bytes_(TxLength) const UCHAR* TxBuffer,
+    _In_ ULONG TxLength,
+    _Out_writes_bytes_opt_(RxLength) PUCHAR RxBuffer,
+    _In_ ULONG RxLength
+)
+/*++
+
+  Routine Description:
+
+    Runs one bus transfer against the model. TxBuffer starts with the
+    16-bit register address; any bytes after it are written from that
+    address up. If RxLength is non-zero, RxLength bytes are then read back
+    from the same address, as with a write-then-read sequence.
+
+    Writing a status byte without GOODIX_TOUCH_EVENT releases the point
+    buffer for the next scan, and setting GOODIX_REG_CONFIG_FRESH submits
+    the configuration block, which is only accepted with a valid checksum.
+    The identification registers are read-only.
+
+  Arguments:
+
+    Sim - the model
+
+    TxBuffer - register address followed by the data to write
+
+    TxLength - length of TxBuffer in bytes
+
+    RxBuffer - receives the data read, if any
+
+    RxLength - number of bytes to read
+
+  Return Value:
+
+    STATUS_SUCCESS, or STATUS_INVALID_PARAMETER for a transfer the
+    controller would not acknowledge.
+
+--*/
+{
+    ULONG address;
+    ULONG writeLength;
+
+    if (TxLength < GOODIX_ADDR_LEN)
+        return STATUS_INVALID_PARAMETER;
+
+    address = ((ULONG)TxBuffer[0] << 8) | TxBuffer[1];
+    writeLength = TxLength - GOODIX_ADDR_LEN;
+
+    if (address < GOODIX_SIM_REG_FIRST ||
+        address + max(writeLength, RxLength) > GOODIX_SIM_REG_LAST + 1)
+        return STATUS_INVALID_PARAMETER;
+
+    if (RxLength != 0 && RxBuffer == NULL)
+        return STATUS_INVALID_PARAMETER;
+
+    for (ULONG i = 0; i < writeLength; i++)
+    {
+        ULONG reg = address + i;
+        UCHAR value = TxBuffer[GOODIX_ADDR_LEN + i];
+
+        if (reg >= GOODIX_REG_PRODUCT_ID && reg < TOUCH_INFO_ADDR)
+            continue;
+
+        if (reg == TOUCH_INFO_ADDR && (value & GOODIX_TOUCH_EVENT) == 0)
+        {
+            if (Sim->IgnoreClears != 0)
+            {
+                Sim->IgnoreClears--;
+                continue;
+            }
+
+            Sim->Clears++;
+        }
+
+        GOODIX_SIM_REG(Sim, reg) = value;
+
+        if (reg == GOODIX_REG_CONFIG_FRESH && value != 0)
+        {
+            if (GoodixSimConfigChecksum(&GOODIX_SIM_REG(Sim, GOODIX_REG_CONFIG)) ==
+                GOODIX_SIM_REG(Sim, GOODIX_REG_CONFIG_CHECKSUM))
+                Sim->ConfigUpdates++;
+            else
+                Sim->ConfigRejected++;
+
+            GOODIX_SIM_REG(Sim, GOODIX_REG_CONFIG_FRESH) = 0;
+        }
+    }
+
+    if (writeLength != 0)
+        Sim->Writes++;
+
+    if (RxLength != 0)
+    {
+        RtlCopyMemory(RxBuffer, &GOODIX_SIM_REG(Sim, address), RxLength);
+        Sim->Reads++;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+GoodixSimScan(
+    _Inout_ PGOODIX_SIM Sim,
+    _In_reads_(Count) const GOODIX_SIM_CONTACT* Contacts,
+    _In_ UCHAR Count
+)
+/*++
+
+  Routine Description:
+
+    Completes one scan with the given contacts. As on the real part, the
+    point buffer and its checksum are only refreshed once the host has
+    cleared the previous frame; otherwise the old frame is left in place
+    and the scan is counted in FramesHeld. The interrupt line fires for
+    every scan unless the screen-off command has been issued; in doze it
+    only fires for scans that see a contact.
+
+  Arguments:
+
+    Sim - the model
+
+    Contacts - contacts seen by the scan
+
+    Count - number of entries in Contacts
+
+--*/
+{
+    PUCHAR status = &GOODIX_SIM_REG(Sim, TOUCH_INFO_ADDR);
+    UCHAR limit = GOODIX_SIM_REG(Sim, GOODIX_REG_CONFIG + 5) & GOODIX_TOUCH_COUNT_MASK;
+    USHORT checksum;
+
+    if (GOODIX_SIM_REG(Sim, GOODIX_REG_COMMAND) == GOODIX_CMD_SCREEN_OFF)
+        return;
+
+    if (GOODIX_SIM_REG(Sim, GOODIX_REG_COMMAND) == GOODIX_CMD_DOZE && Count == 0)
+    {
+        Sim->DozeScans++;
+        return;
+    }
+
+    Sim->Scans++;
+
+    if (*status & GOODIX_TOUCH_EVENT)
+    {
+        Sim->FramesHeld++;
+    }
+    else
+    {
+        Count = (UCHAR)min(min(Count, limit), MAX_POINT_NUM);
+
+        for (UCHAR i = 0; i < Count; i++)
+        {
+            PUCHAR record = status + 1 + i * BYTES_PER_COORD;
+
+            record[0] = Contacts[i].Id;
+            record[1] = (UCHAR)Contacts[i].X;
+            record[2] = (UCHAR)(Contacts[i].X >> 8);
+            record[3] = (UCHAR)Contacts[i].Y;
+            record[4] = (UCHAR)(Contacts[i].Y >> 8);
+            record[5] = (UCHAR)Contacts[i].Size;
+            record[6] = (UCHAR)(Contacts[i].Size >> 8);
+            record[7] = 0;
+        }
+
+        *status = GOODIX_TOUCH_EVENT | Count;
+
+        checksum = GoodixFrameChecksum(status, Count);
+        status[1 + Count * BYTES_PER_COORD] = (UCHAR)checksum;
+        status[2 + Count * BYTES_PER_COORD] = (UCHAR)(checksum >> 8);
+        Sim->FramesPublished++;
+    }
+
+    if (Sim->Interrupt != NULL)
+        Sim->Interrupt(Sim->InterruptContext);
+}
@@ -0,0 +1,111 @@
+/*++
+
+Module Name:
+
+    goodixsim.h
+
+Abstract:
+
+    Register-level model of a GT9xx controller. It answers the same
+    address-prefixed writes and write-then-read transfers that GoodixRead,
+    GoodixWrite and GoodixReadFrame put on the bus, and raises a simulated
+    interrupt line whenever a scan completes. Together with touchcore.c it
+    lets the decode and report path run against reproducible frame streams
+    without hardware.
+
+    The model is not part of the driver build; the host build in
+    CMakeLists.txt compiles it with touchcore.
+
+Environment:
+
+    Kernel mode or user mode
+
+--*/
+
+#ifndef __GOODIXSIM_H__
+#define __GOODIXSIM_H__
+
+#include "touchcore.h"
+
+//
+// Window of the register map that is modelled: the command register up to
+// the frame checksum behind the last point record.
+//
+#define GOODIX_SIM_REG_FIRST    GOODIX_REG_COMMAND
+#define GOODIX_SIM_REG_LAST     (TOUCH_INFO_ADDR + MAX_POINT_NUM * BYTES_PER_COORD + BYTES_CHKSUM)
+#define GOODIX_SIM_REG_COUNT    (GOODIX_SIM_REG_LAST - GOODIX_SIM_REG_FIRST + 1)
+
+typedef struct _GOODIX_SIM_CONTACT
+{
+    UCHAR                   Id;
+    USHORT                  X;
+    USHORT                  Y;
+    USHORT                  Size;
+} GOODIX_SIM_CONTACT, *PGOODIX_SIM_CONTACT;
+
+typedef
+VOID
+GOODIX_SIM_INTERRUPT(
+    _In_opt_ PVOID Context
+);
+
+typedef GOODIX_SIM_INTERRUPT *PGOODIX_SIM_INTERRUPT;
+
+typedef struct _GOODIX_SIM
+{
+    UCHAR                   Registers[GOODIX_SIM_REG_COUNT];
+
+    //
+    // Called on every simulated interrupt edge, after the point buffer has
+    // been updated.
+    //
+    PGOODIX_SIM_INTERRUPT   Interrupt;
+    PVOID                   InterruptContext;
+
+    //
+    // Fault injection: ignore the next IgnoreClears writes that would clear
+    // the status byte, as if they were lost on the bus.
+    //
+    ULONG                   IgnoreClears;
+
+    ULONG                   Scans;
+    ULONG                   FramesPublished;
+    ULONG                   FramesHeld;         // scan finished while the buffer was still uncleared
+    ULONG                   DozeScans;          // empty scans in doze, with no interrupt
+    ULONG                   Clears;
+    ULONG                   ConfigUpdates;
+    ULONG                   ConfigRejected;
+    ULONG                   Reads;
+    ULONG                   Writes;
+} GOODIX_SIM, *PGOODIX_SIM;
+
+VOID
+GoodixSimInit(
+    _Out_ PGOODIX_SIM Sim,
+    _In_ USHORT XResolution,
+    _In_ USHORT YResolution,
+    _In_ UCHAR MaxContacts
+);
+
+NTSTATUS
+GoodixSimTransfer(
+    _Inout_ PGOODIX_SIM Sim,
+    _In_reads_bytes_(TxLength) const UCHAR* TxBuffer,
+    _In_ ULONG TxLength,
+    _Out_writes_bytes_opt_(RxLength) PUCHAR RxBuffer,
+    _In_ ULONG RxLength
+);
+
+VOID
+GoodixSimScan(
+    _Inout_ PGOODIX_SIM Sim,
+    _In_reads_(Count) const GOODIX_SIM_CONTACT* Contacts,
+    _In_ UCHAR Count
+);
+
+UCHAR
+GoodixSimConfigChecksum(
+    _In_reads_bytes_(GOODIX_CONFIG_LENGTH) const UCHAR* Config
+);
+
+#endif // __GOODIXSIM_H__
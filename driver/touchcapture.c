@@ -0,0 +1,411 @@
+/*++
+
+Module Name:
+
+    touchcapture.c
+
+Abstract:
+
+    Encoder and decoder for raw frame capture files; see touchcapture.h.
+
+Environment:
+
+    Kernel mode or user mode
+
+--*/
+
+#include "touchcapture.h"
+
+#define TOUCH_CAPTURE_ZIGZAG(v)     (((ULONGLONG)(v) << 1) ^ (ULONGLONG)((LONGLONG)(v) >> 63))
+#define TOUCH_CAPTURE_UNZIGZAG(v)   ((LONGLONG)((v) >> 1) ^ -(LONGLONG)((v) & 1))
+
+#define TOUCH_CAPTURE_KEY_HEADER    (sizeof(LONGLONG) + 2)
+
+ULONG
+TouchCapturePutVarint(
+    _Out_writes_bytes_to_(10, return) PUCHAR Buffer,
+    _In_ ULONGLONG Value
+)
+/*++
+
+  Routine Description:
+
+    Writes Value seven bits at a time, least significant group first, with
+    the top bit of each byte set while more groups follow.
+
+  Return Value:
+
+    Number of bytes written.
+
+--*/
+{
+    ULONG length = 0;
+
+    while (Value >= 0x80)
+    {
+        Buffer[length++] = (UCHAR)(Value | 0x80);
+        Value >>= 7;
+    }
+    Buffer[length++] = (UCHAR)Value;
+
+    return length;
+}
+
+BOOLEAN
+TouchCaptureGetVarint(
+    _Inout_ const UCHAR** Cursor,
+    _In_ const UCHAR* End,
+    _Out_ ULONGLONG* Value
+)
+/*++
+
+  Routine Description:
+
+    Reads a varint written by TouchCapturePutVarint and advances Cursor
+    past it.
+
+  Return Value:
+
+    FALSE if the varint runs past End or is longer than 64 bits.
+
+--*/
+{
+    const UCHAR* p = *Cursor;
+    ULONGLONG value = 0;
+
+    for (ULONG shift = 0; shift < 64; shift += 7)
+    {
+        if (p >= End)
+            return FALSE;
+
+        value |= (ULONGLONG)(*p & 0x7F) << shift;
+        if ((*p++ & 0x80) == 0)
+        {
+            *Cursor = p;
+            *Value = value;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+const UINT8*
+TouchCaptureFindKeyContact(
+    _In_ PTOUCH_CAPTURE_FRAME Key,
+    _In_ UINT8 Id
+)
+/*++
+
+  Routine Description:
+
+    Returns the point record of the key frame with the given track id, or
+    NULL if the key frame has no such contact.
+
+--*/
+{
+    for (UCHAR i = 0; i < Key->Count; i++)
+    {
+        const UINT8* record = &Key->Bytes[1 + i * BYTES_PER_COORD];
+
+        if ((record[0] & 0x0F) == Id)
+            return record;
+    }
+
+    return NULL;
+}
+
+VOID
+TouchCaptureWriterInit(
+    _Out_ PTOUCH_CAPTURE_WRITER Writer
+)
+{
+    RtlZeroMemory(Writer, sizeof(TOUCH_CAPTURE_WRITER));
+}
+
+ULONG
+TouchCaptureEncodeFrame(
+    _Inout_ PTOUCH_CAPTURE_WRITER Writer,
+    _In_ LONGLONG Timestamp,
+    _In_reads_bytes_(1 + Count * BYTES_PER_COORD) const UINT8* Frame,
+    _In_ UCHAR Count,
+    _Out_writes_bytes_to_(TOUCH_CAPTURE_RECORD_MAX, return) PUCHAR Record
+)
+/*++
+
+  Routine Description:
+
+    Encodes the next frame of a capture. The caller appends the record to
+    the file and notes its offset for the index.
+
+  Arguments:
+
+    Writer - encoder state, initialized with TouchCaptureWriterInit
+
+    Timestamp - performance counter value of the frame's interrupt
+
+    Frame - status byte followed by the point records
+
+    Count - number of point records in Frame
+
+    Record - receives the encoded record
+
+  Return Value:
+
+    Length of the record in bytes.
+
+--*/
+{
+    PTOUCH_CAPTURE_FRAME key = &Writer->Key;
+    PUCHAR out = Record;
+
+    Count = (UCHAR)min(Count, MAX_POINT_NUM);
+
+    if (Writer->FrameCount++ % TOUCH_CAPTURE_KEY_INTERVAL == 0)
+    {
+        key->Timestamp = Timestamp;
+        key->Count = Count;
+        RtlZeroMemory(key->Bytes, sizeof(key->Bytes));
+        RtlCopyMemory(key->Bytes, Frame, 1 + Count * BYTES_PER_COORD);
+
+        RtlCopyMemory(out, &Timestamp, sizeof(LONGLONG));
+        out += sizeof(LONGLONG);
+        *out++ = Count;
+        RtlCopyMemory(out, Frame, 1 + Count * BYTES_PER_COORD);
+        out += 1 + Count * BYTES_PER_COORD;
+
+        return (ULONG)(out - Record);
+    }
+
+    out += TouchCapturePutVarint(out, TOUCH_CAPTURE_ZIGZAG(Timestamp - key->Timestamp));
+    *out++ = Count;
+    *out++ = Frame[0];
+
+    for (UCHAR i = 0; i < Count; i++)
+    {
+        const UINT8* record = &Frame[1 + i * BYTES_PER_COORD];
+        const UINT8* base = TouchCaptureFindKeyContact(key, record[0] & 0x0F);
+        LONG x = record[1] | (record[2] << 8);
+        LONG y = record[3] | (record[4] << 8);
+
+        if (base != NULL)
+        {
+            x -= base[1] | (base[2] << 8);
+            y -= base[3] | (base[4] << 8);
+        }
+
+        *out++ = record[0];
+        out += TouchCapturePutVarint(out, TOUCH_CAPTURE_ZIGZAG(x));
+        out += TouchCapturePutVarint(out, TOUCH_CAPTURE_ZIGZAG(y));
+        out += TouchCapturePutVarint(out, record[5] | (record[6] << 8));
+        *out++ = record[7];
+    }
+
+    return (ULONG)(out - Record);
+}
+
+BOOLEAN
+TouchCaptureOpen(
+    _In_reads_bytes_(Size) const UCHAR* Image,
+    _In_ ULONGLONG Size,
+    _Out_ PTOUCH_CAPTURE_VIEW View
+)
+/*++
+
+  Routine Description:
+
+    Checks the header and index bounds of a capture image, typically a
+    mapped file, without reading any frame record. Image must be 8-byte
+    aligned.
+
+  Return Value:
+
+    TRUE if the image can be decoded with TouchCaptureDecodeFrame.
+
+--*/
+{
+    PTOUCH_CAPTURE_HEADER header = &View->Header;
+
+    RtlZeroMemory(View, sizeof(TOUCH_CAPTURE_VIEW));
+
+    if (Size < sizeof(TOUCH_CAPTURE_HEADER))
+        return FALSE;
+
+    RtlCopyMemory(header, Image, sizeof(TOUCH_CAPTURE_HEADER));
+
+    if (header->Magic != TOUCH_CAPTURE_MAGIC ||
+        header->Version != TOUCH_CAPTURE_VERSION ||
+        header->KeyInterval == 0 ||
+        header->IndexOffset < sizeof(TOUCH_CAPTURE_HEADER) ||
+        header->IndexOffset % sizeof(ULONGLONG) != 0 ||
+        header->IndexOffset > Size ||
+        (Size - header->IndexOffset) / sizeof(ULONGLONG) < header->FrameCount)
+        return FALSE;
+
+    View->Image = Image;
+    View->Size = Size;
+    View->Index = (const ULONGLONG*)(Image + header->IndexOffset);
+
+    return TRUE;
+}
+
+BOOLEAN
+TouchCaptureGetRecord(
+    _In_ PTOUCH_CAPTURE_VIEW View,
+    _In_ ULONG FrameIndex,
+    _Out_ const UCHAR** Start,
+    _Out_ const UCHAR** End
+)
+/*++
+
+  Routine Description:
+
+    Looks up the bytes of one frame record through the index. A record
+    ends where the next one starts; the last one ends at the index.
+
+--*/
+{
+    ULONGLONG start = View->Index[FrameIndex];
+    ULONGLONG end = FrameIndex + 1 < View->Header.FrameCount ?
+                    View->Index[FrameIndex + 1] : View->Header.IndexOffset;
+
+    if (start < sizeof(TOUCH_CAPTURE_HEADER) || start > end || end > View->Header.IndexOffset)
+        return FALSE;
+
+    *Start = View->Image + start;
+    *End = View->Image + end;
+
+    return TRUE;
+}
+
+BOOLEAN
+TouchCaptureDecodeKey(
+    _In_ PTOUCH_CAPTURE_VIEW View,
+    _In_ ULONG FrameIndex,
+    _Out_ PTOUCH_CAPTURE_FRAME Frame
+)
+{
+    const UCHAR* p;
+    const UCHAR* end;
+
+    RtlZeroMemory(Frame, sizeof(TOUCH_CAPTURE_FRAME));
+
+    if (!TouchCaptureGetRecord(View, FrameIndex, &p, &end) ||
+        end - p < (LONG_PTR)TOUCH_CAPTURE_KEY_HEADER)
+        return FALSE;
+
+    RtlCopyMemory(&Frame->Timestamp, p, sizeof(LONGLONG));
+    Frame->Count = p[sizeof(LONGLONG)];
+    p += sizeof(LONGLONG) + 1;
+
+    if (Frame->Count > MAX_POINT_NUM ||
+        end - p < (LONG_PTR)(1 + Frame->Count * BYTES_PER_COORD))
+        return FALSE;
+
+    RtlCopyMemory(Frame->Bytes, p, 1 + Frame->Count * BYTES_PER_COORD);
+
+    return TRUE;
+}
+
+BOOLEAN
+TouchCaptureDecodeFrame(
+    _In_ PTOUCH_CAPTURE_VIEW View,
+    _In_ ULONG FrameIndex,
+    _Out_ PTOUCH_CAPTURE_FRAME Frame
+)
+/*++
+
+  Routine Description:
+
+    Decodes one frame of an opened capture. Only the frame's own record
+    and that of its key frame are read, so the cost does not depend on
+    where in the capture the frame is.
+
+  Arguments:
+
+    View - the capture, opened with TouchCaptureOpen
+
+    FrameIndex - zero-based number of the frame
+
+    Frame - receives the frame as the driver read it
+
+  Return Value:
+
+    FALSE if FrameIndex is out of range or a record is malformed.
+
+--*/
+{
+    TOUCH_CAPTURE_FRAME key;
+    const UCHAR* p;
+    const UCHAR* end;
+    ULONGLONG value;
+    ULONG keyIndex;
+
+    if (FrameIndex >= View->Header.FrameCount)
+        return FALSE;
+
+    keyIndex = FrameIndex - FrameIndex % View->Header.KeyInterval;
+    if (!TouchCaptureDecodeKey(View, keyIndex, &key))
+        return FALSE;
+
+    if (keyIndex == FrameIndex)
+    {
+        RtlCopyMemory(Frame, &key, sizeof(TOUCH_CAPTURE_FRAME));
+        return TRUE;
+    }
+
+    RtlZeroMemory(Frame, sizeof(TOUCH_CAPTURE_FRAME));
+
+    if (!TouchCaptureGetRecord(View, FrameIndex, &p, &end) ||
+        !TouchCaptureGetVarint(&p, end, &value) ||
+        end - p < 2)
+        return FALSE;
+
+    Frame->Timestamp = key.Timestamp + TOUCH_CAPTURE_UNZIGZAG(value);
+    Frame->Count = *p++;
+    Frame->Bytes[0] = *p++;
+
+    if (Frame->Count > MAX_POINT_NUM)
+        return FALSE;
+
+    for (UCHAR i = 0; i < Frame->Count; i++)
+    {
+        UINT8* record = &Frame->Bytes[1 + i * BYTES_PER_COORD];
+        const UINT8* base;
+        LONG x = 0;
+        LONG y = 0;
+
+        if (p >= end)
+            return FALSE;
+
+        record[0] = *p++;
+        base = TouchCaptureFindKeyContact(&key, record[0] & 0x0F);
+        if (base != NULL)
+        {
+            x = base[1] | (base[2] << 8);
+            y = base[3] | (base[4] << 8);
+        }
+
+        if (!TouchCaptureGetVarint(&p, end, &value))
+            return FALSE;
+        x += (LONG)TOUCH_CAPTURE_UNZIGZAG(value);
+
+        if (!TouchCaptureGetVarint(&p, end, &value))
+            return FALSE;
+        y += (LONG)TOUCH_CAPTURE_UNZIGZAG(value);
+
+        record[1] = (UINT8)x;
+        record[2] = (UINT8)(x >> 8);
+        record[3] = (UINT8)y;
+        record[4] = (UINT8)(y >> 8);
+
+        if (!TouchCaptureGetVarint(&p, end, &value) || p >= end)
+            return FALSE;
+
+        record[5] = (UINT8)value;
+        record[6] = (UINT8)(value >> 8);
+        record[7] = *p++;
+    }
+
+    return TRUE;
+}
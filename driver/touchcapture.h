@@ -0,0 +1,163 @@
+/*++
+
+Module Name:
+
+    touchcapture.h
+
+Abstract:
+
+    File format for raw GT9xx frame captures, as streamed from the driver
+    with HIDMINI_CONTROL_CODE_CAPTURE, and the routines that encode and
+    decode it. A capture file is used in place once mapped: a fixed header,
+    the frame records, then a table with the offset of every record, so any
+    frame can be decoded without reading the ones before it. The decoded
+    frames are byte-for-byte what the driver read and can be fed straight
+    to GoodixDecodePoints.
+
+    Coordinates are delta-encoded against a key frame written every
+    TOUCH_CAPTURE_KEY_INTERVAL frames, which keeps records small while
+    bounding a seek to two record decodes.
+
+    The codec is not part of the driver build; the host build in
+    CMakeLists.txt compiles it with touchcore.
+
+Environment:
+
+    Kernel mode or user mode
+
+--*/
+
+#ifndef __TOUCHCAPTURE_H__
+#define __TOUCHCAPTURE_H__
+
+#include "touchcore.h"
+
+//
+// File layout. All fields are little-endian and all offsets are from the
+// start of the file:
+//
+//     TOUCH_CAPTURE_HEADER
+//     FrameCount frame records, variable length
+//     padding to 8 bytes
+//     ULONGLONG record offset[FrameCount], at IndexOffset
+//
+// A key record is the 64-bit timestamp, the contact count, the status
+// byte and the point records as read. Any other record is the timestamp
+// delta to its key frame as a varint, the contact count, the status byte,
+// and for each contact the id byte, X and Y as zigzag varint deltas to the
+// key frame contact with the same id (or to zero if there is none), the
+// size as a varint and the reserved byte.
+//
+#define TOUCH_CAPTURE_MAGIC         0x46435447      // 'GTCF'
+#define TOUCH_CAPTURE_VERSION       1
+#define TOUCH_CAPTURE_KEY_INTERVAL  64
+
+//
+// Longest encoded record: a key record with every contact, or a delta
+// record whose varints all take their longest form.
+//
+#define TOUCH_CAPTURE_RECORD_MAX    (10 + 2 + MAX_POINT_NUM * (1 + 3 + 3 + 3 + 1))
+
+typedef struct _TOUCH_CAPTURE_HEADER
+{
+    ULONG                   Magic;
+    ULONG                   Version;
+    ULONG                   KeyInterval;
+    ULONG                   FrameCount;
+    ULONGLONG               PerfFrequency;      // ticks per second of the timestamps
+    ULONGLONG               IndexOffset;
+} TOUCH_CAPTURE_HEADER, *PTOUCH_CAPTURE_HEADER;
+
+//
+// A decoded frame: the status byte followed by Count point records.
+//
+typedef struct _TOUCH_CAPTURE_FRAME
+{
+    LONGLONG                Timestamp;
+    UCHAR                   Count;
+    UINT8                   Bytes[TOUCH_FRAME_SIZE];
+} TOUCH_CAPTURE_FRAME, *PTOUCH_CAPTURE_FRAME;
+
+//
+// Encoder state carried from frame to frame.
+//
+typedef struct _TOUCH_CAPTURE_WRITER
+{
+    ULONG                   FrameCount;
+    TOUCH_CAPTURE_FRAME     Key;
+} TOUCH_CAPTURE_WRITER, *PTOUCH_CAPTURE_WRITER;
+
+//
+// A validated capture image.
+//
+typedef struct _TOUCH_CAPTURE_VIEW
+{
+    const UCHAR*            Image;
+    ULONGLONG               Size;
+    TOUCH_CAPTURE_HEADER    Header;
+    const ULONGLONG*        Index;
+} TOUCH_CAPTURE_VIEW, *PTOUCH_CAPTURE_VIEW;
+
+VOID
+TouchCaptureWriterInit(
+    _Out_ PTOUCH_CAPTURE_WRITER Writer
+);
+
+ULONG
+TouchCaptureEncodeFrame(
+    _Inout_ PTOUCH_CAPTURE_WRITER Writer,
+    _In_ LONGLONG Timestamp,
+    _In_reads_bytes_(1 + Count * BYTES_PER_COORD) const UINT8* Frame,
+    _In_ UCHAR Count,
+    _Out_writes_bytes_to_(TOUCH_CAPTURE_RECORD_MAX, return) PUCHAR Record
+);
+
+BOOLEAN
+TouchCaptureOpen(
+    _In_reads_bytes_(Size) const UCHAR* Image,
+    _In_ ULONGLONG Size,
+    _Out_ PTOUCH_CAPTURE_VIEW View
+);
+
+BOOLEAN
+TouchCaptureDecodeFrame(
+    _In_ PTOUCH_CAPTURE_VIEW View,
+    _In_ ULONG FrameIndex,
+    _Out_ PTOUCH_CAPTURE_FRAME Frame
+);
+
+BOOLEAN
+TouchCaptureGetRecord(
+    _In_ PTOUCH_CAPTURE_VIEW View,
+    _In_ ULONG FrameIndex,
+    _Out_ const UCHAR** Start,
+    _Out_ const UCHAR** End
+);
+
+BOOLEAN
+TouchCaptureDecodeKey(
+    _In_ PTOUCH_CAPTURE_VIEW View,
+    _In_ ULONG FrameIndex,
+    _Out_ PTOUCH_CAPTURE_FRAME Frame
+);
+
+const UINT8*
+TouchCaptureFindKeyContact(
+    _In_ PTOUCH_CAPTURE_FRAME Key,
+    _In_ UINT8 Id
+);
+
+ULONG
+TouchCapturePutVarint(
+    _Out_writes_bytes_to_(10, return) PUCHAR Buffer,
+    _In_ ULONGLONG Value
+);
+
+BOOLEAN
+TouchCaptureGetVarint(
+    _Inout_ const UCHAR** Cursor,
+    _In_ const UCHAR* End,
+    _Out_ ULONGLONG* Value
+);
+
+#endif // __TOUCHCAPTURE_H__
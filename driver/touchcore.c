@@ -0,0 +1,1574 @@
+/*++
+
+Module Name:
+
+    touchcore.c
+
+Abstract:
+
+    Platform-neutral part of the touch path. Routines here only transform
+    caller-supplied buffers, so they can be called at any IRQL and built
+    outside the driver. The exceptions are GoodixReadFrameFrom and
+    GoodixDozeEnter, which run at whatever IRQL the caller's TOUCH_BUS
+    allows.
+
+Environment:
+
+    Kernel mode or user mode
+
+--*/
+
+#include "touchcore.h"
+
+#if defined(_M_AMD64)
+#include <emmintrin.h>
+#elif defined(_M_ARM64)
+#include <arm64_neon.h>
+#endif
+
+UCHAR
+GoodixConfigChecksum(
+    _In_reads_bytes_(GOODIX_CONFIG_LENGTH) const UCHAR* Config
+)
+/*++
+
+  Routine Description:
+
+    Computes the checksum the controller keeps at
+    GOODIX_REG_CONFIG_CHECKSUM: the two's complement of the byte sum of the
+    configuration block.
+
+--*/
+{
+    UCHAR sum = 0;
+
+    for (ULONG i = 0; i < GOODIX_CONFIG_LENGTH; i++)
+    {
+        sum += Config[i];
+    }
+
+    return (UCHAR)(~sum + 1);
+}
+
+BOOLEAN
+GoodixParseConfig(
+    _In_reads_bytes_(GOODIX_CONFIG_LENGTH + 1) const UCHAR* Config,
+    _Inout_ PGOODIX_CONTROLLER_INFO Info
+)
+/*++
+
+  Routine Description:
+
+    Checks a configuration block read from GOODIX_REG_CONFIG together with
+    its checksum byte, and takes the version, resolution and contact count
+    from it. The identification fields of Info are left alone.
+
+  Arguments:
+
+    Config - the configuration block followed by its checksum
+
+    Info - receives the configuration fields
+
+  Return Value:
+
+    FALSE if the checksum does not match or a field is out of range, in
+    which case Info is not changed.
+
+--*/
+{
+    USHORT x = Config[GOODIX_CONFIG_X_OUTPUT_MAX] | (Config[GOODIX_CONFIG_X_OUTPUT_MAX + 1] << 8);
+    USHORT y = Config[GOODIX_CONFIG_Y_OUTPUT_MAX] | (Config[GOODIX_CONFIG_Y_OUTPUT_MAX + 1] << 8);
+    UCHAR contacts = Config[GOODIX_CONFIG_TOUCH_NUMBER] & GOODIX_TOUCH_COUNT_MASK;
+
+    if (GoodixConfigChecksum(Config) != Config[GOODIX_CONFIG_LENGTH])
+        return FALSE;
+
+    if (x == 0 || y == 0 || contacts == 0 || contacts > MAX_POINT_NUM)
+        return FALSE;
+
+    Info->ConfigVersion = Config[GOODIX_CONFIG_VERSION];
+    Info->MaxContacts = contacts;
+    Info->XResolution = x;
+    Info->YResolution = y;
+
+    return TRUE;
+}
+
+USHORT
+GoodixFrameChecksum(
+    _In_reads_bytes_(1 + count * BYTES_PER_COORD) const UINT8* frame,
+    _In_ UINT8 count
+)
+/*++
+
+  Routine Description:
+
+    Sums the status byte and the point records of a frame. A record is
+    exactly one 64-bit word, so the bytes are summed a word at a time:
+    even and odd bytes are masked into four 16-bit lanes each, which cannot
+    overflow for MAX_POINT_NUM records, and the lanes are folded at the end.
+
+  Return Value:
+
+    The low 16 bits of the byte sum.
+
+--*/
+{
+    const ULONGLONG mask = 0x00FF00FF00FF00FFULL;
+    ULONGLONG lanes = 0;
+    ULONGLONG word;
+
+    for (UINT8 i = 0; i < count; i++)
+    {
+        RtlCopyMemory(&word, &frame[1 + i * BYTES_PER_COORD], sizeof(word));
+        lanes += word & mask;
+        lanes += (word >> 8) & mask;
+    }
+
+    lanes += lanes >> 32;
+    lanes += lanes >> 16;
+
+    return (USHORT)(frame[0] + lanes);
+}
+
+BOOLEAN
+GoodixFrameValid(
+    _In_reads_bytes_(1 + count * BYTES_PER_COORD + BYTES_CHKSUM) const UINT8* frame,
+    _In_ UINT8 count
+)
+/*++
+
+  Routine Description:
+
+    Checks a frame against the checksum behind its last point record.
+
+--*/
+{
+    const UINT8* checksum = &frame[1 + count * BYTES_PER_COORD];
+
+    return GoodixFrameChecksum(frame, count) == (USHORT)(checksum[0] | (checksum[1] << 8));
+}
+
+NTSTATUS
+GoodixReadFrameFrom(
+    _In_ const TOUCH_BUS* Bus,
+    _In_ UINT8 fetched,
+    _In_ BOOLEAN checksum,
+    _Out_writes_(TOUCH_READ_SIZE) UINT8* frameBuf,
+    _Out_ UINT8* touchCount,
+    _Out_ ULONG* events
+)
+/*++
+
+  Routine Description:
+
+    Reads the status byte at TOUCH_INFO_ADDR together with the point
+    records and clears the status byte. The number of records fetched up
+    front is chosen by the caller; when more contacts are reported than
+    were fetched the remainder is read separately.
+
+    Without checksum the clear goes out in the same bus transaction as the
+    read. Once the status byte is cleared the controller may publish its
+    next frame over the records at any time, so a frame with more contacts
+    than were fetched cannot be completed: it is dropped as short and the
+    caller fetches more records for the next one.
+
+    With checksum set, each read also takes the checksum word behind the
+    records, and the clear is only written once the frame has been checked,
+    so the records cannot change under the check. A frame that fails the
+    check has its records and checksum read once more; if it fails again
+    it is dropped, and cleared all the same.
+
+  Arguments:
+
+    Bus - the controller
+
+    fetched - number of point records to read with the status byte
+
+    checksum - whether the controller appends a frame checksum
+
+    frameBuf - receives the status byte followed by the point records
+
+    touchCount - receives the number of valid point records
+
+    events - receives the GOODIX_FRAME_* events of the read
+
+  Return Value:
+
+    STATUS_CRC_ERROR if the frame was corrupt, STATUS_DEVICE_DATA_ERROR if
+    it was short, otherwise the bus status. The status byte was cleared if
+    GOODIX_FRAME_CLEARED is set in events, whatever the status.
+
+--*/
+{
+    NTSTATUS status;
+    NTSTATUS clearStatus;
+    ULONG checksumLen = checksum ? BYTES_CHKSUM : 0;
+    UINT8 clear = 0;
+    UINT8 count = 0;
+
+    *touchCount = 0;
+    *events = 0;
+    RtlZeroMemory(frameBuf, TOUCH_READ_SIZE);
+
+    fetched = min(fetched, MAX_POINT_NUM);
+
+    status = Bus->Read(Bus->Context,
+                       TOUCH_INFO_ADDR,
+                       frameBuf,
+                       1 + fetched * BYTES_PER_COORD + checksumLen,
+                       !checksum);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (!checksum)
+        *events |= GOODIX_FRAME_CLEARED;
+
+    if ((frameBuf[0] & 0xF0) == GOODIX_TOUCH_EVENT)
+    {
+        count = min(frameBuf[0] & GOODIX_TOUCH_COUNT_MASK, MAX_POINT_NUM);
+
+        if (count > fetched && (*events & GOODIX_FRAME_CLEARED))
+        {
+            *events |= GOODIX_FRAME_SHORT;
+            return STATUS_DEVICE_DATA_ERROR;
+        }
+
+        if (count > fetched)
+        {
+            *events |= GOODIX_FRAME_TOP_UP;
+
+            status = Bus->Read(Bus->Context,
+                               (USHORT)(TOUCH_INFO_ADDR + 1 + fetched * BYTES_PER_COORD),
+                               &frameBuf[1 + fetched * BYTES_PER_COORD],
+                               (count - fetched) * BYTES_PER_COORD + checksumLen,
+                               FALSE);
+        }
+
+        if (NT_SUCCESS(status) && checksum && !GoodixFrameValid(frameBuf, count))
+        {
+            *events |= GOODIX_FRAME_REREAD;
+
+            status = Bus->Read(Bus->Context,
+                               TOUCH_INFO_ADDR + 1,
+                               &frameBuf[1],
+                               count * BYTES_PER_COORD + BYTES_CHKSUM,
+                               FALSE);
+
+            if (NT_SUCCESS(status) && !GoodixFrameValid(frameBuf, count))
+            {
+                *events |= GOODIX_FRAME_CORRUPT;
+                status = STATUS_CRC_ERROR;
+            }
+        }
+    }
+
+    if (!(*events & GOODIX_FRAME_CLEARED))
+    {
+        clearStatus = Bus->Write(Bus->Context, TOUCH_INFO_ADDR, &clear, 1);
+        if (NT_SUCCESS(clearStatus))
+            *events |= GOODIX_FRAME_CLEARED;
+        if (NT_SUCCESS(status))
+            status = clearStatus;
+    }
+
+    if (!NT_SUCCESS(status) || (frameBuf[0] & 0xF0) != GOODIX_TOUCH_EVENT)
+        return status;
+
+    *touchCount = count;
+
+    return status;
+}
+
+NTSTATUS
+GoodixDozeEnter(
+    _In_ const TOUCH_BUS* Bus,
+    _Inout_ volatile LONG* Dozing
+)
+/*++
+
+  Routine Description:
+
+    Sends the doze command. Dozing is set before the command goes out, so
+    an interrupt that arrives meanwhile clears it and wakes the controller.
+    That wake can reach the controller ahead of the doze command, which
+    would leave it dozing with Dozing clear; so once the command is out,
+    Dozing is checked again and the controller sent back to coordinate
+    reporting if it was cleared.
+
+  Arguments:
+
+    Bus - the controller
+
+    Dozing - the caller's doze flag, cleared by the interrupt handler on
+        the first interrupt in doze
+
+  Return Value:
+
+    NTSTATUS of the doze command; Dozing is clear again on failure.
+
+--*/
+{
+    NTSTATUS status;
+    UINT8 command = GOODIX_CMD_DOZE;
+
+    InterlockedExchange(Dozing, 1);
+
+    status = Bus->Write(Bus->Context, GOODIX_REG_COMMAND, &command, 1);
+    if (!NT_SUCCESS(status))
+    {
+        InterlockedExchange(Dozing, 0);
+        return status;
+    }
+
+    if (ReadAcquire(Dozing) == 0)
+    {
+        command = GOODIX_CMD_READ_COORDS;
+        Bus->Write(Bus->Context, GOODIX_REG_COMMAND, &command, 1);
+    }
+
+    return status;
+}
+
+VOID
+GoodixDecodePointsScalar(
+    _In_reads_bytes_(count * BYTES_PER_COORD) const UINT8* records,
+    _In_ UINT8 count,
+    _Out_writes_bytes_(count * sizeof(inputpoint)) UINT8* points
+)
+/*++
+
+  Routine Description:
+
+    Converts GT9xx point records into report points one record at a time.
+    Each 8-byte record is laid out as
+
+        [0] track ID  [1..2] X  [3..4] Y  [5..6] size  [7] reserved
+
+    and becomes a 6-byte inputpoint with the tip, in-range and confidence
+    bits set and the raw controller coordinates; TouchTransformPoints maps
+    them into the logical range afterwards. This is the reference the
+    vector paths must match.
+
+--*/
+{
+    for (UINT8 i = 0; i < count; i++)
+    {
+        const UINT8* record = &records[i * BYTES_PER_COORD];
+        UINT8* point = &points[i * sizeof(inputpoint)];
+
+        point[0] = 0x07;  // In Point
+        point[1] = record[0] & 0x0F;
+        point[2] = record[1];
+        point[3] = record[2];
+        point[4] = record[3];
+        point[5] = record[4];
+    }
+}
+
+VOID
+GoodixDecodePoints(
+    _In_reads_bytes_(count * BYTES_PER_COORD) const UINT8* records,
+    _In_ UINT8 count,
+    _Out_writes_bytes_(count * sizeof(inputpoint)) UINT8* points
+)
+/*++
+
+  Routine Description:
+
+    Converts GT9xx point records into report points, four records per step
+    with SSE2 on x64 or NEON on ARM64. Every record is viewed as four
+    little-endian 16-bit words; after a 4x4 transpose X and Y fall out of
+    two shifts and an OR per lane, and the three output words per point are
+    interleaved back into inputpoint layout. Leftover records, and every
+    record on other architectures, go through GoodixDecodePointsScalar.
+
+--*/
+{
+    UINT8 i = 0;
+
+#if defined(_M_AMD64)
+    const __m128i mask0F = _mm_set1_epi16(0x000F);
+    const __m128i inPoint = _mm_set1_epi16(0x0007);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const UINT8* record = &records[i * BYTES_PER_COORD];
+        UINT8* point = &points[i * sizeof(inputpoint)];
+        __m128i a = _mm_loadu_si128((const __m128i*)record);
+        __m128i b = _mm_loadu_si128((const __m128i*)(record + 16));
+        __m128i t0 = _mm_unpacklo_epi16(a, b);
+        __m128i t1 = _mm_unpackhi_epi16(a, b);
+        __m128i w01 = _mm_unpacklo_epi16(t0, t1);   // word 0 | word 1 of points 0..3
+        __m128i w23 = _mm_unpackhi_epi16(t0, t1);   // word 2 | word 3 of points 0..3
+        __m128i w1 = _mm_srli_si128(w01, 8);
+        __m128i x = _mm_or_si128(_mm_srli_epi16(w01, 8), _mm_slli_epi16(w1, 8));
+        __m128i y = _mm_or_si128(_mm_srli_epi16(w1, 8), _mm_slli_epi16(w23, 8));
+        __m128i o0 = _mm_or_si128(inPoint, _mm_slli_epi16(_mm_and_si128(w01, mask0F), 8));
+        __m128i r = _mm_unpacklo_epi16(o0, x);
+        __m128i s = _mm_unpacklo_epi16(y, zero);
+        __m128i p01 = _mm_unpacklo_epi32(r, s);     // point 0 | point 1, 4 words each
+        __m128i p23 = _mm_unpackhi_epi32(r, s);     // point 2 | point 3, 4 words each
+        UINT64 last;
+
+        //
+        // Each 8-byte store spills two bytes into the next point, which the
+        // next store overwrites. The last point is copied without the spill.
+        //
+        _mm_storel_epi64((__m128i*)point, p01);
+        _mm_storel_epi64((__m128i*)(point + 6), _mm_srli_si128(p01, 8));
+        _mm_storel_epi64((__m128i*)(point + 12), p23);
+        _mm_storel_epi64((__m128i*)&last, _mm_srli_si128(p23, 8));
+        RtlCopyMemory(point + 18, &last, sizeof(inputpoint));
+    }
+#elif defined(_M_ARM64)
+    const uint16x4_t mask0F = vdup_n_u16(0x000F);
+    const uint16x4_t inPoint = vdup_n_u16(0x0007);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        uint16x4x4_t w = vld4_u16((const uint16_t*)&records[i * BYTES_PER_COORD]);
+        uint16x4_t x = vorr_u16(vshr_n_u16(w.val[0], 8), vshl_n_u16(w.val[1], 8));
+        uint16x4_t y = vorr_u16(vshr_n_u16(w.val[1], 8), vshl_n_u16(w.val[2], 8));
+        uint16x4x3_t o;
+
+        o.val[0] = vorr_u16(inPoint, vshl_n_u16(vand_u16(w.val[0], mask0F), 8));
+        o.val[1] = x;
+        o.val[2] = y;
+
+        vst3_u16((uint16_t*)&points[i * sizeof(inputpoint)], o);
+    }
+#endif
+
+    GoodixDecodePointsScalar(&records[i * BYTES_PER_COORD],
+                             count - i,
+                             &points[i * sizeof(inputpoint)]);
+}
+
+VOID
+TouchProfileInit(
+    _In_ const TOUCH_CONFIG* Config,
+    _Out_ PTOUCH_PROFILE Profile
+)
+/*++
+
+  Routine Description:
+
+    Fills in the touch collection profile from the configuration, clamping
+    every setting to what the report layout can carry.
+
+  Arguments:
+
+    Config - the touch settings
+
+    Profile - receives the profile
+
+  Return Value:
+
+    None
+
+--*/
+{
+    RtlZeroMemory(Profile, sizeof(TOUCH_PROFILE));
+
+    Profile->MaxContacts = (UCHAR)min(max(Config->MaxContacts, 1), MAX_POINT_NUM);
+    Profile->ContactsPerReport = Profile->MaxContacts;
+    if (Config->ContactsPerReport != 0 && Config->ContactsPerReport < Profile->MaxContacts) {
+        Profile->ContactsPerReport = (UCHAR)Config->ContactsPerReport;
+    }
+    Profile->Usages = (UCHAR)(Config->TouchUsages & TOUCH_USAGES_DEFAULT);
+    Profile->LogicalMaxX = TOUCH_LOGICAL_MAX;
+    Profile->LogicalMaxY = TOUCH_LOGICAL_MAX;
+
+    //
+    // Report ID, one inputpoint per finger collection and the contact count.
+    //
+    Profile->ReportLength = (USHORT)(1 + Profile->ContactsPerReport * sizeof(inputpoint) + 1);
+
+    //
+    // The decoder sets tip (bit 0), in range (bit 1) and confidence (bit 2);
+    // the generated report only carries the usages that are enabled, packed
+    // from bit 0 up.
+    //
+    for (UCHAR state = 0; state < ARRAYSIZE(Profile->StateMap); state++)
+    {
+        UCHAR packed = state & 0x01;
+        UCHAR bit = 1;
+
+        if (Profile->Usages & TOUCH_USAGE_IN_RANGE) {
+            packed |= ((state >> 1) & 0x01) << bit++;
+        }
+
+        if (Profile->Usages & TOUCH_USAGE_CONFIDENCE) {
+            packed |= ((state >> 2) & 0x01) << bit++;
+        }
+
+        Profile->StateMap[state] = packed;
+    }
+}
+
+VOID
+TouchTransformInit(
+    _In_ const TOUCH_CONFIG* Config,
+    _In_ const TOUCH_PROFILE* Profile,
+    _Out_ PTOUCH_TRANSFORM Transform
+)
+/*++
+
+  Routine Description:
+
+    Builds the controller to logical coordinate matrix from the
+    configuration. Each axis is first scaled from [Min, Max] onto the logical
+    range of the profile; XYExchange then swaps the rows, XRevert and
+    YRevert mirror the reported axes, and CalibrationMatrix is applied on
+    top in logical space.
+
+  Arguments:
+
+    Config - the orientation, range and calibration settings
+
+    Profile - supplies the logical range of each axis
+
+    Transform - receives the precomputed matrix
+
+--*/
+{
+    const LONG* calibration = Config->CalibrationMatrix;
+    LONGLONG xRange = (Config->XMax > Config->XMin) ? (LONGLONG)Config->XMax - Config->XMin : 1;
+    LONGLONG yRange = (Config->YMax > Config->YMin) ? (LONGLONG)Config->YMax - Config->YMin : 1;
+    LONGLONG xLogical = (LONGLONG)Profile->LogicalMaxX << TOUCH_TRANSFORM_SHIFT;
+    LONGLONG yLogical = (LONGLONG)Profile->LogicalMaxY << TOUCH_TRANSFORM_SHIFT;
+    LONGLONG xScale;
+    LONGLONG yScale;
+    TOUCH_TRANSFORM o = { 0 };
+
+    //
+    // With the axes exchanged the controller Y axis lands on the logical
+    // X axis, so it is scaled to that range.
+    //
+    xScale = (Config->XYExchange ? yLogical : xLogical) / xRange;
+    yScale = (Config->XYExchange ? xLogical : yLogical) / yRange;
+
+    o.Xx = xScale;
+    o.X0 = -xScale * Config->XMin;
+    o.Yy = yScale;
+    o.Y0 = -yScale * Config->YMin;
+
+    if (Config->XYExchange) {
+        TOUCH_TRANSFORM t = o;
+
+        o.Xx = t.Yx;
+        o.Xy = t.Yy;
+        o.X0 = t.Y0;
+        o.Yx = t.Xx;
+        o.Yy = t.Xy;
+        o.Y0 = t.X0;
+    }
+
+    if (Config->XRevert) {
+        o.Xx = -o.Xx;
+        o.Xy = -o.Xy;
+        o.X0 = xLogical - o.X0;
+    }
+
+    if (Config->YRevert) {
+        o.Yx = -o.Yx;
+        o.Yy = -o.Yy;
+        o.Y0 = yLogical - o.Y0;
+    }
+
+    //
+    // CalibrationMatrix holds { a, b, c, d, e, f } with a, b, d, e in
+    // TOUCH_TRANSFORM_SHIFT fixed point and c, f in logical units.
+    //
+    Transform->Xx = (calibration[0] * o.Xx + calibration[1] * o.Yx) >> TOUCH_TRANSFORM_SHIFT;
+    Transform->Xy = (calibration[0] * o.Xy + calibration[1] * o.Yy) >> TOUCH_TRANSFORM_SHIFT;
+    Transform->X0 = ((calibration[0] * o.X0 + calibration[1] * o.Y0) >> TOUCH_TRANSFORM_SHIFT) +
+                    ((LONGLONG)calibration[2] << TOUCH_TRANSFORM_SHIFT);
+    Transform->Yx = (calibration[3] * o.Xx + calibration[4] * o.Yx) >> TOUCH_TRANSFORM_SHIFT;
+    Transform->Yy = (calibration[3] * o.Xy + calibration[4] * o.Yy) >> TOUCH_TRANSFORM_SHIFT;
+    Transform->Y0 = ((calibration[3] * o.X0 + calibration[4] * o.Y0) >> TOUCH_TRANSFORM_SHIFT) +
+                    ((LONGLONG)calibration[5] << TOUCH_TRANSFORM_SHIFT);
+
+    //
+    // Round to nearest when the result is shifted down.
+    //
+    Transform->X0 += TOUCH_TRANSFORM_ONE / 2;
+    Transform->Y0 += TOUCH_TRANSFORM_ONE / 2;
+
+    Transform->XLimit = Profile->LogicalMaxX;
+    Transform->YLimit = Profile->LogicalMaxY;
+}
+
+VOID
+TouchTransformPoints(
+    _In_ const TOUCH_TRANSFORM* Transform,
+    _Inout_updates_bytes_(count * sizeof(inputpoint)) UINT8* points,
+    _In_ UINT8 count
+)
+/*++
+
+  Routine Description:
+
+    Maps the raw controller coordinates written by GoodixDecodePoints into
+    the logical range in place. Two multiply-adds per axis and a clamp,
+    with no per-contact branches on the orientation settings.
+
+--*/
+{
+    for (UINT8 i = 0; i < count; i++)
+    {
+        UINT8* point = &points[i * sizeof(inputpoint)];
+        LONGLONG rawX = point[2] | (point[3] << 8);
+        LONGLONG rawY = point[4] | (point[5] << 8);
+        LONGLONG x = (Transform->Xx * rawX + Transform->Xy * rawY + Transform->X0) >> TOUCH_TRANSFORM_SHIFT;
+        LONGLONG y = (Transform->Yx * rawX + Transform->Yy * rawY + Transform->Y0) >> TOUCH_TRANSFORM_SHIFT;
+
+        x = max(x, 0);
+        x = min(x, Transform->XLimit);
+        y = max(y, 0);
+        y = min(y, Transform->YLimit);
+
+        point[2] = (UINT8)x;
+        point[3] = (UINT8)(x >> 8);
+        point[4] = (UINT8)y;
+        point[5] = (UINT8)(y >> 8);
+    }
+}
+
+VOID
+HidWriterItem(
+    _Inout_ PHID_DESCRIPTOR_WRITER Writer,
+    _In_ UCHAR Prefix,
+    _In_ LONG Value
+)
+/*++
+
+  Routine Description:
+
+    Appends a short item to a report descriptor. The data is the smallest
+    size that holds Value as a signed number, which is valid for every
+    item the builder emits. Once the buffer is full further items are only
+    counted so the caller can detect the overflow from Length.
+
+  Arguments:
+
+    Writer - the descriptor being built
+    Prefix - item tag and type with the size bits clear
+    Value - item data
+
+  Return Value:
+
+    None
+
+--*/
+{
+    UCHAR sizeCode;
+    ULONG dataSize;
+
+    if (Value == 0) {
+        sizeCode = 0;
+        dataSize = 0;
+    }
+    else if (Value >= -0x80 && Value <= 0x7F) {
+        sizeCode = 1;
+        dataSize = 1;
+    }
+    else if (Value >= -0x8000 && Value <= 0x7FFF) {
+        sizeCode = 2;
+        dataSize = 2;
+    }
+    else {
+        sizeCode = 3;
+        dataSize = 4;
+    }
+
+    if (Writer->Length + 1 + dataSize <= Writer->Size) {
+        Writer->Buffer[Writer->Length] = Prefix | sizeCode;
+        for (ULONG i = 0; i < dataSize; i++)
+        {
+            Writer->Buffer[Writer->Length + 1 + i] = (UCHAR)((ULONG)Value >> (i * 8));
+        }
+    }
+
+    Writer->Length += 1 + dataSize;
+}
+
+NTSTATUS
+TouchReportDescriptorBuild(
+    _In_ const TOUCH_PROFILE* Profile,
+    _Out_writes_bytes_to_(Size, *Length) PUCHAR Buffer,
+    _In_ ULONG Size,
+    _Out_ PUSHORT Length
+)
+/*++
+
+  Routine Description:
+
+    Generates the touch screen report descriptor for a profile: one finger
+    logical collection per contact carried in a report, followed by the
+    contact count input and the contact count maximum feature, all under
+    report ID 0x54.
+
+  Arguments:
+
+    Profile - the touch collection profile
+    Buffer - receives the report descriptor
+    Size - size of Buffer in bytes
+    Length - receives the length of the descriptor
+
+  Return Value:
+
+    STATUS_SUCCESS, or STATUS_BUFFER_TOO_SMALL if Buffer cannot hold it.
+
+--*/
+{
+    HID_DESCRIPTOR_WRITER writer = { Buffer, Size, 0 };
+    LONG stateBits = 1;
+
+    if (Profile->Usages & TOUCH_USAGE_IN_RANGE) {
+        stateBits++;
+    }
+
+    if (Profile->Usages & TOUCH_USAGE_CONFIDENCE) {
+        stateBits++;
+    }
+
+    HidWriterItem(&writer, HID_ITEM_USAGE_PAGE, 0x0D);          // Digitizer Device Page
+    HidWriterItem(&writer, HID_ITEM_USAGE, 0x04);               // Touch Screen
+    HidWriterItem(&writer, HID_ITEM_COLLECTION, 0x01);          // Application
+    HidWriterItem(&writer, HID_ITEM_REPORT_ID, TOUCH_REPORT_ID);
+
+    for (UCHAR i = 0; i < Profile->ContactsPerReport; i++)
+    {
+        HidWriterItem(&writer, HID_ITEM_USAGE_PAGE, 0x0D);      // Digitizer Device Page
+        HidWriterItem(&writer, HID_ITEM_USAGE, 0x22);           // Finger
+        HidWriterItem(&writer, HID_ITEM_COLLECTION, 0x02);      // Logical
+
+        HidWriterItem(&writer, HID_ITEM_LOGICAL_MINIMUM, 0);
+        HidWriterItem(&writer, HID_ITEM_LOGICAL_MAXIMUM, 1);
+        HidWriterItem(&writer, HID_ITEM_REPORT_SIZE, 1);
+        HidWriterItem(&writer, HID_ITEM_REPORT_COUNT, 1);
+        HidWriterItem(&writer, HID_ITEM_USAGE, 0x42);           // Tip Switch
+        HidWriterItem(&writer, HID_ITEM_INPUT, 0x02);           // Data, Var, Abs
+
+        if (Profile->Usages & TOUCH_USAGE_IN_RANGE) {
+            HidWriterItem(&writer, HID_ITEM_USAGE, 0x32);       // In Range
+            HidWriterItem(&writer, HID_ITEM_INPUT, 0x02);
+        }
+
+        if (Profile->Usages & TOUCH_USAGE_CONFIDENCE) {
+            HidWriterItem(&writer, HID_ITEM_USAGE, 0x47);       // Confidence
+            HidWriterItem(&writer, HID_ITEM_INPUT, 0x02);
+        }
+
+        HidWriterItem(&writer, HID_ITEM_REPORT_COUNT, 8 - stateBits);
+        HidWriterItem(&writer, HID_ITEM_INPUT, 0x03);           // Cnst, Var, Abs
+
+        HidWriterItem(&writer, HID_ITEM_LOGICAL_MAXIMUM, 0x0F);
+        HidWriterItem(&writer, HID_ITEM_REPORT_SIZE, 8);
+        HidWriterItem(&writer, HID_ITEM_REPORT_COUNT, 1);
+        HidWriterItem(&writer, HID_ITEM_USAGE, 0x51);           // Contact Identifier
+        HidWriterItem(&writer, HID_ITEM_INPUT, 0x02);
+
+        HidWriterItem(&writer, HID_ITEM_USAGE_PAGE, 0x01);      // Generic Desktop Page
+        HidWriterItem(&writer, HID_ITEM_REPORT_SIZE, 16);
+        HidWriterItem(&writer, HID_ITEM_LOGICAL_MAXIMUM, Profile->LogicalMaxX);
+        HidWriterItem(&writer, HID_ITEM_USAGE, 0x30);           // X
+        HidWriterItem(&writer, HID_ITEM_INPUT, 0x02);
+        HidWriterItem(&writer, HID_ITEM_LOGICAL_MAXIMUM, Profile->LogicalMaxY);
+        HidWriterItem(&writer, HID_ITEM_USAGE, 0x31);           // Y
+        HidWriterItem(&writer, HID_ITEM_INPUT, 0x02);
+
+        HidWriterItem(&writer, HID_ITEM_END_COLLECTION, 0);
+    }
+
+    HidWriterItem(&writer, HID_ITEM_USAGE_PAGE, 0x0D);          // Digitizer Device Page
+    HidWriterItem(&writer, HID_ITEM_REPORT_SIZE, 8);
+    HidWriterItem(&writer, HID_ITEM_LOGICAL_MAXIMUM, Profile->MaxContacts);
+    HidWriterItem(&writer, HID_ITEM_USAGE, 0x54);               // Contact Count
+    HidWriterItem(&writer, HID_ITEM_INPUT, 0x02);
+    HidWriterItem(&writer, HID_ITEM_USAGE, 0x55);               // Contact Count Maximum
+    HidWriterItem(&writer, HID_ITEM_FEATURE, 0x02);
+    HidWriterItem(&writer, HID_ITEM_END_COLLECTION, 0);
+
+    if (writer.Length > Size) {
+        *Length = 0;
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    *Length = (USHORT)writer.Length;
+    return STATUS_SUCCESS;
+}
+
+ULONG
+TouchReportPack(
+    _In_ const TOUCH_PROFILE* Profile,
+    _In_ const inputReport54_t* Report,
+    _Out_writes_bytes_(sizeof(inputReport54_t)) PUCHAR Buffer
+)
+/*++
+
+  Routine Description:
+
+    Packs a report into the layout described by the generated descriptor:
+    the report ID, ContactsPerReport inputpoints and the contact count.
+    Slots past the contacts present are zero and stay zero.
+
+  Arguments:
+
+    Profile - the touch collection profile
+    Report - the decoded report
+    Buffer - receives the packed report
+
+  Return Value:
+
+    Length of the packed report in bytes.
+
+--*/
+{
+    ULONG pointBytes = Profile->ContactsPerReport * sizeof(inputpoint);
+
+    Buffer[0] = Report->reportId;
+    RtlCopyMemory(&Buffer[1], Report->points, pointBytes);
+
+    for (UCHAR i = 0; i < Profile->ContactsPerReport; i++)
+    {
+        PUCHAR state = &Buffer[1 + i * sizeof(inputpoint)];
+
+        *state = Profile->StateMap[*state & 0x07];
+    }
+
+    Buffer[1 + pointBytes] = Report->DIG_TouchScreenContactCount;
+
+    return Profile->ReportLength;
+}
+
+UCHAR
+TouchReportSlice(
+    _In_ const TOUCH_PROFILE* Profile,
+    _In_ const inputReport54_t* Frame,
+    _In_ UCHAR Offset,
+    _Out_ inputReport54_t* Report
+)
+/*++
+
+  Routine Description:
+
+    Copies the next ContactsPerReport contacts of a frame, starting at
+    Offset, into a report of their own. The first slice of a frame carries
+    its total contact count and later slices carry zero, which is how a
+    hybrid mode host puts the frame back together.
+
+  Arguments:
+
+    Profile - the touch collection profile
+
+    Frame - the complete decoded frame
+
+    Offset - index of the first contact to copy
+
+    Report - receives the slice
+
+  Return Value:
+
+    Offset of the next slice; equal to or past the contact count of Frame
+    once the frame has been consumed.
+
+--*/
+{
+    UCHAR total = Frame->DIG_TouchScreenContactCount;
+    UCHAR take = (Offset < total) ? (UCHAR)min(total - Offset, Profile->ContactsPerReport) : 0;
+
+    RtlZeroMemory(Report, sizeof(inputReport54_t));
+    Report->reportId = Frame->reportId;
+    RtlCopyMemory(Report->points,
+                  &Frame->points[Offset * sizeof(inputpoint)],
+                  take * sizeof(inputpoint));
+    Report->DIG_TouchScreenContactCount = (Offset == 0) ? total : 0;
+
+    return Offset + max(take, 1);
+}
+
+BOOLEAN
+TouchReportGetMotionSet(
+    _In_ inputReport54_t* pReport,
+    _Out_ USHORT* idMask
+)
+/*++
+
+  Routine Description:
+
+    Checks whether a report only moves contacts, that is every contact it
+    carries still has its tip down, and returns the set of contact IDs.
+
+  Return Value:
+
+    TRUE if the report is motion-only.
+
+--*/
+{
+    inputpoint* points = (inputpoint*)pReport->points;
+    UINT8 count = pReport->DIG_TouchScreenContactCount;
+
+    *idMask = 0;
+
+    if (count == 0 || count > MAX_POINT_NUM)
+        return FALSE;
+
+    for (UINT8 i = 0; i < count; i++)
+    {
+        if ((points[i].DIG_TouchScreenFingerState & 0x01) == 0)
+            return FALSE;
+
+        *idMask |= (USHORT)(1 << (points[i].DIG_TouchScreenFingerContactIdentifier & 0x0F));
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+TouchReportMergeLifts(
+    _In_ const inputReport54_t* Older,
+    _Inout_ inputReport54_t* Newer,
+    _In_ UINT8 capacity
+)
+/*++
+
+  Routine Description:
+
+    Carries the lifts of a report that is about to be discarded over to a
+    newer one, so the host still sees every contact go up. A lift for a
+    contact the newer report already lifts is dropped as a duplicate; if
+    the newer report has the track ID down again, the lift takes its
+    place and the returning contact goes out with the next frame.
+
+  Arguments:
+
+    Older - the report being discarded
+
+    Newer - the report that replaces it; receives the lifts
+
+    capacity - number of points a report can carry, at most MAX_POINT_NUM
+
+  Return Value:
+
+    TRUE unless a lift had to be dropped because Newer was full.
+
+--*/
+{
+    const inputpoint* older = (const inputpoint*)Older->points;
+    inputpoint* newer = (inputpoint*)Newer->points;
+    UINT8 olderCount = min(Older->DIG_TouchScreenContactCount, MAX_POINT_NUM);
+    UINT8 newerCount = min(Newer->DIG_TouchScreenContactCount, MAX_POINT_NUM);
+    BOOLEAN merged = TRUE;
+    UINT8 id;
+    UINT8 j;
+
+    capacity = min(capacity, MAX_POINT_NUM);
+
+    for (UINT8 i = 0; i < olderCount; i++)
+    {
+        if (older[i].DIG_TouchScreenFingerState & 0x01)
+            continue;
+
+        id = older[i].DIG_TouchScreenFingerContactIdentifier & 0x0F;
+        for (j = 0; j < newerCount; j++)
+        {
+            if ((newer[j].DIG_TouchScreenFingerContactIdentifier & 0x0F) == id)
+                break;
+        }
+
+        if (j < newerCount)
+        {
+            if (newer[j].DIG_TouchScreenFingerState & 0x01)
+                newer[j] = older[i];
+        }
+        else if (newerCount < capacity)
+        {
+            newer[newerCount++] = older[i];
+        }
+        else
+        {
+            merged = FALSE;
+        }
+    }
+
+    Newer->DIG_TouchScreenContactCount = newerCount;
+
+    return merged;
+}
+
+VOID
+ReportRingInit(
+    _Out_ PREPORT_RING pRing,
+    _In_ PREPORT_RING_CELL pCells,
+    _In_ ULONG cellCount
+)
+/*++
+
+  Routine Description:
+
+    Sets up an empty ring over cellCount cells, which must be a power of
+    two of at least 2.
+
+--*/
+{
+    RtlZeroMemory(pRing, sizeof(REPORT_RING));
+
+    for (ULONG i = 0; i < cellCount; i++)
+    {
+        pCells[i].Sequence = (LONG)i;
+    }
+
+    pRing->Cells = pCells;
+    pRing->Mask = cellCount - 1;
+}
+
+BOOLEAN
+ReportRingPush(
+    _In_ PREPORT_RING pRing,
+    _In_ inputReport54_t* pReport,
+    _In_ PREPORT_TIMES pTimes
+)
+{
+    PREPORT_RING_CELL cell;
+    LONG pos = ReadAcquire(&pRing->EnqueuePos);
+    LONG diff;
+
+    for (;;)
+    {
+        cell = &pRing->Cells[(ULONG)pos & pRing->Mask];
+        diff = ReadAcquire(&cell->Sequence) - pos;
+
+        if (diff == 0)
+        {
+            if (InterlockedCompareExchange(&pRing->EnqueuePos, pos + 1, pos) == pos)
+                break;
+            pos = ReadAcquire(&pRing->EnqueuePos);
+        }
+        else if (diff < 0)
+        {
+            return FALSE;
+        }
+        else
+        {
+            pos = ReadAcquire(&pRing->EnqueuePos);
+        }
+    }
+
+    RtlCopyMemory(&cell->Report, pReport, sizeof(inputReport54_t));
+    cell->Times = *pTimes;
+    WriteRelease(&cell->Sequence, pos + 1);
+
+    return TRUE;
+}
+
+BOOLEAN
+ReportRingPop(
+    _In_ PREPORT_RING pRing,
+    _Out_ inputReport54_t* pReport,
+    _Out_ PREPORT_TIMES pTimes
+)
+{
+    PREPORT_RING_CELL cell;
+    LONG pos = ReadAcquire(&pRing->DequeuePos);
+    LONG diff;
+
+    for (;;)
+    {
+        cell = &pRing->Cells[(ULONG)pos & pRing->Mask];
+        diff = ReadAcquire(&cell->Sequence) - (pos + 1);
+
+        if (diff == 0)
+        {
+            if (InterlockedCompareExchange(&pRing->DequeuePos, pos + 1, pos) == pos)
+                break;
+            pos = ReadAcquire(&pRing->DequeuePos);
+        }
+        else if (diff < 0)
+        {
+            return FALSE;
+        }
+        else
+        {
+            pos = ReadAcquire(&pRing->DequeuePos);
+        }
+    }
+
+    RtlCopyMemory(pReport, &cell->Report, sizeof(inputReport54_t));
+    *pTimes = cell->Times;
+    WriteRelease(&cell->Sequence, pos + (LONG)pRing->Mask + 1);
+
+    return TRUE;
+}
+
+BOOLEAN
+ReportRingPopMotion(
+    _In_ PREPORT_RING pRing,
+    _Inout_ inputReport54_t* pReport,
+    _Inout_ PREPORT_TIMES pTimes
+)
+/*++
+
+  Routine Description:
+
+    Replaces pReport with the next report in the ring, but only if both are
+    motion-only reports for the same set of contacts. The next report is
+    inspected in place; it cannot change underneath us while its sequence
+    marks it filled and DequeuePos still points at it, and the claiming
+    compare-exchange fails if another consumer took it first. The merged
+    report takes over the times of the newer one.
+
+  Return Value:
+
+    TRUE if a report was merged into pReport.
+
+--*/
+{
+    PREPORT_RING_CELL cell;
+    LONG pos = ReadAcquire(&pRing->DequeuePos);
+    USHORT currentMask;
+    USHORT nextMask;
+
+    if (!TouchReportGetMotionSet(pReport, &currentMask))
+        return FALSE;
+
+    cell = &pRing->Cells[(ULONG)pos & pRing->Mask];
+    if (ReadAcquire(&cell->Sequence) != pos + 1)
+        return FALSE;
+
+    if (!TouchReportGetMotionSet(&cell->Report, &nextMask) ||
+        nextMask != currentMask ||
+        cell->Report.DIG_TouchScreenContactCount != pReport->DIG_TouchScreenContactCount)
+        return FALSE;
+
+    if (InterlockedCompareExchange(&pRing->DequeuePos, pos + 1, pos) != pos)
+        return FALSE;
+
+    RtlCopyMemory(pReport, &cell->Report, sizeof(inputReport54_t));
+    *pTimes = cell->Times;
+    WriteRelease(&cell->Sequence, pos + (LONG)pRing->Mask + 1);
+
+    return TRUE;
+}
+
+VOID
+TouchTrackerReset(
+    _Out_ PTOUCH_TRACKER Tracker
+)
+{
+    RtlZeroMemory(Tracker, sizeof(TOUCH_TRACKER));
+}
+
+UINT8
+TouchTrackerUpdate(
+    _Inout_ PTOUCH_TRACKER Tracker,
+    _Inout_updates_bytes_(MAX_POINT_NUM * sizeof(inputpoint)) UINT8* points,
+    _In_ UINT8 count,
+    _In_ UINT8 capacity
+)
+/*++
+
+  Routine Description:
+
+    Diffs the contacts of a decoded frame against the ones still down and
+    appends a tip-up point for each contact that has gone, at the position
+    it was last reported. A contact is lifted exactly once; lifts that do
+    not fit in the report stay pending and go out with the next frame,
+    unless the contact has come back by then. A track ID the controller
+    reports twice in one frame is only kept once.
+
+  Arguments:
+
+    Tracker - contact state carried from frame to frame
+
+    points - the frame's points, as decoded and transformed; receives the
+        lift points after them
+
+    count - number of points in the frame
+
+    capacity - number of points the report can carry, at most MAX_POINT_NUM
+
+  Return Value:
+
+    Number of points in the report, zero if there is nothing to report.
+
+--*/
+{
+    inputpoint* point = (inputpoint*)points;
+    USHORT current = 0;
+    USHORT departed;
+    UINT8 kept = 0;
+    ULONG id;
+
+    capacity = min(capacity, MAX_POINT_NUM);
+    count = min(count, capacity);
+
+    for (UINT8 i = 0; i < count; i++)
+    {
+        id = point[i].DIG_TouchScreenFingerContactIdentifier & 0x0F;
+        if (current & (1 << id))
+            continue;
+
+        current |= (USHORT)(1 << id);
+        Tracker->Last[id] = point[i];
+        point[kept++] = point[i];
+    }
+
+    departed = Tracker->ActiveMask & (USHORT)~current;
+
+    while (departed != 0 && kept < capacity)
+    {
+        BitScanForward(&id, departed);
+        departed &= departed - 1;
+
+        point[kept] = Tracker->Last[id];
+        point[kept].DIG_TouchScreenFingerState &= (BYTE)~0x01;
+        kept++;
+    }
+
+    Tracker->ActiveMask = current | departed;
+
+    return kept;
+}
+
+VOID
+TouchFilterInit(
+    _In_ PTOUCH_CONFIG Config,
+    _Out_ PTOUCH_FILTER Filter
+)
+{
+    RtlZeroMemory(Filter, sizeof(TOUCH_FILTER));
+
+    Filter->MinCutoff = Config->FilterMinCutoff;
+    Filter->Beta = Config->FilterBeta;
+    Filter->DerivCutoff = Config->FilterDerivCutoff;
+}
+
+LONG
+TouchFilterAlpha(
+    _In_ ULONG cutoff,
+    _In_ LONGLONG elapsed,
+    _In_ LONGLONG frequency
+)
+/*++
+
+  Routine Description:
+
+    Smoothing factor of a first-order low-pass with the given cutoff for a
+    sample interval of elapsed performance counter ticks:
+
+        alpha = r / (r + 1),  r = 2 * pi * cutoff * interval
+
+  Return Value:
+
+    alpha with 16 fraction bits, in [0, TOUCH_FILTER_ALPHA_ONE].
+
+--*/
+{
+    LONGLONG interval;
+    LONGLONG r;
+
+    if (frequency <= 0 || elapsed >= frequency)
+        return TOUCH_FILTER_ALPHA_ONE;
+
+    //
+    // interval in seconds and r both with 16 fraction bits
+    //
+    interval = (elapsed << 16) / frequency;
+    r = (TOUCH_FILTER_TWO_PI * (LONGLONG)min(cutoff, TOUCH_FILTER_CUTOFF_MAX) * interval) / (1000 << 16);
+
+    return (LONG)((r << 16) / (r + TOUCH_FILTER_ALPHA_ONE));
+}
+
+LONG
+TouchFilterAxis(
+    _In_ PTOUCH_FILTER Filter,
+    _Inout_ PTOUCH_FILTER_AXIS Axis,
+    _In_ LONG raw,
+    _In_ LONGLONG elapsed,
+    _In_ LONGLONG frequency
+)
+/*++
+
+  Routine Description:
+
+    Runs one coordinate through the filter: updates the smoothed speed from
+    the distance to the previous output, derives the cutoff from it and
+    moves the output towards the new sample.
+
+  Return Value:
+
+    The filtered coordinate in logical units.
+
+--*/
+{
+    LONG target = raw << TOUCH_FILTER_SHIFT;
+    LONGLONG speed;
+    LONGLONG cutoff;
+    LONG alpha;
+
+    speed = ((LONGLONG)(target - Axis->Value) * frequency) / elapsed;
+    alpha = TouchFilterAlpha(Filter->DerivCutoff, elapsed, frequency);
+    Axis->Speed += ((speed - Axis->Speed) * alpha) >> 16;
+
+    speed = (Axis->Speed < 0 ? -Axis->Speed : Axis->Speed) >> TOUCH_FILTER_SHIFT;
+    cutoff = Filter->MinCutoff + ((LONGLONG)Filter->Beta * min(speed, TOUCH_FILTER_SPEED_MAX)) / 1000;
+    alpha = TouchFilterAlpha((ULONG)min(cutoff, TOUCH_FILTER_CUTOFF_MAX), elapsed, frequency);
+
+    Axis->Value += (LONG)(((LONGLONG)(target - Axis->Value) * alpha) >> 16);
+
+    return (Axis->Value + (1 << (TOUCH_FILTER_SHIFT - 1))) >> TOUCH_FILTER_SHIFT;
+}
+
+BOOLEAN
+TouchFilterPoints(
+    _Inout_ PTOUCH_FILTER Filter,
+    _Inout_updates_bytes_(count * sizeof(inputpoint)) UINT8* points,
+    _In_ UINT8 count,
+    _In_ LONGLONG timestamp,
+    _In_ LONGLONG frequency
+)
+/*++
+
+  Routine Description:
+
+    Filters the positions of a frame's contacts in place. A contact that
+    was not down in the previous frame starts the filter at its reported
+    position, so touch-down is never delayed.
+
+  Arguments:
+
+    Filter - per-device filter state
+
+    points - the frame's points, after TouchTransformPoints
+
+    count - number of points
+
+    timestamp - performance counter value of the frame
+
+    frequency - performance counter ticks per second
+
+  Return Value:
+
+    TRUE if any contact is new or ended up at a different position than
+    the filter put it at in the previous frame.
+
+--*/
+{
+    inputpoint* point = (inputpoint*)points;
+    USHORT current = 0;
+    BOOLEAN changed = FALSE;
+
+    for (UINT8 i = 0; i < count; i++)
+    {
+        ULONG id = point[i].DIG_TouchScreenFingerContactIdentifier & 0x0F;
+        LONG x = point[i].GD_TouchScreenFingerXL | (point[i].GD_TouchScreenFingerXH << 8);
+        LONG y = point[i].GD_TouchScreenFingerYL | (point[i].GD_TouchScreenFingerYH << 8);
+        LONGLONG elapsed = timestamp - Filter->LastTime[id];
+
+        current |= (USHORT)(1 << id);
+
+        if ((Filter->ActiveMask & (1 << id)) == 0 || elapsed <= 0)
+        {
+            Filter->X[id].Value = x << TOUCH_FILTER_SHIFT;
+            Filter->X[id].Speed = 0;
+            Filter->Y[id].Value = y << TOUCH_FILTER_SHIFT;
+            Filter->Y[id].Speed = 0;
+            changed = TRUE;
+        }
+        else
+        {
+            x = TouchFilterAxis(Filter, &Filter->X[id], x, elapsed, frequency);
+            y = TouchFilterAxis(Filter, &Filter->Y[id], y, elapsed, frequency);
+
+            point[i].GD_TouchScreenFingerXL = (BYTE)x;
+            point[i].GD_TouchScreenFingerXH = (BYTE)(x >> 8);
+            point[i].GD_TouchScreenFingerYL = (BYTE)y;
+            point[i].GD_TouchScreenFingerYH = (BYTE)(y >> 8);
+
+            if (RtlCompareMemory(&point[i], &Filter->Last[id], sizeof(inputpoint)) != sizeof(inputpoint))
+                changed = TRUE;
+        }
+
+        Filter->LastTime[id] = timestamp;
+        Filter->Last[id] = point[i];
+    }
+
+    Filter->ActiveMask = current;
+
+    return changed;
+}
+
+VOID
+TouchPredictorInit(
+    _In_ PTOUCH_CONFIG Config,
+    _In_ PTOUCH_PROFILE Profile,
+    _Out_ PTOUCH_PREDICTOR Predictor
+)
+{
+    RtlZeroMemory(Predictor, sizeof(TOUCH_PREDICTOR));
+
+    Predictor->Horizon = min(Config->PredictionHorizon, TOUCH_PREDICT_HORIZON_MAX);
+    Predictor->XLimit = Profile->LogicalMaxX;
+    Predictor->YLimit = Profile->LogicalMaxY;
+}
+
+LONG
+TouchPredictAxis(
+    _In_ PTOUCH_PREDICTOR Predictor,
+    _Inout_ PTOUCH_PREDICT_AXIS Axis,
+    _In_ UCHAR samples,
+    _In_ LONG raw,
+    _In_ LONG limit,
+    _In_ LONGLONG elapsed,
+    _In_ LONGLONG frequency
+)
+/*++
+
+  Routine Description:
+
+    Updates the motion estimate of one coordinate and extrapolates it.
+    Velocity and acceleration are finite differences between frames, each
+    averaged with its previous value to take the edge off sensor noise.
+    Acceleration only comes in from the third sample of a contact, and its
+    share of the prediction is never allowed to exceed the velocity's, so
+    a contact that stops or turns is not thrown past where it went.
+
+  Arguments:
+
+    Predictor - per-device predictor state
+
+    Axis - the coordinate's state
+
+    samples - frames seen for the contact before this one
+
+    raw - the coordinate in this frame
+
+    limit - largest logical value of the coordinate
+
+    elapsed - performance counter ticks since the previous frame
+
+    frequency - performance counter ticks per second
+
+  Return Value:
+
+    The predicted coordinate, clamped to [0, limit].
+
+--*/
+{
+    LONGLONG velocity;
+    LONGLONG acceleration;
+    LONGLONG offset;
+    LONGLONG bend;
+
+    velocity = ((LONGLONG)(raw - Axis->Position) * frequency << TOUCH_PREDICT_SHIFT) / elapsed;
+    velocity = max(min(velocity, TOUCH_PREDICT_VELOCITY_MAX), -TOUCH_PREDICT_VELOCITY_MAX);
+
+    if (samples >= 2)
+    {
+        acceleration = ((velocity - Axis->Velocity) * frequency) / elapsed;
+        acceleration = max(min(acceleration, TOUCH_PREDICT_ACCEL_MAX), -TOUCH_PREDICT_ACCEL_MAX);
+        Axis->Acceleration = (Axis->Acceleration + acceleration) / 2;
+        Axis->Velocity = (Axis->Velocity + velocity) / 2;
+    }
+    else
+    {
+        Axis->Velocity = velocity;
+    }
+
+    Axis->Position = raw;
+
+    //
+    // v * t + a * t^2 / 2, with t in ms
+    //
+    offset = (Axis->Velocity * Predictor->Horizon) / 1000;
+    bend = (Axis->Acceleration * Predictor->Horizon * Predictor->Horizon) / 2000000;
+    bend = max(min(bend, offset < 0 ? -offset : offset), offset < 0 ? offset : -offset);
+    offset = (offset + bend + (1 << (TOUCH_PREDICT_SHIFT - 1))) >> TOUCH_PREDICT_SHIFT;
+
+    return (LONG)max(min(raw + offset, limit), 0);
+}
+
+BOOLEAN
+TouchPredictPoints(
+    _Inout_ PTOUCH_PREDICTOR Predictor,
+    _Inout_updates_bytes_(count * sizeof(inputpoint)) UINT8* points,
+    _In_ UINT8 count,
+    _In_ LONGLONG timestamp,
+    _In_ LONGLONG frequency
+)
+/*++
+
+  Routine Description:
+
+    Moves each contact of a frame to where it is expected to be Horizon
+    milliseconds later. A contact that was not down in the previous frame
+    is reported where it is and starts a fresh estimate.
+
+  Arguments:
+
+    Predictor - per-device predictor state
+
+    points - the frame's points, after filtering
+
+    count - number of points
+
+    timestamp - performance counter value of the frame
+
+    frequency - performance counter ticks per second
+
+  Return Value:
+
+    TRUE if any contact is new or its predicted position differs from the
+    one of the previous frame.
+
+--*/
+{
+    inputpoint* point = (inputpoint*)points;
+    USHORT current = 0;
+    BOOLEAN changed = FALSE;
+
+    for (UINT8 i = 0; i < count; i++)
+    {
+        ULONG id = point[i].DIG_TouchScreenFingerContactIdentifier & 0x0F;
+        LONG x = point[i].GD_TouchScreenFingerXL | (point[i].GD_TouchScreenFingerXH << 8);
+        LONG y = point[i].GD_TouchScreenFingerYL | (point[i].GD_TouchScreenFingerYH << 8);
+        LONGLONG elapsed = timestamp - Predictor->LastTime[id];
+
+        current |= (USHORT)(1 << id);
+
+        if ((Predictor->ActiveMask & (1 << id)) == 0 || elapsed <= 0 || frequency <= 0)
+        {
+            RtlZeroMemory(&Predictor->X[id], sizeof(TOUCH_PREDICT_AXIS));
+            RtlZeroMemory(&Predictor->Y[id], sizeof(TOUCH_PREDICT_AXIS));
+            Predictor->X[id].Position = x;
+            Predictor->Y[id].Position = y;
+            Predictor->Samples[id] = 1;
+            changed = TRUE;
+        }
+        else
+        {
+            x = TouchPredictAxis(Predictor, &Predictor->X[id], Predictor->Samples[id], x, Predictor->XLimit, elapsed, frequency);
+            y = TouchPredictAxis(Predictor, &Predictor->Y[id], Predictor->Samples[id], y, Predictor->YLimit, elapsed, frequency);
+            Predictor->Samples[id] = (UCHAR)min(Predictor->Samples[id] + 1, 2);
+
+            point[i].GD_TouchScreenFingerXL = (BYTE)x;
+            point[i].GD_TouchScreenFingerXH = (BYTE)(x >> 8);
+            point[i].GD_TouchScreenFingerYL = (BYTE)y;
+            point[i].GD_TouchScreenFingerYH = (BYTE)(y >> 8);
+
+            if (RtlCompareMemory(&point[i], &Predictor->Last[id], sizeof(inputpoint)) != sizeof(inputpoint))
+                changed = TRUE;
+        }
+
+        Predictor->LastTime[id] = timestamp;
+        Predictor->Last[id] = point[i];
+    }
+
+    Predictor->ActiveMask = current;
+
+    return changed;
+}
@@ -0,0 +1,628 @@
+/*++
+
+Module Name:
+
+    touchcore.h
+
+Abstract:
+
+    Types and routines for the platform-neutral part of the touch path:
+    GT9xx frame reads and point decoding, coordinate transform, report
+    descriptor generation, report packing and the report ring. Nothing here
+    calls into WDF, the SPB stack or the pool; the driver reaches the
+    controller through a TOUCH_BUS it supplies and owns every buffer. The
+    host build (CMakeLists.txt) compiles the same sources against the shim
+    in host/include.
+
+Environment:
+
+    Kernel mode or user mode
+
+--*/
+
+#ifndef __TOUCHCORE_H__
+#define __TOUCHCORE_H__
+
+#ifdef _KERNEL_MODE
+#include <ntddk.h>
+#else
+#include <windows.h>
+#endif
+
+//
+// GT9xx register map. Registers are addressed with a 16-bit big-endian
+// address written ahead of the data.
+//
+#define GOODIX_REG_COMMAND          0x8040
+#define GOODIX_REG_CONFIG           0x8047
+#define GOODIX_REG_CONFIG_CHECKSUM  0x80FF
+#define GOODIX_REG_CONFIG_FRESH     0x8100
+#define GOODIX_REG_PRODUCT_ID       0x8140
+#define GOODIX_REG_FW_VERSION       0x8144
+#define GOODIX_REG_X_RESOLUTION     0x8146
+#define GOODIX_REG_Y_RESOLUTION     0x8148
+#define GOODIX_REG_VENDOR_ID        0x814A
+#define TOUCH_INFO_ADDR             0x814E
+
+//
+// Values written to GOODIX_REG_COMMAND. In doze the controller scans at a
+// reduced rate and only raises the interrupt once a touch is seen.
+//
+#define GOODIX_CMD_READ_COORDS      0x00
+#define GOODIX_CMD_SCREEN_OFF       0x05
+#define GOODIX_CMD_DOZE             0x08
+
+#define GOODIX_ADDR_LEN             2
+#define GOODIX_CONFIG_LENGTH        (GOODIX_REG_CONFIG_CHECKSUM - GOODIX_REG_CONFIG)
+#define GOODIX_PRODUCT_ID_LENGTH    4
+
+//
+// Offsets of the fields used from the configuration block.
+//
+#define GOODIX_CONFIG_VERSION       0x00
+#define GOODIX_CONFIG_X_OUTPUT_MAX  0x01
+#define GOODIX_CONFIG_Y_OUTPUT_MAX  0x03
+#define GOODIX_CONFIG_TOUCH_NUMBER  0x05
+
+//
+// What the driver takes from the controller: identification, and the
+// version, resolution and contact count of its configuration block.
+//
+typedef struct _GOODIX_CONTROLLER_INFO
+{
+    UCHAR                   ProductId[GOODIX_PRODUCT_ID_LENGTH];
+    USHORT                  FirmwareVersion;
+    UCHAR                   ConfigVersion;
+    UCHAR                   MaxContacts;
+    USHORT                  XResolution;
+    USHORT                  YResolution;
+} GOODIX_CONTROLLER_INFO, *PGOODIX_CONTROLLER_INFO;
+
+//
+// Bits of the status byte at TOUCH_INFO_ADDR: buffer ready and the number
+// of point records that follow it.
+//
+#define GOODIX_TOUCH_EVENT          0x80
+#define GOODIX_TOUCH_COUNT_MASK     0x0F
+
+#define BYTES_PER_COORD         0x8
+#define MAX_POINT_NUM           0xA
+
+//
+// The point records are followed by a little-endian 16-bit checksum: the
+// sum of the status byte and every byte of the records before it. It sits
+// directly behind the last valid record, so it moves with the contact count.
+//
+#define BYTES_CHKSUM            0x2
+
+//
+// Status byte at TOUCH_INFO_ADDR followed by the point records.
+//
+#define TOUCH_FRAME_SIZE        (1 + MAX_POINT_NUM * BYTES_PER_COORD)
+
+//
+// A frame as read from the bus, with room for the checksum.
+//
+#define TOUCH_READ_SIZE         (TOUCH_FRAME_SIZE + BYTES_CHKSUM)
+
+#define TOUCH_REPORT_ID         0x54
+
+//
+// Logical range reported for X and Y. Controller coordinates are scaled into
+// it so the HID range does not depend on the panel resolution.
+//
+#define TOUCH_LOGICAL_MAX       0x7FFF
+#define TOUCH_TRANSFORM_SHIFT   16
+#define TOUCH_TRANSFORM_ONE     (1 << TOUCH_TRANSFORM_SHIFT)
+
+//
+// Controller to logical coordinate mapping, precomputed from the orientation
+// settings and the optional calibration matrix:
+//
+//     X = (Xx * x + Xy * y + X0) >> TOUCH_TRANSFORM_SHIFT
+//     Y = (Yx * x + Yy * y + Y0) >> TOUCH_TRANSFORM_SHIFT
+//
+typedef struct _TOUCH_TRANSFORM
+{
+    LONGLONG                Xx;
+    LONGLONG                Xy;
+    LONGLONG                X0;
+    LONGLONG                Yx;
+    LONGLONG                Yy;
+    LONGLONG                Y0;
+    LONGLONG                XLimit;
+    LONGLONG                YLimit;
+} TOUCH_TRANSFORM, *PTOUCH_TRANSFORM;
+
+typedef struct
+{
+    BYTE  reportId;                                 // Report ID = 0x54 (84) 'T'
+                                                       // Collection: TouchScreen
+    BYTE  DIG_TouchScreenContactCountMaximum;       // Usage 0x000D0055: Contact Count Maximum, Value = 0 to 8
+} featureReport54_t;
+
+typedef struct __declspec(align(2))
+{
+    BYTE  DIG_TouchScreenFingerState;               // Usage 0x000D0042: Tip Switch, Value = 0 to 1
+    BYTE  DIG_TouchScreenFingerContactIdentifier;   // Usage 0x000D0051: Contact Identifier, Value = 0 to 1
+    BYTE GD_TouchScreenFingerXL;                    // Usage 0x00010030: X, Value = 0 to 32767
+    BYTE GD_TouchScreenFingerXH;                    // Usage 0x00010030: X, Value = 0 to 32767
+    BYTE GD_TouchScreenFingerYL;                    // Usage 0x00010031: Y, Value = 0 to 32767
+    BYTE GD_TouchScreenFingerYH;                    // Usage 0x00010031: Y, Value = 0 to 32767
+}inputpoint;
+
+typedef struct __declspec(align(2))
+{
+    BYTE  reportId;                                 // Report ID = 0x54 (84) 'T'
+                                                       // Collection: TouchScreen Finger
+    BYTE points[MAX_POINT_NUM * sizeof(inputpoint)];
+
+    BYTE  DIG_TouchScreenContactCount;              // Usage 0x000D0054: Contact Count, Value = 0 to 8
+} inputReport54_t;
+
+//
+// Shape of the touch collection. The report descriptor, the input report
+// length and the packing of inputReport54_t into the wire format are all
+// derived from it, so a panel with fewer contacts gets a shorter report.
+//
+#define TOUCH_USAGE_IN_RANGE    0x01
+#define TOUCH_USAGE_CONFIDENCE  0x02
+#define TOUCH_USAGES_DEFAULT    (TOUCH_USAGE_IN_RANGE | TOUCH_USAGE_CONFIDENCE)
+
+#define TOUCH_REPORT_DESCRIPTOR_MAX_SIZE    768
+
+typedef struct _TOUCH_PROFILE
+{
+    UCHAR                   MaxContacts;
+
+    //
+    // Finger collections per report. Below MaxContacts the device runs in
+    // hybrid mode: a frame is split across consecutive reports, the first
+    // carrying the total contact count and the rest a count of zero.
+    //
+    UCHAR                   ContactsPerReport;
+    UCHAR                   Usages;
+    USHORT                  LogicalMaxX;
+    USHORT                  LogicalMaxY;
+    USHORT                  ReportLength;
+
+    //
+    // Maps the tip/in-range/confidence bits that the decoder writes to the
+    // state byte of the generated report.
+    //
+    UCHAR                   StateMap[8];
+} TOUCH_PROFILE, *PTOUCH_PROFILE;
+
+//
+// Short item prefixes (tag and type, size bits clear) used by the
+// report descriptor builder.
+//
+#define HID_ITEM_INPUT              0x80
+#define HID_ITEM_FEATURE            0xB0
+#define HID_ITEM_COLLECTION         0xA0
+#define HID_ITEM_END_COLLECTION     0xC0
+#define HID_ITEM_USAGE_PAGE         0x04
+#define HID_ITEM_LOGICAL_MINIMUM    0x14
+#define HID_ITEM_LOGICAL_MAXIMUM    0x24
+#define HID_ITEM_REPORT_SIZE        0x74
+#define HID_ITEM_REPORT_ID          0x84
+#define HID_ITEM_REPORT_COUNT       0x94
+#define HID_ITEM_USAGE              0x08
+
+typedef struct _HID_DESCRIPTOR_WRITER
+{
+    PUCHAR                  Buffer;
+    ULONG                   Size;
+    ULONG                   Length;
+} HID_DESCRIPTOR_WRITER, *PHID_DESCRIPTOR_WRITER;
+
+//
+// Settings the touch path is configured from. The driver fills this in from
+// the device's registry key; see ReadDescriptorFromRegistry.
+//
+typedef struct _TOUCH_CONFIG
+{
+    ULONG                   XRevert;
+    ULONG                   YRevert;
+    ULONG                   XYExchange;
+    ULONG                   XMin;
+    ULONG                   XMax;
+    ULONG                   YMin;
+    ULONG                   YMax;
+    ULONG                   MaxContacts;
+    ULONG                   TouchUsages;
+    ULONG                   ContactsPerReport;
+    LONG                    CalibrationMatrix[6];
+    ULONG                   FilterMinCutoff;
+    ULONG                   FilterBeta;
+    ULONG                   FilterDerivCutoff;
+    ULONG                   PredictionHorizon;
+} TOUCH_CONFIG, *PTOUCH_CONFIG;
+
+//
+// Contact lifecycle across frames, keyed by the 4-bit GT9xx track ID.
+// ActiveMask holds the IDs last reported with the tip down and not yet
+// lifted; Last keeps the point each of them was last reported at, so a
+// contact that disappears from the controller's frame can be lifted where
+// it was.
+//
+#define TOUCH_TRACK_IDS         16
+
+typedef struct _TOUCH_TRACKER
+{
+    USHORT                  ActiveMask;
+    inputpoint              Last[TOUCH_TRACK_IDS];
+} TOUCH_TRACKER, *PTOUCH_TRACKER;
+
+//
+// Adaptive low-pass filter for contact positions, after the 1-euro filter
+// of Casiez et al.: the cutoff frequency rises with the contact's speed,
+// so a resting finger is smoothed hard while fast motion passes through
+// with little lag. Everything is integer arithmetic.
+//
+//     MinCutoff   - cutoff for a stationary contact, in mHz; 0 disables
+//     Beta        - cutoff increase per logical unit per second of speed,
+//                   in uHz
+//     DerivCutoff - cutoff of the speed estimate itself, in mHz
+//
+// Positions are kept in logical units with TOUCH_FILTER_SHIFT fraction
+// bits, speeds in the same units per second.
+//
+#define TOUCH_FILTER_SHIFT      8
+#define TOUCH_FILTER_ALPHA_ONE  (1 << 16)
+#define TOUCH_FILTER_TWO_PI     411775              // 2 * pi with 16 fraction bits
+#define TOUCH_FILTER_CUTOFF_MAX 1000000             // 1 kHz, far above any scan rate
+#define TOUCH_FILTER_SPEED_MAX  0x1000000           // logical units per second
+
+#define TOUCH_FILTER_BETA_DEFAULT           2000
+#define TOUCH_FILTER_DERIV_CUTOFF_DEFAULT   1000
+
+typedef struct _TOUCH_FILTER_AXIS
+{
+    LONG                    Value;
+    LONGLONG                Speed;
+} TOUCH_FILTER_AXIS, *PTOUCH_FILTER_AXIS;
+
+typedef struct _TOUCH_FILTER
+{
+    ULONG                   MinCutoff;
+    ULONG                   Beta;
+    ULONG                   DerivCutoff;
+    USHORT                  ActiveMask;
+    LONGLONG                LastTime[TOUCH_TRACK_IDS];
+    TOUCH_FILTER_AXIS       X[TOUCH_TRACK_IDS];
+    TOUCH_FILTER_AXIS       Y[TOUCH_TRACK_IDS];
+    inputpoint              Last[TOUCH_TRACK_IDS];
+} TOUCH_FILTER, *PTOUCH_FILTER;
+
+//
+// Extrapolates each contact Horizon milliseconds ahead from its recent
+// velocity and acceleration, to make up for the time a frame spends on the
+// bus and in the report path. Velocities are in logical units per second
+// and accelerations in units per second squared, both with
+// TOUCH_PREDICT_SHIFT fraction bits. A Horizon of 0 disables prediction.
+//
+#define TOUCH_PREDICT_SHIFT         8
+#define TOUCH_PREDICT_HORIZON_MAX   100                     // ms
+#define TOUCH_PREDICT_VELOCITY_MAX  ((LONGLONG)1 << 32)     // 16M units/s
+#define TOUCH_PREDICT_ACCEL_MAX     ((LONGLONG)1 << 40)
+
+typedef struct _TOUCH_PREDICT_AXIS
+{
+    LONG                    Position;
+    LONGLONG                Velocity;
+    LONGLONG                Acceleration;
+} TOUCH_PREDICT_AXIS, *PTOUCH_PREDICT_AXIS;
+
+typedef struct _TOUCH_PREDICTOR
+{
+    ULONG                   Horizon;
+    LONG                    XLimit;
+    LONG                    YLimit;
+    USHORT                  ActiveMask;
+    UCHAR                   Samples[TOUCH_TRACK_IDS];
+    LONGLONG                LastTime[TOUCH_TRACK_IDS];
+    TOUCH_PREDICT_AXIS      X[TOUCH_TRACK_IDS];
+    TOUCH_PREDICT_AXIS      Y[TOUCH_TRACK_IDS];
+    inputpoint              Last[TOUCH_TRACK_IDS];
+} TOUCH_PREDICTOR, *PTOUCH_PREDICTOR;
+
+//
+// Performance counter values recorded for a report on its way through the
+// driver: when the interrupt for its frame was serviced and when the
+// decoded report was queued on the ring.
+//
+typedef struct _REPORT_TIMES
+{
+    LONGLONG                Interrupt;
+    LONGLONG                Queued;
+} REPORT_TIMES, *PREPORT_TIMES;
+
+//
+// Bounded ring of ready input reports. Frames decoded while hidclass has no
+// read pending are kept here until ReadReport picks them up. The ring is a
+// lock-free bounded queue: each cell carries a sequence number that tells
+// producers and consumers whether it is free or filled, so the interrupt
+// path, the SPB completion routine and concurrent ReadReport calls can all
+// use it without a lock. The cells are allocated by the caller, a power of
+// two of them.
+//
+typedef struct _REPORT_RING_CELL
+{
+    volatile LONG           Sequence;
+    REPORT_TIMES            Times;
+    inputReport54_t         Report;
+} REPORT_RING_CELL, *PREPORT_RING_CELL;
+
+typedef struct _REPORT_RING
+{
+    PREPORT_RING_CELL       Cells;
+    ULONG                   Mask;
+    volatile LONG           EnqueuePos;
+    volatile LONG           DequeuePos;
+    volatile LONG           Queued;
+    volatile LONG           Overflows;
+    volatile LONG           Coalesced;
+    volatile LONG           LiftsLost;
+} REPORT_RING, *PREPORT_RING;
+
+//
+// Register access for GoodixReadFrameFrom. The driver runs each call as one
+// SPB transaction; the host build points it at the simulator.
+//
+//     Read  - writes the register address, then reads Length bytes. With
+//             Clear set the transaction ends by writing 0 to the status
+//             byte at TOUCH_INFO_ADDR.
+//     Write - writes the register address followed by Length bytes
+//
+typedef
+NTSTATUS
+TOUCH_BUS_READ(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _Out_writes_bytes_(Length) UINT8* Buffer,
+    _In_ ULONG Length,
+    _In_ BOOLEAN Clear
+);
+
+typedef
+NTSTATUS
+TOUCH_BUS_WRITE(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _In_reads_bytes_(Length) const UINT8* Buffer,
+    _In_ ULONG Length
+);
+
+typedef struct _TOUCH_BUS
+{
+    PVOID                   Context;
+    TOUCH_BUS_READ*         Read;
+    TOUCH_BUS_WRITE*        Write;
+} TOUCH_BUS, *PTOUCH_BUS;
+
+//
+// What happened while reading a frame, for the caller's counters.
+//
+#define GOODIX_FRAME_TOP_UP         0x01    // remainder of the records read separately
+#define GOODIX_FRAME_REREAD         0x02    // records read again after a checksum mismatch
+#define GOODIX_FRAME_CORRUPT        0x04    // the re-read failed the checksum too
+#define GOODIX_FRAME_SHORT          0x08    // more contacts than fetched after the clear; dropped
+#define GOODIX_FRAME_CLEARED        0x10    // the status byte was cleared
+
+UCHAR
+GoodixConfigChecksum(
+    _In_reads_bytes_(GOODIX_CONFIG_LENGTH) const UCHAR* Config
+);
+
+BOOLEAN
+GoodixParseConfig(
+    _In_reads_bytes_(GOODIX_CONFIG_LENGTH + 1) const UCHAR* Config,
+    _Inout_ PGOODIX_CONTROLLER_INFO Info
+);
+
+USHORT
+GoodixFrameChecksum(
+    _In_reads_bytes_(1 + count * BYTES_PER_COORD) const UINT8* frame,
+    _In_ UINT8 count
+);
+
+BOOLEAN
+GoodixFrameValid(
+    _In_reads_bytes_(1 + count * BYTES_PER_COORD + BYTES_CHKSUM) const UINT8* frame,
+    _In_ UINT8 count
+);
+
+NTSTATUS
+GoodixReadFrameFrom(
+    _In_ const TOUCH_BUS* Bus,
+    _In_ UINT8 fetched,
+    _In_ BOOLEAN checksum,
+    _Out_writes_(TOUCH_READ_SIZE) UINT8* frameBuf,
+    _Out_ UINT8* touchCount,
+    _Out_ ULONG* events
+);
+
+NTSTATUS
+GoodixDozeEnter(
+    _In_ const TOUCH_BUS* Bus,
+    _Inout_ volatile LONG* Dozing
+);
+
+VOID
+GoodixDecodePoints(
+    _In_reads_bytes_(count * BYTES_PER_COORD) const UINT8* records,
+    _In_ UINT8 count,
+    _Out_writes_bytes_(count * sizeof(inputpoint)) UINT8* points
+);
+
+VOID
+GoodixDecodePointsScalar(
+    _In_reads_bytes_(count * BYTES_PER_COORD) const UINT8* records,
+    _In_ UINT8 count,
+    _Out_writes_bytes_(count * sizeof(inputpoint)) UINT8* points
+);
+
+VOID
+TouchProfileInit(
+    _In_ const TOUCH_CONFIG* Config,
+    _Out_ PTOUCH_PROFILE Profile
+);
+
+VOID
+TouchTransformInit(
+    _In_ const TOUCH_CONFIG* Config,
+    _In_ const TOUCH_PROFILE* Profile,
+    _Out_ PTOUCH_TRANSFORM Transform
+);
+
+VOID
+TouchTransformPoints(
+    _In_ const TOUCH_TRANSFORM* Transform,
+    _Inout_updates_bytes_(count * sizeof(inputpoint)) UINT8* points,
+    _In_ UINT8 count
+);
+
+VOID
+HidWriterItem(
+    _Inout_ PHID_DESCRIPTOR_WRITER Writer,
+    _In_ UCHAR Prefix,
+    _In_ LONG Value
+);
+
+NTSTATUS
+TouchReportDescriptorBuild(
+    _In_ const TOUCH_PROFILE* Profile,
+    _Out_writes_bytes_to_(Size, *Length) PUCHAR Buffer,
+    _In_ ULONG Size,
+    _Out_ PUSHORT Length
+);
+
+ULONG
+TouchReportPack(
+    _In_ const TOUCH_PROFILE* Profile,
+    _In_ const inputReport54_t* Report,
+    _Out_writes_bytes_(sizeof(inputReport54_t)) PUCHAR Buffer
+);
+
+UCHAR
+TouchReportSlice(
+    _In_ const TOUCH_PROFILE* Profile,
+    _In_ const inputReport54_t* Frame,
+    _In_ UCHAR Offset,
+    _Out_ inputReport54_t* Report
+);
+
+BOOLEAN
+TouchReportGetMotionSet(
+    _In_ inputReport54_t* pReport,
+    _Out_ USHORT* idMask
+);
+
+BOOLEAN
+TouchReportMergeLifts(
+    _In_ const inputReport54_t* Older,
+    _Inout_ inputReport54_t* Newer,
+    _In_ UINT8 capacity
+);
+
+VOID
+ReportRingInit(
+    _Out_ PREPORT_RING pRing,
+    _In_ PREPORT_RING_CELL pCells,
+    _In_ ULONG cellCount
+);
+
+BOOLEAN
+ReportRingPush(
+    _In_ PREPORT_RING pRing,
+    _In_ inputReport54_t* pReport,
+    _In_ PREPORT_TIMES pTimes
+);
+
+BOOLEAN
+ReportRingPop(
+    _In_ PREPORT_RING pRing,
+    _Out_ inputReport54_t* pReport,
+    _Out_ PREPORT_TIMES pTimes
+);
+
+BOOLEAN
+ReportRingPopMotion(
+    _In_ PREPORT_RING pRing,
+    _Inout_ inputReport54_t* pReport,
+    _Inout_ PREPORT_TIMES pTimes
+);
+
+VOID
+TouchTrackerReset(
+    _Out_ PTOUCH_TRACKER Tracker
+);
+
+VOID
+TouchFilterInit(
+    _In_ PTOUCH_CONFIG Config,
+    _Out_ PTOUCH_FILTER Filter
+);
+
+LONG
+TouchFilterAlpha(
+    _In_ ULONG cutoff,
+    _In_ LONGLONG elapsed,
+    _In_ LONGLONG frequency
+);
+
+LONG
+TouchFilterAxis(
+    _In_ PTOUCH_FILTER Filter,
+    _Inout_ PTOUCH_FILTER_AXIS Axis,
+    _In_ LONG raw,
+    _In_ LONGLONG elapsed,
+    _In_ LONGLONG frequency
+);
+
+BOOLEAN
+TouchFilterPoints(
+    _Inout_ PTOUCH_FILTER Filter,
+    _Inout_updates_bytes_(count * sizeof(inputpoint)) UINT8* points,
+    _In_ UINT8 count,
+    _In_ LONGLONG timestamp,
+    _In_ LONGLONG frequency
+);
+
+VOID
+TouchPredictorInit(
+    _In_ PTOUCH_CONFIG Config,
+    _In_ PTOUCH_PROFILE Profile,
+    _Out_ PTOUCH_PREDICTOR Predictor
+);
+
+LONG
+TouchPredictAxis(
+    _In_ PTOUCH_PREDICTOR Predictor,
+    _Inout_ PTOUCH_PREDICT_AXIS Axis,
+    _In_ UCHAR samples,
+    _In_ LONG raw,
+    _In_ LONG limit,
+    _In_ LONGLONG elapsed,
+    _In_ LONGLONG frequency
+);
+
+BOOLEAN
+TouchPredictPoints(
+    _Inout_ PTOUCH_PREDICTOR Predictor,
+    _Inout_updates_bytes_(count * sizeof(inputpoint)) UINT8* points,
+    _In_ UINT8 count,
+    _In_ LONGLONG timestamp,
+    _In_ LONGLONG frequency
+);
+
+UINT8
+TouchTrackerUpdate(
+    _Inout_ PTOUCH_TRACKER Tracker,
+    _Inout_updates_bytes_(MAX_POINT_NUM * sizeof(inputpoint)) UINT8* points,
+    _In_ UINT8 count,
+    _In_ UINT8 capacity
+);
+
+#endif // __TOUCHCORE_H__
@@ -29,45 +29,32 @@ Environment:
 #define EVT_ID_LEAVE_POINT					0x33	/*Touch leave the sensing area*/
 
 
-#define GOODIX_TOUCH_EVENT 0x80
-#define BYTES_PER_COORD 0x8
-#define BYTES_CHKSUM 0x2
-#define MAX_POINT_NUM 0xA
-
-ULONG XRevert = 0;
-ULONG YRevert = 0;
-ULONG XYExchange = 0;
-ULONG XMin = 0;
-ULONG XMax = 1080;
-ULONG YMin = 0;
-ULONG YMax = 2160;
-
-
-typedef struct
-{
-    BYTE  reportId;                                 // Report ID = 0x54 (84) 'T'
-                                                       // Collection: TouchScreen
-    BYTE  DIG_TouchScreenContactCountMaximum;       // Usage 0x000D0055: Contact Count Maximum, Value = 0 to 8
-} featureReport54_t;
-
-typedef struct __declspec(align(2))
-{
-    BYTE  DIG_TouchScreenFingerState;               // Usage 0x000D0042: Tip Switch, Value = 0 to 1
-    BYTE  DIG_TouchScreenFingerContactIdentifier;   // Usage 0x000D0051: Contact Identifier, Value = 0 to 1
-    BYTE GD_TouchScreenFingerXL;                    // Usage 0x00010030: X, Value = 0 to 32767
-    BYTE GD_TouchScreenFingerXH;                    // Usage 0x00010030: X, Value = 0 to 32767
-    BYTE GD_TouchScreenFingerYL;                    // Usage 0x00010031: Y, Value = 0 to 32767
-    BYTE GD_TouchScreenFingerYH;                    // Usage 0x00010031: Y, Value = 0 to 32767
-}inputpoint;
-
-typedef struct __declspec(align(2))
-{
-    BYTE  reportId;                                 // Report ID = 0x54 (84) 'T'
-                                                       // Collection: TouchScreen Finger
-    BYTE points[60];
+TOUCH_CONFIG TouchConfig = {
+    0,                      // XRevert
+    1,                      // YRevert
+    0,                      // XYExchange
+    0,                      // XMin
+    1080,                   // XMax
+    0,                      // YMin
+    2160,                   // YMax
+    MAX_POINT_NUM,          // MaxContacts
+    TOUCH_USAGES_DEFAULT,   // TouchUsages
+    0,                      // ContactsPerReport
+    { TOUCH_TRANSFORM_ONE, 0, 0, 0, TOUCH_TRANSFORM_ONE, 0 },   // CalibrationMatrix
+    0,                      // FilterMinCutoff
+    TOUCH_FILTER_BETA_DEFAULT,          // FilterBeta
+    TOUCH_FILTER_DERIV_CUTOFF_DEFAULT,  // FilterDerivCutoff
+    0,                      // PredictionHorizon
+};
+ULONG SpbAsyncDepth = SPB_ASYNC_MAX_DEPTH;
+ULONG ReportQueueDepth = REPORT_RING_DEFAULT_DEPTH;
+ULONG CoalesceMotion = 1;
+ULONG FlightRecorderDepth = FLIGHT_RECORDER_DEFAULT_DEPTH;
+ULONG CaptureDepth = CAPTURE_RING_DEFAULT_DEPTH;
+ULONG FrameChecksum = 0;
+ULONG ControllerConfig = 1;
+ULONG IdleTimeout = 0;
 
-    BYTE  DIG_TouchScreenContactCount;              // Usage 0x000D0054: Contact Count, Value = 0 to 8
-} inputReport54_t;
 
 //
 // This is the default report descriptor for the virtual Hid device returned
@@ -95,299 +82,15 @@ typedef struct __declspec(align(2))
     0xC0,                           // END_COLLECTION
 };*/
 
-HID_REPORT_DESCRIPTOR       G_DefaultReportDescriptor[] = {
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x04,     //   (LOCAL)USAGE              0x000D0004 Touch Screen(Application Collection)
-    0xA1, 0x01,     //   (MAIN)COLLECTION         0x01 Application(Usage = 0x000D0004: Page = Digitizer Device Page, Usage = Touch Screen, Type = Application Collection)
-    0x85, 0x54,     //     (GLOBAL)REPORT_ID          0x54 (84) 'T'
-
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x14,           //    (GLOBAL)LOGICAL_MINIMUM(0)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //46 47
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //55 56
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-    
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-    
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x22,     //     (LOCAL)USAGE              0x000D0022 Finger(Logical Collection)
-    0xA1, 0x02,     //     (MAIN)COLLECTION         0x02 Logical(Usage = 0x000D0022: Page = Digitizer Device Page, Usage = Finger, Type = Logical Collection)
-    0x09, 0x42,     //       (LOCAL)USAGE              0x000D0042 Tip Switch(Momentary Control)
-    0x25, 0x01,     //       (GLOBAL)LOGICAL_MAXIMUM    0x01 (1)
-    0x75, 0x01,     //       (GLOBAL)REPORT_SIZE        0x01 (1) Number of bits per field
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x32,     //       (LOCAL)USAGE              0x000D0032 In Range(Momentary Control)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x47,     //       (LOCAL)USAGE              0x000D0047 Confidence(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 1 bit) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x95, 0x05,     //       (GLOBAL)REPORT_COUNT       0x05 (5) Number of fields
-    0x81, 0x03,     //       (MAIN)INPUT              0x00000003 (5 fields x 1 bit) 1 = Constant 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x75, 0x08,     //       (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x95, 0x01,     //       (GLOBAL)REPORT_COUNT       0x01 (1) Number of fields
-    0x09, 0x51,     //       (LOCAL)USAGE              0x000D0051 Contact Identifier(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x05, 0x01,     //       (GLOBAL)USAGE_PAGE         0x0001 Generic Desktop Page
-    0x26, 0x38, 0x04,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (1080)    //99 100
-    0x75, 0x10,     //       (GLOBAL)REPORT_SIZE        0x10 (16) Number of bits per field
-    0x09, 0x30,     //       (LOCAL)USAGE              0x00010030 X(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x26, 0x24, 0x09,   // (GLOBAL) LOGICAL_MAXIMUM    0x7FFF (2250)    //108 109
-    0x09, 0x31,     //       (LOCAL)USAGE              0x00010031 Y(Dynamic Value)
-    0x81, 0x02,     //       (MAIN)INPUT              0x00000002 (1 field x 16 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Logical
-
-    0x05, 0x0D,     // (GLOBAL) USAGE_PAGE         0x000D Digitizer Device Page
-    0x09, 0x54,     //     (LOCAL)USAGE              0x000D0054 Contact Count(Dynamic Value)
-    0x75, 0x08,     //     (GLOBAL)REPORT_SIZE        0x08 (8) Number of bits per field
-    0x25, 0x0A,     //     (GLOBAL)LOGICAL_MAXIMUM    0x08 (8)
-    0x81, 0x02,     //     (MAIN)INPUT              0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0x09, 0x55,     //     (LOCAL)USAGE              0x000D0055 Contact Count Maximum(Static Value)
-    0xB1, 0x02,     //     (MAIN)FEATURE            0x00000002 (1 field x 8 bits) 0 = Data 1 = Variable 0 = Absolute 0 = NoWrap 0 = Linear 0 = PrefState 0 = NoNull 0 = NonVolatile 0 = Bitmap
-    0xC0,           // (MAIN)   END_COLLECTION     Application
-
-};
+//
+// The touch report descriptor is generated per device from its
+// TOUCH_PROFILE; see TouchReportDescriptorBuild.
+//
 
-featureReport54_t features = {0x54,10};
 //
 // This is the default HID descriptor returned by the mini driver
 // in response to IOCTL_HID_GET_DEVICE_DESCRIPTOR. The size
-// of report descriptor is currently the size of G_DefaultReportDescriptor.
+// of report descriptor is filled in once the descriptor has been built.
 //
 
 HID_DESCRIPTOR              G_DefaultHidDescriptor = {
@@ -398,7 +101,7 @@ HID_DESCRIPTOR              G_DefaultHidDescriptor = {
     0x01,   // number of HID class descriptors
     {                                       //DescriptorList[0]
         0x22,                               //report descriptor type 0x22
-        sizeof(G_DefaultReportDescriptor)   //total length of report descriptor
+        0                                   //total length of report descriptor
     }
 };
 
@@ -541,6 +244,7 @@ Return Value:
     deviceContext->Device       = device;
     deviceContext->DeviceData = 0;
     deviceContext->OnClose = FALSE;
+    deviceContext->BurstPointCount = 1;
 
     hidAttributes = &deviceContext->HidDeviceAttributes;
     RtlZeroMemory(hidAttributes, sizeof(HID_DEVICE_ATTRIBUTES));
@@ -561,6 +265,11 @@ Return Value:
         return status;
     }
 
+    status = SpbArenaCreate(deviceContext);
+    if( !NT_SUCCESS(status) ) {
+        return status;
+    }
+
     //
     // Use default "HID Descriptor" (hardcoded). We will set the
     // wReportLength memeber of HID descriptor when we read the
@@ -576,58 +285,68 @@ Return Value:
     if (!NT_SUCCESS(status)) {
     }
 
-    G_DefaultReportDescriptor[46] = XMax&0xFF;
-    G_DefaultReportDescriptor[47] = (XMax>>8)&0x0F;
-    G_DefaultReportDescriptor[55] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 1] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 1] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 1] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 1] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 2] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 2] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 2] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 2] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 3] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 3] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 3] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 3] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 4] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 4] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 4] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 4] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 5] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 5] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 5] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 5] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 6] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 6] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 6] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 6] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 7] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 7] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 7] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 7] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 8] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 8] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 8] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 8] = (YMax >> 8) & 0x0F;
-
-    G_DefaultReportDescriptor[46 + 53 * 9] = XMax & 0xFF;
-    G_DefaultReportDescriptor[47 + 53 * 9] = (XMax >> 8) & 0x0F;
-    G_DefaultReportDescriptor[55 + 53 * 9] = YMax & 0xFF;
-    G_DefaultReportDescriptor[56 + 53 * 9] = (YMax >> 8) & 0x0F;
-
-    deviceContext->ReportDescriptor = G_DefaultReportDescriptor;
-    status = STATUS_SUCCESS;
+    status = ReportRingCreate(deviceContext, ReportQueueDepth);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    status = FlightRecorderCreate(deviceContext, FlightRecorderDepth);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    status = CaptureRingCreate(deviceContext, CaptureDepth);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    TouchProfileInit(&TouchConfig, &deviceContext->Profile);
+    TouchTransformInit(&TouchConfig, &deviceContext->Profile, &deviceContext->Transform);
+    TouchFilterInit(&TouchConfig, &deviceContext->Filter);
+    TouchPredictorInit(&TouchConfig, &deviceContext->Profile, &deviceContext->Predictor);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&deviceAttributes);
+    deviceAttributes.ParentObject = device;
+
+    status = WdfSpinLockCreate(&deviceAttributes, &deviceContext->TrackerLock);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    status = WdfSpinLockCreate(&deviceAttributes, &deviceContext->FeatureLock);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    status = WdfSpinLockCreate(&deviceAttributes, &deviceContext->AsyncOrderLock);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    status = IdleGovernorCreate(deviceContext);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    if (deviceContext->Profile.ContactsPerReport < deviceContext->Profile.MaxContacts) {
+        WDF_OBJECT_ATTRIBUTES_INIT(&deviceAttributes);
+        deviceAttributes.ParentObject = device;
+
+        status = WdfSpinLockCreate(&deviceAttributes, &deviceContext->HybridLock);
+        if (!NT_SUCCESS(status)) {
+            return status;
+        }
+    }
+
+    status = TouchReportDescriptorBuild(&deviceContext->Profile,
+                                        deviceContext->ReportDescriptorBuffer,
+                                        sizeof(deviceContext->ReportDescriptorBuffer),
+                                        &deviceContext->HidDescriptor.DescriptorList[0].wReportLength);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    deviceContext->ReportDescriptor = deviceContext->ReportDescriptorBuffer;
 
     return status;
 }
@@ -777,6 +496,42 @@ NTSTATUS
         }
     }
 
+    //
+    // Create and open the SPB target once. It stays open until the
+    // hardware is released and is only stopped while the device is in Dx,
+    // which keeps target creation and the by-name open off the resume path.
+    //
+
+    if (NT_SUCCESS(status) && pDevice->SpbController == WDF_NO_HANDLE)
+    {
+        WDF_OBJECT_ATTRIBUTES targetAttributes;
+        WDF_OBJECT_ATTRIBUTES_INIT(&targetAttributes);
+
+        status = WdfIoTargetCreate(
+            pDevice->Device,
+            &targetAttributes,
+            &pDevice->SpbController);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        status = SpbDeviceOpen(pDevice);
+    }
+
+    if (NT_SUCCESS(status))
+    {
+        status = SpbRequestPoolCreate(pDevice);
+    }
+
+    //
+    // Take resolution and contact count from the controller before any
+    // frame is decoded with them.
+    //
+    if (NT_SUCCESS(status) && ControllerConfig)
+    {
+        GoodixLoadControllerConfig(pDevice);
+    }
+
     return status;
 }
 
@@ -803,6 +558,13 @@ NTSTATUS
 {
     PDEVICE_CONTEXT pDevice = GetDeviceContext(FxDevice);
     UNREFERENCED_PARAMETER(FxResourcesTranslated);
+    if (pDevice->SpbController != WDF_NO_HANDLE)
+    {
+        SpbDeviceClose(pDevice);
+        SpbRequestPoolRelease(pDevice);
+        WdfObjectDelete(pDevice->SpbController);
+        pDevice->SpbController = WDF_NO_HANDLE;
+    }
     if (pDevice->Interrupt != NULL)
     {
         WdfObjectDelete(pDevice->Interrupt);
@@ -819,7 +581,12 @@ OnD0Entry(
 
     Routine Description:
 
-    This routine allocates objects needed by the driver.
+    This routine restarts the SPB target that OnPrepareHardware opened,
+    reads the controller status once and only then arms the interrupt.
+    A frame left over from before the device went to Dx is cleared
+    instead of being reported. If the status cannot be read the clear is
+    skipped and the interrupt armed all the same; a stale frame is then
+    read as the first frame instead of leaving the device unusable.
 
     Arguments:
 
@@ -835,25 +602,56 @@ OnD0Entry(
     UNREFERENCED_PARAMETER(FxPreviousState);
 
     PDEVICE_CONTEXT pDevice = GetDeviceContext(FxDevice);
-    NTSTATUS status;
-
-    //
-    // Create the SPB target.
-    //
+    NTSTATUS status = STATUS_SUCCESS;
+    UINT8 touchStatus = 0;
+    UINT8 touchEvtClear = 0;
 
-    WDF_OBJECT_ATTRIBUTES targetAttributes;
-    WDF_OBJECT_ATTRIBUTES_INIT(&targetAttributes);
+    pDevice->ResumeTime = KeQueryPerformanceCounter(NULL).QuadPart;
 
-    status = WdfIoTargetCreate(
-        pDevice->Device,
-        &targetAttributes,
-        &pDevice->SpbController);
+    if (WdfIoTargetGetState(pDevice->SpbController) != WdfIoTargetStarted)
+    {
+        status = WdfIoTargetStart(pDevice->SpbController);
+        if (!NT_SUCCESS(status))
+            return status;
+    }
 
+    status = GoodixRead(pDevice, TOUCH_INFO_ADDR, &touchStatus, 1);
     if (!NT_SUCCESS(status))
     {
+#ifdef DEBUG
+        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DEVICE, "D0 entry: status read failed %x", status);
+#endif
+        touchStatus = 0;
+        status = STATUS_SUCCESS;
+    }
+
+    if (touchStatus & GOODIX_TOUCH_EVENT)
+        GoodixWrite(pDevice, TOUCH_INFO_ADDR, &touchEvtClear, 1);
+
+    //
+    // The controller may have kept power, and doze, through Dx
+    //
+    if (InterlockedExchange(&pDevice->Dozing, 0) != 0)
+    {
+        UINT8 command = GOODIX_CMD_READ_COORDS;
+        GoodixWrite(pDevice, GOODIX_REG_COMMAND, &command, 1);
     }
+    pDevice->LastActivity = pDevice->ResumeTime;
+
+    //
+    // Armed before the interrupt so the first frame after it is the one
+    // measured, however soon it arrives
+    //
+    InterlockedIncrement(&pDevice->Resumes);
+    InterlockedExchange(&pDevice->ResumeReportPending, 1);
 
-    SpbDeviceOpen(pDevice);
+    pDevice->OnClose = FALSE;
+    WdfInterruptEnable(pDevice->Interrupt);
+
+    if (pDevice->IdleTimer != NULL)
+        WdfTimerStart(pDevice->IdleTimer, WDF_REL_TIMEOUT_IN_MS(pDevice->IdleTimerPeriod));
+
+    pDevice->ResumeArmUs = TouchTicksToUs(pDevice, KeQueryPerformanceCounter(NULL).QuadPart - pDevice->ResumeTime);
 
     return status;
 }
@@ -867,7 +665,10 @@ OnD0Exit(
 
     Routine Description:
 
-    This routine destroys objects needed by the driver.
+    This routine disarms the interrupt and stops the SPB target, waiting
+    for frame reads still in flight. The target stays open for the next
+    OnD0Entry. Contacts still down are lifted, after any report already
+    queued for them, since the controller will not report them again.
 
     Arguments:
 
@@ -883,12 +684,14 @@ OnD0Exit(
     UNREFERENCED_PARAMETER(FxPreviousState);
 
     PDEVICE_CONTEXT pDevice = GetDeviceContext(FxDevice);
-    SpbDeviceClose(pDevice);
-    if (pDevice->SpbController != WDF_NO_HANDLE)
-    {
-        WdfObjectDelete(pDevice->SpbController);
-        pDevice->SpbController = WDF_NO_HANDLE;
-    }
+
+    pDevice->OnClose = TRUE;
+    if (pDevice->IdleTimer != NULL)
+        WdfTimerStop(pDevice->IdleTimer, TRUE);
+    WdfInterruptDisable(pDevice->Interrupt);
+    WdfIoTargetStop(pDevice->SpbController, WdfIoTargetCancelSentIo);
+
+    TouchLiftContacts(pDevice);
 
     return STATUS_SUCCESS;
 }
@@ -1230,10 +1033,12 @@ ReadReport(
 
 Routine Description:
 
-    Handles IOCTL_HID_READ_REPORT for the HID collection. Normally the request
-    will be forwarded to a manual queue for further process. In that case, the
-    caller should not try to complete the request at this time, as the request
-    will later be retrieved back from the manually queue and completed there.
+    Handles IOCTL_HID_READ_REPORT for the HID collection. If a report is
+    already waiting in the report ring the request is completed with it
+    right away. Otherwise the request will be forwarded to a manual queue
+    for further process. In that case, the caller should not try to
+    complete the request at this time, as the request will later be
+    retrieved back from the manually queue and completed there.
     However, if for some reason the forwarding fails, the caller still need
     to complete the request with proper error code immediately.
 
@@ -1253,18 +1058,43 @@ Return Value:
 --*/
 {
     NTSTATUS                status;
+    PDEVICE_CONTEXT         deviceContext = QueueContext->DeviceContext;
+    inputReport54_t         report;
+    REPORT_TIMES            times;
+    UCHAR                   packed[sizeof(inputReport54_t)];
+    ULONG                   packedLength;
+
+    //
+    // hand out a report that arrived while no read was pending
+    //
+    if (TouchReportDequeue(deviceContext, &report, &times)) {
+        packedLength = TouchReportPack(&deviceContext->Profile, &report, packed);
+        status = RequestCopyFromBuffer(Request, packed, packedLength);
+        if (NT_SUCCESS(status)) {
+            InterlockedIncrement(&deviceContext->ReportsCompleted);
+            InterlockedExchangeAdd(&deviceContext->ReportBytesCopied, (LONG)packedLength);
+            TouchRecordLatency(deviceContext, &times);
+        }
+        *CompleteRequest = TRUE;
+        return status;
+    }
 
     //
     // forward the request to manual queue
     //
     status = WdfRequestForwardToIoQueue(
                             Request,
-                            QueueContext->DeviceContext->ManualQueue);
+                            deviceContext->ManualQueue);
     if( !NT_SUCCESS(status) ) {    
         *CompleteRequest = TRUE;
     }
     else {
         *CompleteRequest = FALSE;
+
+        //
+        // a report may have been queued after the ring was checked above
+        //
+        TouchDeliverReports(deviceContext);
     }
 
     return status;
@@ -1366,8 +1196,9 @@ Return Value:
     NTSTATUS                status;
     HID_XFER_PACKET         packet;
     ULONG                   reportSize;
-    
-    UNREFERENCED_PARAMETER(QueueContext);
+    featureReport54_t       features;
+    FEATURE_SELECTION       selection;
+
     status = RequestGetHidXferPacket_ToReadFromDevice(
                             Request,
                             &packet);
@@ -1397,6 +1228,33 @@ Return Value:
     // While KMDF does not enforce the rule (disallow read from output buffer),
     // it is good practice to not do so.
     //
+    // A control code that returns data is therefore sent with SetFeature
+    // first, and the next GetFeature from the same handle with a buffer
+    // large enough for its report returns the data instead of the feature
+    // report.
+    //
+    if (FeatureSelectionTake(QueueContext->DeviceContext, Request, packet.reportBufferLen, &selection)) {
+        switch (selection.ControlCode)
+        {
+        case HIDMINI_CONTROL_CODE_READ_LATENCY:
+            return GetLatencyFeature(QueueContext->DeviceContext, Request, &packet,
+                                     selection.LatencyStage);
+
+        case HIDMINI_CONTROL_CODE_READ_COUNTERS:
+            return GetCountersFeature(QueueContext->DeviceContext, Request, &packet);
+
+        case HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER:
+            return GetFlightRecorderFeature(QueueContext->DeviceContext, Request, &packet,
+                                            selection.FlightSequence);
+
+        case HIDMINI_CONTROL_CODE_CAPTURE:
+            return GetCaptureFeature(QueueContext->DeviceContext, Request, &packet,
+                                     selection.CaptureSequence);
+        }
+    }
+
+    features.reportId = CONTROL_FEATURE_REPORT_ID;
+    features.DIG_TouchScreenContactCountMaximum = QueueContext->DeviceContext->Profile.MaxContacts;
 
     reportSize = sizeof(features);
     if (packet.reportBufferLen < reportSize) {
@@ -1424,393 +1282,423 @@ Return Value:
     return status;
 }
 
-NTSTATUS
-SetFeature(
-    _In_  PQUEUE_CONTEXT    QueueContext,
-    _In_  WDFREQUEST        Request
+VOID
+FeatureSelectionInit(
+    _In_  WDFREQUEST        Request,
+    _In_  UCHAR             ControlCode,
+    _Out_ PFEATURE_SELECTION Selection
     )
 /*++
 
 Routine Description:
 
-    Handles IOCTL_HID_SET_FEATURE for all the collection.
-    For control collection (custom defined collection) it handles
-    the user-defined control codes for sideband communication
+    Starts a selection of ControlCode for the handle Request was sent on.
 
-Arguments:
+--*/
+{
+    PIRP irp = WdfRequestWdmGetIrp(Request);
 
-    QueueContext - The object context associated with the queue
+    RtlZeroMemory(Selection, sizeof(FEATURE_SELECTION));
+    Selection->FileObject = IoGetCurrentIrpStackLocation(irp)->FileObject;
+    Selection->ProcessId = IoGetRequestorProcessId(irp);
+    Selection->ControlCode = ControlCode;
+}
 
-    Request - Pointer to Request Packet.
+VOID
+FeatureSelectionSet(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  PFEATURE_SELECTION Selection
+    )
+/*++
 
-Return Value:
+Routine Description:
 
-    NT status code.
+    Records a selection, replacing an earlier one from the same handle. With
+    every slot taken by other handles the slots are reused round robin, so a
+    caller that never reads back cannot lock the others out.
 
 --*/
 {
-    NTSTATUS                status;
-    HID_XFER_PACKET         packet;
-    ULONG                   reportSize;
-    PHIDMINI_CONTROL_INFO   controlInfo;
-    PHID_DEVICE_ATTRIBUTES  hidAttributes = &QueueContext->DeviceContext->HidDeviceAttributes;
+    PFEATURE_SELECTION slot = NULL;
+    PFEATURE_SELECTION entry;
 
-    status = RequestGetHidXferPacket_ToWriteToDevice(
-                            Request,
-                            &packet);
-    if( !NT_SUCCESS(status) ) {
-        return status;
+    WdfSpinLockAcquire(DeviceContext->FeatureLock);
+
+    for (ULONG i = 0; i < FEATURE_SELECTION_SLOTS; i++) {
+        entry = &DeviceContext->FeatureSelections[i];
+        if (entry->ControlCode != 0 &&
+            entry->FileObject == Selection->FileObject &&
+            entry->ProcessId == Selection->ProcessId) {
+            slot = entry;
+            break;
+        }
+        if (slot == NULL && entry->ControlCode == 0) {
+            slot = entry;
+        }
     }
 
-    if (packet.reportId != CONTROL_COLLECTION_REPORT_ID) {
-        //
-        // If collection ID is not for control collection then handle
-        // this request just as you would for a regular collection.
-        //
-        status = STATUS_INVALID_PARAMETER;
-        
-        
-        return status;
+    if (slot == NULL) {
+        slot = &DeviceContext->FeatureSelections[DeviceContext->FeatureSelectionNext];
+        DeviceContext->FeatureSelectionNext =
+            (DeviceContext->FeatureSelectionNext + 1) % FEATURE_SELECTION_SLOTS;
     }
 
-    //
-    // before touching control code make sure buffer is big enough.
-    //
-    reportSize = sizeof(HIDMINI_CONTROL_INFO);
+    *slot = *Selection;
 
-    if (packet.reportBufferLen < reportSize) {
-        status = STATUS_INVALID_BUFFER_SIZE;
-        
-        
-        return status;
-    }
+    WdfSpinLockRelease(DeviceContext->FeatureLock);
+}
 
-    controlInfo = (PHIDMINI_CONTROL_INFO)packet.reportBuffer;
+BOOLEAN
+FeatureSelectionTake(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  ULONG             BufferLength,
+    _Out_ PFEATURE_SELECTION Selection
+    )
+/*++
 
-    switch(controlInfo->ControlCode)
-    {
-    case HIDMINI_CONTROL_CODE_SET_ATTRIBUTES:
-        //
-        // Store the device attributes in device extension
-        //
-        hidAttributes->ProductID     = controlInfo->u.Attributes.ProductID;
-        hidAttributes->VendorID      = controlInfo->u.Attributes.VendorID;
-        hidAttributes->VersionNumber = controlInfo->u.Attributes.VersionNumber;
+Routine Description:
 
-        //
-        // set status and information
-        //
-        WdfRequestSetInformation(Request, reportSize);
-        break;
+    Looks up the selection made on the handle Request was sent on and
+    consumes it if BufferLength can hold its report. A GetFeature with a
+    smaller buffer leaves the selection in place and gets the regular
+    feature report.
 
-    case HIDMINI_CONTROL_CODE_DUMMY1:
-        status = STATUS_NOT_IMPLEMENTED;
-        
-        break;
+Return Value:
 
-    case HIDMINI_CONTROL_CODE_DUMMY2:
-        status = STATUS_NOT_IMPLEMENTED;
-        
-        break;
+    TRUE if Selection was filled in.
 
-    default:
-        status = STATUS_NOT_IMPLEMENTED;
+--*/
+{
+    PFEATURE_SELECTION entry;
+    ULONG length;
+    BOOLEAN found = FALSE;
+
+    FeatureSelectionInit(Request, 0, Selection);
+
+    WdfSpinLockAcquire(DeviceContext->FeatureLock);
+
+    for (ULONG i = 0; i < FEATURE_SELECTION_SLOTS; i++) {
+        entry = &DeviceContext->FeatureSelections[i];
+        if (entry->ControlCode == 0 ||
+            entry->FileObject != Selection->FileObject ||
+            entry->ProcessId != Selection->ProcessId) {
+            continue;
+        }
+
+        switch (entry->ControlCode)
+        {
+        case HIDMINI_CONTROL_CODE_READ_LATENCY:
+            length = sizeof(HIDMINI_LATENCY_REPORT);
+            break;
+        case HIDMINI_CONTROL_CODE_READ_COUNTERS:
+            length = sizeof(HIDMINI_COUNTERS_REPORT);
+            break;
+        case HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER:
+            length = sizeof(HIDMINI_FLIGHT_RECORDER_REPORT);
+            break;
+        default:
+            length = sizeof(HIDMINI_CAPTURE_REPORT);
+            break;
+        }
+
+        if (BufferLength >= length) {
+            *Selection = *entry;
+            entry->ControlCode = 0;
+            found = TRUE;
+        }
         break;
     }
-    return status;
+
+    WdfSpinLockRelease(DeviceContext->FeatureLock);
+
+    return found;
 }
 
 NTSTATUS
-GetInputReport(
-    _In_  PQUEUE_CONTEXT    QueueContext,
-    _In_  WDFREQUEST        Request
+GetLatencyFeature(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  HID_XFER_PACKET*  Packet,
+    _In_  UCHAR             Stage
     )
 /*++
 
 Routine Description:
 
-    Handles IOCTL_HID_GET_INPUT_REPORT for all the collection.
+    Copies the latency histogram selected by HIDMINI_CONTROL_CODE_READ_LATENCY
+    into a GetFeature buffer.
 
 Arguments:
 
-    QueueContext - The object context associated with the queue
+    DeviceContext - The device context
 
     Request - Pointer to Request Packet.
 
+    Packet - The transfer packet of the request, at least
+            sizeof(HIDMINI_LATENCY_REPORT) bytes long
+
+    Stage - The HIDMINI_LATENCY_STAGE_* histogram to return
+
 Return Value:
 
     NT status code.
 
 --*/
 {
-    NTSTATUS                status;
-    HID_XFER_PACKET         packet;
-    ULONG                   reportSize;
-    PHIDMINI_INPUT_REPORT   reportBuffer;
-
-    status = RequestGetHidXferPacket_ToReadFromDevice(
-                            Request,
-                            &packet);
-    if( !NT_SUCCESS(status) ) {
-        return status;
+    HIDMINI_LATENCY_REPORT  report;
+    PLATENCY_HISTOGRAM      histogram;
+
+    histogram = &DeviceContext->LatencyHistograms[Stage];
+
+    RtlZeroMemory(&report, sizeof(report));
+    report.ReportId = CONTROL_COLLECTION_REPORT_ID;
+    report.ControlCode = HIDMINI_CONTROL_CODE_READ_LATENCY;
+    report.Stage = Stage;
+    report.BucketCount = HIDMINI_LATENCY_BUCKETS;
+    report.Count = (ULONG)histogram->Count;
+    report.MaxUs = (ULONG)histogram->MaxUs;
+    report.SumUs = (ULONGLONG)histogram->SumUs;
+    for (ULONG i = 0; i < HIDMINI_LATENCY_BUCKETS; i++) {
+        report.Buckets[i] = (ULONG)histogram->Buckets[i];
     }
 
-    if (packet.reportId != CONTROL_COLLECTION_REPORT_ID) {
-        //
-        // If collection ID is not for control collection then handle
-        // this request just as you would for a regular collection.
-        //
-        status = STATUS_INVALID_PARAMETER;
-        
-        return status;
-    }
-
-    reportSize = sizeof(HIDMINI_INPUT_REPORT);
-    if (packet.reportBufferLen < reportSize) {
-        status = STATUS_INVALID_BUFFER_SIZE;
-        
-        return status;
-    }
-
-    reportBuffer = (PHIDMINI_INPUT_REPORT)(packet.reportBuffer);
-
-    reportBuffer->ReportId = CONTROL_COLLECTION_REPORT_ID;
-    reportBuffer->Data     = QueueContext->OutputReport;
-
     //
-    // Report how many bytes were copied
+    // the packet buffer carries no alignment guarantee
     //
-    WdfRequestSetInformation(Request, reportSize);
-    return status;
-}
+    RtlCopyMemory(Packet->reportBuffer, &report, sizeof(report));
 
+    WdfRequestSetInformation(Request, sizeof(report));
+    return STATUS_SUCCESS;
+}
 
 NTSTATUS
-SetOutputReport(
-    _In_  PQUEUE_CONTEXT    QueueContext,
-    _In_  WDFREQUEST        Request
+GetCountersFeature(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  HID_XFER_PACKET*  Packet
     )
 /*++
 
 Routine Description:
 
-    Handles IOCTL_HID_SET_OUTPUT_REPORT for all the collection.
+    Copies a snapshot of the device's performance counters into a
+    GetFeature buffer, after HIDMINI_CONTROL_CODE_READ_COUNTERS selected
+    them. Each counter is read on its own, so the snapshot is not taken
+    atomically across counters.
 
 Arguments:
 
-    QueueContext - The object context associated with the queue
+    DeviceContext - The device context
 
     Request - Pointer to Request Packet.
 
+    Packet - The transfer packet of the request, at least
+            sizeof(HIDMINI_COUNTERS_REPORT) bytes long
+
 Return Value:
 
     NT status code.
 
 --*/
 {
-    NTSTATUS                status;
-    HID_XFER_PACKET         packet;
-    ULONG                   reportSize;
-    PHIDMINI_OUTPUT_REPORT  reportBuffer;
-
-    status = RequestGetHidXferPacket_ToWriteToDevice(
-                            Request,
-                            &packet);
-    if( !NT_SUCCESS(status) ) {
-        return status;
-    }
-
-    if (packet.reportId != CONTROL_COLLECTION_REPORT_ID) {
-        //
-        // If collection ID is not for control collection then handle
-        // this request just as you would for a regular collection.
-        //
-        status = STATUS_INVALID_PARAMETER;
-        
-        return status;
-    }
-
-    //
-    // before touching buffer make sure buffer is big enough.
-    //
-    reportSize = sizeof(HIDMINI_OUTPUT_REPORT);
-
-    if (packet.reportBufferLen < reportSize) {
-        status = STATUS_INVALID_BUFFER_SIZE;
-        return status;
+    HIDMINI_COUNTERS_REPORT report;
+
+    RtlZeroMemory(&report, sizeof(report));
+    report.ReportId = CONTROL_COLLECTION_REPORT_ID;
+    report.ControlCode = HIDMINI_CONTROL_CODE_READ_COUNTERS;
+    report.MaxContacts = HIDMINI_MAX_CONTACTS;
+    report.Interrupts = (ULONG)DeviceContext->Interrupts;
+    report.FramesDecoded = (ULONG)DeviceContext->FramesProcessed;
+    report.FramesDropped = (ULONG)DeviceContext->ReportRing.Overflows;
+    report.NonTouchFrames = (ULONG)DeviceContext->NonTouchFrames;
+    report.SpbFailures = (ULONG)DeviceContext->SpbFailures;
+    report.AsyncFailures = (ULONG)DeviceContext->AsyncFailed;
+    report.BusOperations = (ULONG)DeviceContext->BusOperations;
+    report.BusBytes = (ULONGLONG)DeviceContext->BusBytes;
+    report.ReportsCompleted = (ULONG)DeviceContext->ReportsCompleted;
+    report.ContactsReported = (ULONG)DeviceContext->ContactsReported;
+    for (ULONG i = 0; i <= HIDMINI_MAX_CONTACTS; i++) {
+        report.FramesByContacts[i] = (ULONG)DeviceContext->FramesByContacts[i];
     }
-
-    reportBuffer = (PHIDMINI_OUTPUT_REPORT)packet.reportBuffer;
-
-    QueueContext->OutputReport = reportBuffer->Data;
-
-    //
-    // Report how many bytes were copied
-    //
-    WdfRequestSetInformation(Request, reportSize);
-    return status;
+    report.FramesSuppressed = (ULONG)DeviceContext->FramesSuppressed;
+    report.FrameRereads = (ULONG)DeviceContext->FrameRereads;
+    report.CorruptFrames = (ULONG)DeviceContext->CorruptFrames;
+    report.Resumes = (ULONG)DeviceContext->Resumes;
+    report.ResumeArmUs = DeviceContext->ResumeArmUs;
+    report.ResumeReportUs = DeviceContext->ResumeReportUs;
+    report.DozeEntries = (ULONG)DeviceContext->DozeEntries;
+    report.DozeExits = (ULONG)DeviceContext->DozeExits;
+    report.WakeReportUs = DeviceContext->WakeReportUs;
+    report.MaxWakeReportUs = DeviceContext->MaxWakeReportUs;
+    report.LiftsLost = (ULONG)DeviceContext->ReportRing.LiftsLost;
+    report.ShortFrames = (ULONG)DeviceContext->BurstShortFrames;
+
+    RtlCopyMemory(Packet->reportBuffer, &report, sizeof(report));
+
+    WdfRequestSetInformation(Request, sizeof(report));
+    return STATUS_SUCCESS;
 }
 
-
 NTSTATUS
-GetStringId(
+GetFlightRecorderFeature(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
     _In_  WDFREQUEST        Request,
-    _Out_ ULONG            *StringId,
-    _Out_ ULONG            *LanguageId
+    _In_  HID_XFER_PACKET*  Packet,
+    _In_  ULONG             Sequence
     )
 /*++
 
 Routine Description:
 
-    Helper routine to decode IOCTL_HID_GET_INDEXED_STRING and IOCTL_HID_GET_STRING.
+    Copies up to HIDMINI_FLIGHT_RECORDS_PER_REPORT flight recorder records
+    into a GetFeature buffer, starting at the sequence selected with
+    HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER or at the oldest record still
+    held, whichever is newer.
 
 Arguments:
 
+    DeviceContext - The device context
+
     Request - Pointer to Request Packet.
 
+    Packet - The transfer packet of the request, at least
+            sizeof(HIDMINI_FLIGHT_RECORDER_REPORT) bytes long
+
+    Sequence - The first sequence the caller asked for
+
 Return Value:
 
     NT status code.
 
 --*/
 {
-    NTSTATUS                status;
-    ULONG                   inputValue;
-
-#ifdef _KERNEL_MODE
-
-    WDF_REQUEST_PARAMETERS  requestParameters;
-
-    //
-    // IOCTL_HID_GET_STRING:                      // METHOD_NEITHER
-    // IOCTL_HID_GET_INDEXED_STRING:              // METHOD_OUT_DIRECT
-    //
-    // The string id (or string index) is passed in Parameters.DeviceIoControl.
-    // Type3InputBuffer. However, Parameters.DeviceIoControl.InputBufferLength
-    // was not initialized by hidclass.sys, therefore trying to access the
-    // buffer with WdfRequestRetrieveInputMemory will fail
-    //
-    // Another problem with IOCTL_HID_GET_INDEXED_STRING is that METHOD_OUT_DIRECT
-    // expects the input buffer to be Irp->AssociatedIrp.SystemBuffer instead of
-    // Type3InputBuffer. That will also fail WdfRequestRetrieveInputMemory.
-    //
-    // The solution to the above two problems is to get Type3InputBuffer directly
-    //
-    // Also note that instead of the buffer's content, it is the buffer address
-    // that was used to store the string id (or index)
-    //
-
-    WDF_REQUEST_PARAMETERS_INIT(&requestParameters);
-    WdfRequestGetParameters(Request, &requestParameters);
-
-    inputValue = PtrToUlong(
-        requestParameters.Parameters.DeviceIoControl.Type3InputBuffer);
-
-    status = STATUS_SUCCESS;
-
-#else
-
-    WDFMEMORY               inputMemory;
-    size_t                  inputBufferLength;
-    PVOID                   inputBuffer;
+    PFLIGHT_RECORDER        recorder = &DeviceContext->FlightRecorder;
+    HIDMINI_FLIGHT_RECORDER_REPORT report;
+    ULONG                   next;
+    ULONG                   depth = recorder->Mask + 1;
+    ULONG                   sequence;
+
+    RtlZeroMemory(&report, sizeof(report));
+    report.ReportId = CONTROL_COLLECTION_REPORT_ID;
+    report.ControlCode = HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER;
+    report.Depth = depth;
+    report.PerfFrequency = (ULONGLONG)DeviceContext->PerfFrequency.QuadPart;
 
     //
-    // mshidumdf.sys updates the IRP and passes the string id (or index) through
-    // the input buffer correctly based on the IOCTL buffer type
+    // Next counts the records claimed so far; the newest is sequence Next
     //
+    next = (ULONG)ReadAcquire(&recorder->Next);
+    report.NextSequence = next + 1;
 
-    status = WdfRequestRetrieveInputMemory(Request, &inputMemory);
-    if( !NT_SUCCESS(status) ) {
-        KdPrint(("WdfRequestRetrieveInputMemory failed 0x%x\n",status));
-        return status;
-    }
-    inputBuffer = WdfMemoryGetBuffer(inputMemory, &inputBufferLength);
+    sequence = max(Sequence, 1);
+    if (next > depth)
+        sequence = max(sequence, next - depth + 1);
 
-    //
-    // make sure buffer is big enough.
-    //
-    if (inputBufferLength < sizeof(ULONG))
-    {
-        status = STATUS_INVALID_BUFFER_SIZE;
-        KdPrint(("GetStringId: invalid input buffer. size %d, expect %d\n",
-                            (int)inputBufferLength, (int)sizeof(ULONG)));
-        return status;
+    for (; sequence <= next && report.RecordCount < HIDMINI_FLIGHT_RECORDS_PER_REPORT; sequence++) {
+        if (FlightRecorderRead(recorder, sequence, &report.Records[report.RecordCount])) {
+            report.RecordCount++;
+        }
     }
 
-    inputValue = (*(PULONG)inputBuffer);
-
-#endif
-
-    //
-    // The least significant two bytes of the INT value contain the string id.
-    //
-    *StringId = (inputValue & 0x0ffff);
+    RtlCopyMemory(Packet->reportBuffer, &report, sizeof(report));
 
-    //
-    // The most significant two bytes of the INT value contain the language
-    // ID (for example, a value of 1033 indicates English).
-    //
-    *LanguageId = (inputValue >> 16);
-    return status;
+    WdfRequestSetInformation(Request, sizeof(report));
+    return STATUS_SUCCESS;
 }
 
-
 NTSTATUS
-GetIndexedString(
-    _In_  WDFREQUEST        Request
+GetCaptureFeature(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  HID_XFER_PACKET*  Packet,
+    _In_  ULONG             Sequence
     )
 /*++
 
 Routine Description:
 
-    Handles IOCTL_HID_GET_INDEXED_STRING
+    Copies up to HIDMINI_CAPTURE_FRAMES_PER_REPORT captured frames into a
+    GetFeature buffer, starting at the sequence selected with
+    HIDMINI_CAPTURE_READ. Frames the writers have already lapped are
+    skipped and counted as dropped; a frame still being written ends the
+    report and is where NextSequence points. Nothing is kept per reader, so
+    concurrent readers cannot disturb each other.
 
 Arguments:
 
+    DeviceContext - The device context
+
     Request - Pointer to Request Packet.
 
+    Packet - The transfer packet of the request, at least
+            sizeof(HIDMINI_CAPTURE_REPORT) bytes long
+
+    Sequence - The first sequence the caller asked for, 0 for the first
+            frame of the current capture
+
 Return Value:
 
     NT status code.
 
 --*/
 {
-    NTSTATUS                status;
-    ULONG                   languageId, stringIndex;
+    PCAPTURE_RING           ring = &DeviceContext->CaptureRing;
+    HIDMINI_CAPTURE_REPORT  report;
+    ULONG                   next;
+    ULONG                   depth = ring->Mask + 1;
+    ULONG                   sequence;
 
-    status = GetStringId(Request, &stringIndex, &languageId);
+    RtlZeroMemory(&report, sizeof(report));
+    report.ReportId = CONTROL_COLLECTION_REPORT_ID;
+    report.ControlCode = HIDMINI_CONTROL_CODE_CAPTURE;
+    report.PerfFrequency = (ULONGLONG)DeviceContext->PerfFrequency.QuadPart;
 
-    // While we don't use the language id, some minidrivers might.
-    //
-    UNREFERENCED_PARAMETER(languageId);
+    sequence = max(Sequence, (ULONG)ReadAcquire(&ring->StartSequence));
 
-    if (NT_SUCCESS(status)) {
+    //
+    // Next counts the frames claimed so far; the newest is sequence Next
+    //
+    next = (ULONG)ReadAcquire(&ring->Next);
+    if (next >= sequence + depth) {
+        report.Dropped = next - depth + 1 - sequence;
+        sequence = next - depth + 1;
+    }
 
-        if (stringIndex != VHIDMINI_DEVICE_STRING_INDEX)
-        {
-            status = STATUS_INVALID_PARAMETER;
-            
-            return status;
+    while (sequence <= next && report.FrameCount < HIDMINI_CAPTURE_FRAMES_PER_REPORT) {
+        if (!CaptureRingRead(ring, sequence, &report.Frames[report.FrameCount])) {
+            break;
         }
 
-        status = RequestCopyFromBuffer(Request, VHIDMINI_DEVICE_STRING, sizeof(VHIDMINI_DEVICE_STRING));
+        report.FrameCount++;
+        sequence++;
     }
-    return status;
-}
 
+    report.NextSequence = sequence;
+
+    RtlCopyMemory(Packet->reportBuffer, &report, sizeof(report));
+
+    WdfRequestSetInformation(Request, sizeof(report));
+    return STATUS_SUCCESS;
+}
 
 NTSTATUS
-GetString(
+SetFeature(
+    _In_  PQUEUE_CONTEXT    QueueContext,
     _In_  WDFREQUEST        Request
     )
 /*++
 
 Routine Description:
 
-    Handles IOCTL_HID_GET_STRING.
+    Handles IOCTL_HID_SET_FEATURE for all the collection.
+    For control collection (custom defined collection) it handles
+    the user-defined control codes for sideband communication
 
 Arguments:
 
+    QueueContext - The object context associated with the queue
+
     Request - Pointer to Request Packet.
 
 Return Value:
@@ -1820,350 +1708,2647 @@ Return Value:
 --*/
 {
     NTSTATUS                status;
-    ULONG                   languageId, stringId;
-    size_t                  stringSizeCb;
-    PWSTR                   string;
-
-    status = GetStringId(Request, &stringId, &languageId);
-
-    // While we don't use the language id, some minidrivers might.
-    //
-    UNREFERENCED_PARAMETER(languageId);
+    HID_XFER_PACKET         packet;
+    ULONG                   reportSize;
+    PHIDMINI_CONTROL_INFO   controlInfo;
+    PDEVICE_CONTEXT         deviceContext = QueueContext->DeviceContext;
+    PHID_DEVICE_ATTRIBUTES  hidAttributes = &deviceContext->HidDeviceAttributes;
+    FEATURE_SELECTION       selection;
 
-    if (!NT_SUCCESS(status)) {
+    status = RequestGetHidXferPacket_ToWriteToDevice(
+                            Request,
+                            &packet);
+    if( !NT_SUCCESS(status) ) {
         return status;
     }
 
-    switch (stringId){
-    case HID_STRING_ID_IMANUFACTURER:
-        stringSizeCb = sizeof(VHIDMINI_MANUFACTURER_STRING);
-        string = VHIDMINI_MANUFACTURER_STRING;
-        break;
-    case HID_STRING_ID_IPRODUCT:
-        stringSizeCb = sizeof(VHIDMINI_PRODUCT_STRING);
-        string = VHIDMINI_PRODUCT_STRING;
-        break;
-    case HID_STRING_ID_ISERIALNUMBER:
-        stringSizeCb = sizeof(VHIDMINI_SERIAL_NUMBER_STRING);
-        string = VHIDMINI_SERIAL_NUMBER_STRING;
-        break;
-    default:
+    if (packet.reportId != CONTROL_COLLECTION_REPORT_ID) {
+        //
+        // If collection ID is not for control collection then handle
+        // this request just as you would for a regular collection.
+        //
         status = STATUS_INVALID_PARAMETER;
         
+        
         return status;
     }
 
-    status = RequestCopyFromBuffer(Request, string, stringSizeCb);
-    return status;
-}
-
+    //
+    // before touching control code make sure buffer is big enough.
+    //
+    reportSize = sizeof(HIDMINI_CONTROL_INFO);
 
-NTSTATUS
-ManualQueueCreate(
-    _In_  WDFDEVICE         Device,
-    _Out_ WDFQUEUE          *Queue
-    )
-/*++
-Routine Description:
+    if (packet.reportBufferLen < reportSize) {
+        status = STATUS_INVALID_BUFFER_SIZE;
+        
+        
+        return status;
+    }
 
-    This function creates a manual I/O queue to receive IOCTL_HID_READ_REPORT
-    forwarded from the device's default queue handler.
+    controlInfo = (PHIDMINI_CONTROL_INFO)packet.reportBuffer;
 
-    It also creates a periodic timer to check the queue and complete any pending
-    request with data from the device. Here timer expiring is used to simulate
-    a hardware event that new data is ready.
+    switch(controlInfo->ControlCode)
+    {
+    case HIDMINI_CONTROL_CODE_SET_ATTRIBUTES:
+        //
+        // Store the device attributes in device extension
+        //
+        hidAttributes->ProductID     = controlInfo->u.Attributes.ProductID;
+        hidAttributes->VendorID      = controlInfo->u.Attributes.VendorID;
+        hidAttributes->VersionNumber = controlInfo->u.Attributes.VersionNumber;
 
-    The workflow is like this:
+        //
+        // set status and information
+        //
+        WdfRequestSetInformation(Request, reportSize);
+        break;
 
-    - Hidclass.sys sends an ioctl to the miniport to read input report.
+    case HIDMINI_CONTROL_CODE_READ_LATENCY:
+        //
+        // Select the histogram the next GetFeature returns
+        //
+        if (controlInfo->u.Latency.Stage >= HIDMINI_LATENCY_STAGE_COUNT) {
+            status = STATUS_INVALID_PARAMETER;
+            break;
+        }
 
-    - The request reaches the driver's default queue. As data may not be avaiable
-      yet, the request is forwarded to a second manual queue temporarily.
+        if (controlInfo->u.Latency.Reset) {
+            RtlZeroMemory(&deviceContext->LatencyHistograms[controlInfo->u.Latency.Stage],
+                          sizeof(LATENCY_HISTOGRAM));
+        }
 
-    - Later when data is ready (as simulated by timer expiring), the driver
-      checks for any pending request in the manual queue, and then completes it.
+        FeatureSelectionInit(Request, HIDMINI_CONTROL_CODE_READ_LATENCY, &selection);
+        selection.LatencyStage = controlInfo->u.Latency.Stage;
+        FeatureSelectionSet(deviceContext, &selection);
 
-    - Hidclass gets notified for the read request completion and return data to
-      the caller.
+        WdfRequestSetInformation(Request, reportSize);
+        break;
 
-    On the other hand, for IOCTL_HID_WRITE_REPORT request, the driver simply
-    sends the request to the hardware (as simulated by storing the data at
-    DeviceContext->DeviceData) and completes the request immediately. There is
-    no need to use another queue for write operation.
+    case HIDMINI_CONTROL_CODE_READ_COUNTERS:
+        //
+        // The snapshot is taken by the GetFeature that follows
+        //
+        FeatureSelectionInit(Request, HIDMINI_CONTROL_CODE_READ_COUNTERS, &selection);
+        FeatureSelectionSet(deviceContext, &selection);
+
+        WdfRequestSetInformation(Request, reportSize);
+        break;
+
+    case HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER:
+        if (deviceContext->FlightRecorder.Records == NULL) {
+            status = STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        FeatureSelectionInit(Request, HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER, &selection);
+        selection.FlightSequence = controlInfo->u.FlightRecorder.Sequence;
+        FeatureSelectionSet(deviceContext, &selection);
+
+        WdfRequestSetInformation(Request, reportSize);
+        break;
+
+    case HIDMINI_CONTROL_CODE_CAPTURE:
+        if (deviceContext->CaptureRing.Frames == NULL) {
+            status = STATUS_NOT_SUPPORTED;
+            break;
+        }
+
+        switch (controlInfo->u.Capture.Mode)
+        {
+        case HIDMINI_CAPTURE_STOP:
+            InterlockedExchange(&deviceContext->CaptureRing.Enabled, FALSE);
+            break;
+
+        case HIDMINI_CAPTURE_START:
+            InterlockedExchange(&deviceContext->CaptureRing.Enabled, FALSE);
+            InterlockedExchange(&deviceContext->CaptureRing.StartSequence,
+                                ReadAcquire(&deviceContext->CaptureRing.Next) + 1);
+            InterlockedExchange(&deviceContext->CaptureRing.Enabled, TRUE);
+            break;
+
+        case HIDMINI_CAPTURE_READ:
+            FeatureSelectionInit(Request, HIDMINI_CONTROL_CODE_CAPTURE, &selection);
+            selection.CaptureSequence = controlInfo->u.Capture.Sequence;
+            FeatureSelectionSet(deviceContext, &selection);
+            break;
+
+        default:
+            status = STATUS_INVALID_PARAMETER;
+            break;
+        }
+
+        if (NT_SUCCESS(status)) {
+            WdfRequestSetInformation(Request, reportSize);
+        }
+        break;
+
+    default:
+        status = STATUS_NOT_IMPLEMENTED;
+        break;
+    }
+    return status;
+}
+
+NTSTATUS
+GetInputReport(
+    _In_  PQUEUE_CONTEXT    QueueContext,
+    _In_  WDFREQUEST        Request
+    )
+/*++
+
+Routine Description:
+
+    Handles IOCTL_HID_GET_INPUT_REPORT for all the collection.
 
 Arguments:
 
-    Device - Handle to a framework device object.
+    QueueContext - The object context associated with the queue
 
-    Queue - Output pointer to a framework I/O queue handle, on success.
+    Request - Pointer to Request Packet.
 
 Return Value:
 
-    NTSTATUS
+    NT status code.
 
 --*/
 {
     NTSTATUS                status;
-    WDF_IO_QUEUE_CONFIG     queueConfig;
-    WDF_OBJECT_ATTRIBUTES   queueAttributes;
-    WDFQUEUE                queue;
-    PMANUAL_QUEUE_CONTEXT   queueContext;
-    
-    WDF_IO_QUEUE_CONFIG_INIT(
-                            &queueConfig,
-                            WdfIoQueueDispatchManual);
+    HID_XFER_PACKET         packet;
+    ULONG                   reportSize;
+    PHIDMINI_INPUT_REPORT   reportBuffer;
 
-    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(
-                            &queueAttributes,
-                            MANUAL_QUEUE_CONTEXT);
+    status = RequestGetHidXferPacket_ToReadFromDevice(
+                            Request,
+                            &packet);
+    if( !NT_SUCCESS(status) ) {
+        return status;
+    }
 
-    status = WdfIoQueueCreate(
-                            Device,
-                            &queueConfig,
-                            &queueAttributes,
-                            &queue);
+    if (packet.reportId != CONTROL_COLLECTION_REPORT_ID) {
+        //
+        // If collection ID is not for control collection then handle
+        // this request just as you would for a regular collection.
+        //
+        status = STATUS_INVALID_PARAMETER;
+        
+        return status;
+    }
 
-    if( !NT_SUCCESS(status) ) {
+    reportSize = sizeof(HIDMINI_INPUT_REPORT);
+    if (packet.reportBufferLen < reportSize) {
+        status = STATUS_INVALID_BUFFER_SIZE;
         
+        return status;
+    }
+
+    reportBuffer = (PHIDMINI_INPUT_REPORT)(packet.reportBuffer);
+
+    reportBuffer->ReportId = CONTROL_COLLECTION_REPORT_ID;
+    reportBuffer->Data     = QueueContext->OutputReport;
+
+    //
+    // Report how many bytes were copied
+    //
+    WdfRequestSetInformation(Request, reportSize);
+    return status;
+}
+
+
+NTSTATUS
+SetOutputReport(
+    _In_  PQUEUE_CONTEXT    QueueContext,
+    _In_  WDFREQUEST        Request
+    )
+/*++
+
+Routine Description:
+
+    Handles IOCTL_HID_SET_OUTPUT_REPORT for all the collection.
+
+Arguments:
+
+    QueueContext - The object context associated with the queue
+
+    Request - Pointer to Request Packet.
+
+Return Value:
+
+    NT status code.
+
+--*/
+{
+    NTSTATUS                status;
+    HID_XFER_PACKET         packet;
+    ULONG                   reportSize;
+    PHIDMINI_OUTPUT_REPORT  reportBuffer;
+
+    status = RequestGetHidXferPacket_ToWriteToDevice(
+                            Request,
+                            &packet);
+    if( !NT_SUCCESS(status) ) {
+        return status;
+    }
+
+    if (packet.reportId != CONTROL_COLLECTION_REPORT_ID) {
+        //
+        // If collection ID is not for control collection then handle
+        // this request just as you would for a regular collection.
+        //
+        status = STATUS_INVALID_PARAMETER;
         
         return status;
     }
 
-    queueContext = GetManualQueueContext(queue);
-    queueContext->Queue         = queue;
-    queueContext->DeviceContext = GetDeviceContext(Device);
+    //
+    // before touching buffer make sure buffer is big enough.
+    //
+    reportSize = sizeof(HIDMINI_OUTPUT_REPORT);
 
-    *Queue = queue;
+    if (packet.reportBufferLen < reportSize) {
+        status = STATUS_INVALID_BUFFER_SIZE;
+        return status;
+    }
+
+    reportBuffer = (PHIDMINI_OUTPUT_REPORT)packet.reportBuffer;
+
+    QueueContext->OutputReport = reportBuffer->Data;
+
+    //
+    // Report how many bytes were copied
+    //
+    WdfRequestSetInformation(Request, reportSize);
     return status;
 }
 
-void
-EvtTimerFunc(
-    _In_  WDFTIMER          Timer
+
+NTSTATUS
+GetStringId(
+    _In_  WDFREQUEST        Request,
+    _Out_ ULONG            *StringId,
+    _Out_ ULONG            *LanguageId
     )
 /*++
+
 Routine Description:
 
-    This periodic timer callback routine checks the device's manual queue and
-    completes any pending request with data from the device.
+    Helper routine to decode IOCTL_HID_GET_INDEXED_STRING and IOCTL_HID_GET_STRING.
 
 Arguments:
 
-    Timer - Handle to a timer object that was obtained from WdfTimerCreate.
+    Request - Pointer to Request Packet.
+
+Return Value:
+
+    NT status code.
+
+--*/
+{
+    NTSTATUS                status;
+    ULONG                   inputValue;
+
+#ifdef _KERNEL_MODE
+
+    WDF_REQUEST_PARAMETERS  requestParameters;
+
+    //
+    // IOCTL_HID_GET_STRING:                      // METHOD_NEITHER
+    // IOCTL_HID_GET_INDEXED_STRING:              // METHOD_OUT_DIRECT
+    //
+    // The string id (or string index) is passed in Parameters.DeviceIoControl.
+    // Type3InputBuffer. However, Parameters.DeviceIoControl.InputBufferLength
+    // was not initialized by hidclass.sys, therefore trying to access the
+    // buffer with WdfRequestRetrieveInputMemory will fail
+    //
+    // Another problem with IOCTL_HID_GET_INDEXED_STRING is that METHOD_OUT_DIRECT
+    // expects the input buffer to be Irp->AssociatedIrp.SystemBuffer instead of
+    // Type3InputBuffer. That will also fail WdfRequestRetrieveInputMemory.
+    //
+    // The solution to the above two problems is to get Type3InputBuffer directly
+    //
+    // Also note that instead of the buffer's content, it is the buffer address
+    // that was used to store the string id (or index)
+    //
+
+    WDF_REQUEST_PARAMETERS_INIT(&requestParameters);
+    WdfRequestGetParameters(Request, &requestParameters);
+
+    inputValue = PtrToUlong(
+        requestParameters.Parameters.DeviceIoControl.Type3InputBuffer);
+
+    status = STATUS_SUCCESS;
+
+#else
+
+    WDFMEMORY               inputMemory;
+    size_t                  inputBufferLength;
+    PVOID                   inputBuffer;
+
+    //
+    // mshidumdf.sys updates the IRP and passes the string id (or index) through
+    // the input buffer correctly based on the IOCTL buffer type
+    //
+
+    status = WdfRequestRetrieveInputMemory(Request, &inputMemory);
+    if( !NT_SUCCESS(status) ) {
+        KdPrint(("WdfRequestRetrieveInputMemory failed 0x%x\n",status));
+        return status;
+    }
+    inputBuffer = WdfMemoryGetBuffer(inputMemory, &inputBufferLength);
+
+    //
+    // make sure buffer is big enough.
+    //
+    if (inputBufferLength < sizeof(ULONG))
+    {
+        status = STATUS_INVALID_BUFFER_SIZE;
+        KdPrint(("GetStringId: invalid input buffer. size %d, expect %d\n",
+                            (int)inputBufferLength, (int)sizeof(ULONG)));
+        return status;
+    }
+
+    inputValue = (*(PULONG)inputBuffer);
+
+#endif
+
+    //
+    // The least significant two bytes of the INT value contain the string id.
+    //
+    *StringId = (inputValue & 0x0ffff);
+
+    //
+    // The most significant two bytes of the INT value contain the language
+    // ID (for example, a value of 1033 indicates English).
+    //
+    *LanguageId = (inputValue >> 16);
+    return status;
+}
+
+
+NTSTATUS
+GetIndexedString(
+    _In_  WDFREQUEST        Request
+    )
+/*++
+
+Routine Description:
+
+    Handles IOCTL_HID_GET_INDEXED_STRING
+
+Arguments:
+
+    Request - Pointer to Request Packet.
+
+Return Value:
+
+    NT status code.
+
+--*/
+{
+    NTSTATUS                status;
+    ULONG                   languageId, stringIndex;
+
+    status = GetStringId(Request, &stringIndex, &languageId);
+
+    // While we don't use the language id, some minidrivers might.
+    //
+    UNREFERENCED_PARAMETER(languageId);
+
+    if (NT_SUCCESS(status)) {
+
+        if (stringIndex != VHIDMINI_DEVICE_STRING_INDEX)
+        {
+            status = STATUS_INVALID_PARAMETER;
+            
+            return status;
+        }
+
+        status = RequestCopyFromBuffer(Request, VHIDMINI_DEVICE_STRING, sizeof(VHIDMINI_DEVICE_STRING));
+    }
+    return status;
+}
+
+
+NTSTATUS
+GetString(
+    _In_  WDFREQUEST        Request
+    )
+/*++
+
+Routine Description:
+
+    Handles IOCTL_HID_GET_STRING.
+
+Arguments:
+
+    Request - Pointer to Request Packet.
+
+Return Value:
+
+    NT status code.
+
+--*/
+{
+    NTSTATUS                status;
+    ULONG                   languageId, stringId;
+    size_t                  stringSizeCb;
+    PWSTR                   string;
+
+    status = GetStringId(Request, &stringId, &languageId);
+
+    // While we don't use the language id, some minidrivers might.
+    //
+    UNREFERENCED_PARAMETER(languageId);
+
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    switch (stringId){
+    case HID_STRING_ID_IMANUFACTURER:
+        stringSizeCb = sizeof(VHIDMINI_MANUFACTURER_STRING);
+        string = VHIDMINI_MANUFACTURER_STRING;
+        break;
+    case HID_STRING_ID_IPRODUCT:
+        stringSizeCb = sizeof(VHIDMINI_PRODUCT_STRING);
+        string = VHIDMINI_PRODUCT_STRING;
+        break;
+    case HID_STRING_ID_ISERIALNUMBER:
+        stringSizeCb = sizeof(VHIDMINI_SERIAL_NUMBER_STRING);
+        string = VHIDMINI_SERIAL_NUMBER_STRING;
+        break;
+    default:
+        status = STATUS_INVALID_PARAMETER;
+        
+        return status;
+    }
+
+    status = RequestCopyFromBuffer(Request, string, stringSizeCb);
+    return status;
+}
+
+
+NTSTATUS
+ManualQueueCreate(
+    _In_  WDFDEVICE         Device,
+    _Out_ WDFQUEUE          *Queue
+    )
+/*++
+Routine Description:
+
+    This function creates a manual I/O queue to receive IOCTL_HID_READ_REPORT
+    forwarded from the device's default queue handler.
+
+    It also creates a periodic timer to check the queue and complete any pending
+    request with data from the device. Here timer expiring is used to simulate
+    a hardware event that new data is ready.
+
+    The workflow is like this:
+
+    - Hidclass.sys sends an ioctl to the miniport to read input report.
+
+    - The request reaches the driver's default queue. As data may not be avaiable
+      yet, the request is forwarded to a second manual queue temporarily.
+
+    - Later when data is ready (as simulated by timer expiring), the driver
+      checks for any pending request in the manual queue, and then completes it.
+
+    - Hidclass gets notified for the read request completion and return data to
+      the caller.
+
+    On the other hand, for IOCTL_HID_WRITE_REPORT request, the driver simply
+    sends the request to the hardware (as simulated by storing the data at
+    DeviceContext->DeviceData) and completes the request immediately. There is
+    no need to use another queue for write operation.
+
+Arguments:
+
+    Device - Handle to a framework device object.
+
+    Queue - Output pointer to a framework I/O queue handle, on success.
+
+Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS                status;
+    WDF_IO_QUEUE_CONFIG     queueConfig;
+    WDF_OBJECT_ATTRIBUTES   queueAttributes;
+    WDFQUEUE                queue;
+    PMANUAL_QUEUE_CONTEXT   queueContext;
+    
+    WDF_IO_QUEUE_CONFIG_INIT(
+                            &queueConfig,
+                            WdfIoQueueDispatchManual);
+
+    WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(
+                            &queueAttributes,
+                            MANUAL_QUEUE_CONTEXT);
+
+    status = WdfIoQueueCreate(
+                            Device,
+                            &queueConfig,
+                            &queueAttributes,
+                            &queue);
+
+    if( !NT_SUCCESS(status) ) {
+        
+        
+        return status;
+    }
+
+    queueContext = GetManualQueueContext(queue);
+    queueContext->Queue         = queue;
+    queueContext->DeviceContext = GetDeviceContext(Device);
+
+    *Queue = queue;
+    return status;
+}
+
+void
+EvtTimerFunc(
+    _In_  WDFTIMER          Timer
+    )
+/*++
+Routine Description:
+
+    This periodic timer callback routine checks the device's manual queue and
+    completes any pending request with data from the device.
+
+Arguments:
+
+    Timer - Handle to a timer object that was obtained from WdfTimerCreate.
+
+Return Value:
+
+    VOID
+
+--*/
+{
+    NTSTATUS                status;
+    WDFQUEUE                queue;
+    PMANUAL_QUEUE_CONTEXT   queueContext;
+    WDFREQUEST              request;
+    HIDMINI_INPUT_REPORT    readReport;
+
+    queue = (WDFQUEUE)WdfTimerGetParentObject(Timer);
+    queueContext = GetManualQueueContext(queue);
+
+    //
+    // see if we have a request in manual queue
+    //
+    status = WdfIoQueueRetrieveNextRequest(
+                            queueContext->Queue,
+                            &request);
+
+    if (NT_SUCCESS(status)) {
+
+        readReport.ReportId = CONTROL_FEATURE_REPORT_ID;
+        readReport.Data     = queueContext->DeviceContext->DeviceData;
+
+        status = RequestCopyFromBuffer(request,
+                            &readReport,
+                            sizeof(readReport));
+
+        WdfRequestComplete(request, status);
+    }
+}
+
+BOOLEAN
+OnInterruptIsr(
+    _In_  WDFINTERRUPT FxInterrupt,
+    _In_  ULONG        MessageID
+)
+/*++
+
+  Routine Description:
+
+    This routine responds to interrupts generated by the H/W.
+    It then waits indefinitely for the user to signal that
+    the interrupt has been acknowledged, allowing the ISR to
+    return. This ISR is called at PASSIVE_LEVEL.
+
+    When asynchronous reads are enabled the frame read is handed
+    to the SPB controller and decoded in SpbAsyncCompletion, so
+    the ISR returns without waiting on the bus. The synchronous
+    path is only used when asynchronous reads are disabled; a
+    synchronous read would overtake frames still in flight.
+
+  Arguments:
+
+    Interrupt - a handle to a framework interrupt object
+    MessageID - message number identifying the device's
+        hardware interrupt message (if using MSI)
+
+  Return Value:
+
+    TRUE if interrupt recognized.
+
+--*/
+{
+    BOOLEAN           fInterruptRecognized = TRUE;
+    WDFDEVICE         device;
+    PDEVICE_CONTEXT   pDevice;
+    NTSTATUS          busStatus;
+    UINT8 touchFrame[TOUCH_READ_SIZE] = { 0 };
+    UINT8 touchEvtClear = 0;
+    UINT8 touchCount = 0;
+    LONG frameBusOps;
+    LONG64 frameBusBytes;
+    LONGLONG interruptTime;
+    BOOLEAN woke = FALSE;
+    BOOLEAN cleared = FALSE;
+    UNREFERENCED_PARAMETER(MessageID);
+
+    device = WdfInterruptGetDevice(FxInterrupt);
+
+    pDevice = GetDeviceContext(device);
+    if (pDevice->OnClose)
+        return TRUE;
+
+    InterlockedIncrement(&pDevice->Interrupts);
+
+    interruptTime = KeQueryPerformanceCounter(NULL).QuadPart;
+    frameBusOps = pDevice->BusOperations;
+    frameBusBytes = pDevice->BusBytes;
+
+    //
+    // A dozing controller only interrupts for a touch. The frame is read
+    // first and the controller put back to full rate after it.
+    //
+    if (pDevice->Dozing && InterlockedExchange(&pDevice->Dozing, 0) != 0)
+    {
+        woke = TRUE;
+        pDevice->WakeTime = interruptTime;
+        InterlockedExchange(&pDevice->WakeReportPending, 1);
+    }
+
+    if (pDevice->AsyncDepth != 0)
+    {
+        busStatus = SpbAsyncSubmitFrameRead(pDevice, interruptTime);
+        cleared = NT_SUCCESS(busStatus);
+        goto exit;
+    }
+
+    busStatus = GoodixReadFrame(pDevice, touchFrame, &touchCount, &cleared);
+    FlightRecorderLog(pDevice, interruptTime, busStatus, touchFrame, touchCount);
+    if (!NT_SUCCESS(busStatus))
+        goto exit;
+
+    CaptureRingLog(pDevice, interruptTime, touchFrame, touchCount);
+
+    TouchProcessFrame(pDevice, touchFrame, touchCount, interruptTime);
+
+exit:
+    //
+    // The frame read clears the status byte, or the slot it was handed to
+    // does; only issue the clear here when the read failed before it.
+    //
+    if (!cleared)
+        GoodixWrite(pDevice, TOUCH_INFO_ADDR, &touchEvtClear, 1);
+
+    if (woke)
+        IdleGovernorWake(pDevice);
+
+    pDevice->LastFrameBusOps = pDevice->BusOperations - frameBusOps;
+    pDevice->LastFrameBusBytes = (LONG)(pDevice->BusBytes - frameBusBytes);
+    if (pDevice->LastFrameBusOps > 1)
+        InterlockedIncrement(&pDevice->MultiOpFrames);
+
+    return fInterruptRecognized;
+}
+
+NTSTATUS
+IdleGovernorCreate(
+    _In_ PDEVICE_CONTEXT pDevice
+)
+/*++
+
+  Routine Description:
+
+    Creates the passive-level timer that puts the controller in doze once
+    no touch has been seen for IdleTimeout milliseconds. The timer runs
+    at half that period, so doze starts between one and one and a half
+    timeouts after the last touch. Nothing is created when IdleTimeout is
+    0.
+
+  Arguments:
+
+    pDevice - the device context
+
+  Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    WDF_TIMER_CONFIG        timerConfig;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+
+    if (IdleTimeout == 0)
+        return STATUS_SUCCESS;
+
+    pDevice->IdleTimerPeriod = max(IdleTimeout / 2, IDLE_TIMER_MIN_PERIOD);
+
+    WDF_TIMER_CONFIG_INIT_PERIODIC(&timerConfig, IdleGovernorTimer, pDevice->IdleTimerPeriod);
+    timerConfig.AutomaticSerialization = FALSE;
+    timerConfig.TolerableDelay = pDevice->IdleTimerPeriod / 2;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = pDevice->Device;
+    attributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+    return WdfTimerCreate(&timerConfig, &attributes, &pDevice->IdleTimer);
+}
+
+VOID
+IdleGovernorTimer(
+    _In_ WDFTIMER Timer
+)
+/*++
+
+  Routine Description:
+
+    Sends the doze command with GoodixDozeEnter when the quiet period has
+    passed and no contact is down. An interrupt that races with the
+    command still leaves the controller reporting at full rate.
+
+--*/
+{
+    PDEVICE_CONTEXT pDevice = GetDeviceContext((WDFDEVICE)WdfTimerGetParentObject(Timer));
+    LONGLONG now = KeQueryPerformanceCounter(NULL).QuadPart;
+    TOUCH_BUS bus;
+
+    if (pDevice->OnClose || pDevice->Dozing || pDevice->Tracker.ActiveMask != 0)
+        return;
+
+    if (TouchTicksToUs(pDevice, now - pDevice->LastActivity) / 1000 < IdleTimeout)
+        return;
+
+    bus.Context = pDevice;
+    bus.Read = GoodixBusRead;
+    bus.Write = GoodixBusWrite;
+
+    if (!NT_SUCCESS(GoodixDozeEnter(&bus, &pDevice->Dozing)))
+        return;
+
+    InterlockedIncrement(&pDevice->DozeEntries);
+}
+
+VOID
+IdleGovernorWake(
+    _In_ PDEVICE_CONTEXT pDevice
+)
+/*++
+
+  Routine Description:
+
+    Returns the controller to full-rate coordinate reporting after the
+    interrupt that ended a doze has been serviced. The frame behind that
+    interrupt is reported like any other, so the wake costs the first
+    report no more than this one register write.
+
+--*/
+{
+    UINT8 command = GOODIX_CMD_READ_COORDS;
+
+    GoodixWrite(pDevice, GOODIX_REG_COMMAND, &command, 1);
+    InterlockedIncrement(&pDevice->DozeExits);
+}
+
+VOID
+TouchProcessFrame(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_reads_(TOUCH_FRAME_SIZE) UINT8* touchFrame,
+    _In_ UINT8 touchCount,
+    _In_ LONGLONG interruptTime
+)
+/*++
+
+  Routine Description:
+
+    Decodes a frame read from TOUCH_INFO_ADDR and completes a pending
+    read request from the manual queue with the resulting report.
+    Callable at IRQL <= DISPATCH_LEVEL.
+
+  Arguments:
+
+    pDevice - the device context
+    touchFrame - status byte followed by the point records
+    touchCount - number of valid point records in touchFrame
+    interruptTime - performance counter value taken when the interrupt
+        for this frame was serviced
+
+--*/
+{
+    inputReport54_t   readReport = { 0 };
+    REPORT_TIMES times;
+    BOOLEAN changed;
+    LONGLONG frameTime = KeQueryPerformanceCounter(NULL).QuadPart;
+    UINT8 touchInfo = touchFrame[0];
+    UINT8* touchBuf = &touchFrame[1];
+
+#ifdef DEBUG
+    UINT8 touchId = 0;
+    UINT16 x = 0, y = 0;
+#endif
+
+    // touchFrame[0] EventID
+    switch (touchInfo & 0xF0)
+    {
+    case GOODIX_TOUCH_EVENT:
+        break;
+    default:
+        InterlockedIncrement(&pDevice->NonTouchFrames);
+        return;
+    }
+
+    InterlockedIncrement(&pDevice->FramesProcessed);
+    pDevice->LastActivity = interruptTime;
+
+    //
+    // contacts beyond what the descriptor declares cannot be reported
+    //
+    touchCount = min(touchCount, pDevice->Profile.MaxContacts);
+
+    InterlockedExchangeAdd(&pDevice->ContactsReported, touchCount);
+    InterlockedIncrement(&pDevice->FramesByContacts[touchCount]);
+
+    if (touchCount != 0)
+    {
+        GoodixDecodePoints(touchBuf, touchCount, readReport.points);
+        TouchTransformPoints(&pDevice->Transform, readReport.points, touchCount);
+#ifdef DEBUG
+        for (UINT8 i = 0; i < touchCount; i++)
+        {
+            touchId = (touchBuf[0 + i * 8] & 0x0F);
+            x = (touchBuf[2 + i * 8] << 8) | touchBuf[1 + i * 8];
+            y = (touchBuf[4 + i * 8] << 8) | touchBuf[3 + i * 8];
+            TraceEvents(TRACE_LEVEL_WARNING, TRACE_DEVICE, "Touch %d X:%d, Y:%d", touchId + 1, x, y);
+            TraceEvents(TRACE_LEVEL_WARNING, TRACE_DEVICE, "Touch %d Buffer %x %x %x %x %x %x %x %x", touchId + 1, touchBuf[0 + i * 8], touchBuf[1 + i * 8], touchBuf[2 + i * 8], touchBuf[3 + i * 8], touchBuf[4 + i * 8], touchBuf[5 + i * 8], touchBuf[6 + i * 8], touchBuf[7 + i * 8]);
+        }
+#endif
+    }
+
+    //
+    // Smooth the positions, project them ahead, then add a lift for every
+    // contact that has left since the last frame. The sync and async paths
+    // can both get here, so the filter, predictor and tracker are locked.
+    //
+    WdfSpinLockAcquire(pDevice->TrackerLock);
+    changed = TRUE;
+    if (pDevice->Filter.MinCutoff != 0)
+    {
+        changed = TouchFilterPoints(&pDevice->Filter,
+                                    readReport.points,
+                                    touchCount,
+                                    interruptTime,
+                                    pDevice->PerfFrequency.QuadPart);
+    }
+    if (pDevice->Predictor.Horizon != 0 &&
+        TouchPredictPoints(&pDevice->Predictor,
+                           readReport.points,
+                           touchCount,
+                           interruptTime,
+                           pDevice->PerfFrequency.QuadPart))
+    {
+        changed = TRUE;
+    }
+    readReport.DIG_TouchScreenContactCount = TouchTrackerUpdate(&pDevice->Tracker,
+                                                                readReport.points,
+                                                                touchCount,
+                                                                pDevice->Profile.MaxContacts);
+    WdfSpinLockRelease(pDevice->TrackerLock);
+
+    //
+    // nothing down and nothing left to lift
+    //
+    if (readReport.DIG_TouchScreenContactCount == 0)
+        return;
+
+    //
+    // filtering and prediction held every contact where it was and none
+    // lifted
+    //
+    if (!changed && readReport.DIG_TouchScreenContactCount == touchCount)
+    {
+        InterlockedIncrement(&pDevice->FramesSuppressed);
+        return;
+    }
+
+    readReport.reportId = CONTROL_FEATURE_REPORT_ID;
+
+    times.Interrupt = interruptTime;
+    times.Queued = KeQueryPerformanceCounter(NULL).QuadPart;
+
+    LatencyHistogramAdd(&pDevice->LatencyHistograms[HIDMINI_LATENCY_STAGE_BUS],
+                        TouchTicksToUs(pDevice, frameTime - times.Interrupt));
+    LatencyHistogramAdd(&pDevice->LatencyHistograms[HIDMINI_LATENCY_STAGE_DECODE],
+                        TouchTicksToUs(pDevice, times.Queued - frameTime));
+
+    TouchSubmitReport(pDevice, &readReport, &times);
+}
+
+VOID
+TouchLiftContacts(
+    _In_ PDEVICE_CONTEXT pDevice
+)
+/*++
+
+  Routine Description:
+
+    Queues the lifts of every contact still down, and of any lift still
+    pending, as the reports a frame with no contacts would produce, then
+    clears the contact state. Called once no more frames can be read, so
+    the host never keeps a contact down that the controller has forgotten.
+
+  Arguments:
+
+    pDevice - the device context
+
+--*/
+{
+    inputReport54_t   report;
+    REPORT_TIMES      times;
+
+    for (;;)
+    {
+        RtlZeroMemory(&report, sizeof(report));
+
+        WdfSpinLockAcquire(pDevice->TrackerLock);
+        report.DIG_TouchScreenContactCount = TouchTrackerUpdate(&pDevice->Tracker,
+                                                                report.points,
+                                                                0,
+                                                                pDevice->Profile.MaxContacts);
+        if (report.DIG_TouchScreenContactCount == 0)
+        {
+            TouchTrackerReset(&pDevice->Tracker);
+            pDevice->Filter.ActiveMask = 0;
+            pDevice->Predictor.ActiveMask = 0;
+            WdfSpinLockRelease(pDevice->TrackerLock);
+            break;
+        }
+        WdfSpinLockRelease(pDevice->TrackerLock);
+
+        //
+        // more lifts than one report holds go out in several
+        //
+        report.reportId = CONTROL_FEATURE_REPORT_ID;
+        times.Interrupt = KeQueryPerformanceCounter(NULL).QuadPart;
+        times.Queued = times.Interrupt;
+
+        TouchSubmitReport(pDevice, &report, &times);
+    }
+}
+
+VOID
+TouchSubmitReport(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ inputReport54_t* pReport,
+    _In_ PREPORT_TIMES pTimes
+)
+/*++
+
+  Routine Description:
+
+    Queues a decoded report on the device's report ring and hands out as
+    many queued reports as there are pending reads. When the ring is full
+    the oldest report is discarded so the newest contact state survives;
+    any lifts it carried are folded into the new report first, so a
+    contact is never left down on the host.
+
+  Arguments:
+
+    pDevice - the device context
+    pReport - the report to queue
+    pTimes - when the report's interrupt was serviced and when it was
+        decoded
+
+--*/
+{
+    PREPORT_RING ring = &pDevice->ReportRing;
+    inputReport54_t dropped;
+    REPORT_TIMES droppedTimes;
+
+    if (!ReportRingPush(ring, pReport, pTimes))
+    {
+        InterlockedIncrement(&ring->Overflows);
+
+        if (ReportRingPop(ring, &dropped, &droppedTimes))
+        {
+            InterlockedDecrement(&ring->Queued);
+
+            if (!TouchReportMergeLifts(&dropped, pReport, pDevice->Profile.MaxContacts))
+                InterlockedIncrement(&ring->LiftsLost);
+        }
+
+        if (!ReportRingPush(ring, pReport, pTimes))
+            return;
+    }
+
+    InterlockedIncrement(&ring->Queued);
+
+    TouchDeliverReports(pDevice);
+}
+
+VOID
+TouchDeliverReports(
+    _In_ PDEVICE_CONTEXT pDevice
+)
+/*++
+
+  Routine Description:
+
+    Completes reads parked in the manual queue with reports from the ring
+    until either runs out. Both the producer (after queuing a report) and
+    ReadReport (after parking a request) call this, so whichever of the two
+    finishes last sees the other's work and no report is left stranded.
+
+  Arguments:
+
+    pDevice - the device context
+
+--*/
+{
+    NTSTATUS          status;
+    WDFREQUEST        request;
+    inputReport54_t   report;
+    REPORT_TIMES      times;
+    UCHAR             packed[sizeof(inputReport54_t)];
+    ULONG             packedLength;
+
+    while (pDevice->ReportRing.Queued > 0 || pDevice->HybridPending)
+    {
+        status = WdfIoQueueRetrieveNextRequest(
+            pDevice->ManualQueue,
+            &request);
+
+        if (!NT_SUCCESS(status))
+            break;
+
+        if (!TouchReportDequeue(pDevice, &report, &times))
+        {
+            //
+            // Another caller took the last report; park the read again.
+            //
+            status = WdfRequestRequeue(request);
+            if (!NT_SUCCESS(status))
+                WdfRequestComplete(request, status);
+            break;
+        }
+
+        packedLength = TouchReportPack(&pDevice->Profile, &report, packed);
+        status = RequestCopyFromBuffer(request,
+            packed,
+            packedLength);
+        if (NT_SUCCESS(status)) {
+            InterlockedIncrement(&pDevice->ReportsCompleted);
+            InterlockedExchangeAdd(&pDevice->ReportBytesCopied, (LONG)packedLength);
+            TouchRecordLatency(pDevice, &times);
+        }
+
+        WdfRequestComplete(request, status);
+    }
+}
+
+VOID
+TouchRecordLatency(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ PREPORT_TIMES pTimes
+)
+/*++
+
+  Routine Description:
+
+    Accounts for a report that is about to complete a read: the time it
+    waited on the ring for a read to arrive, and the time from the
+    interrupt that produced it to now. The first report of a frame read
+    after a resume also records the time since OnD0Entry started, and the
+    first after a doze the time since the interrupt that woke the
+    controller. Reports queued before the resume do not count.
+
+  Arguments:
+
+    pDevice - the device context
+    pTimes - the times recorded for the report
+
+--*/
+{
+    LONGLONG now = KeQueryPerformanceCounter(NULL).QuadPart;
+
+    if (pDevice->ResumeReportPending &&
+        pTimes->Interrupt >= pDevice->ResumeTime &&
+        InterlockedExchange(&pDevice->ResumeReportPending, 0) != 0)
+    {
+        pDevice->ResumeReportUs = TouchTicksToUs(pDevice, now - pDevice->ResumeTime);
+    }
+
+    if (pDevice->WakeReportPending &&
+        InterlockedExchange(&pDevice->WakeReportPending, 0) != 0)
+    {
+        pDevice->WakeReportUs = TouchTicksToUs(pDevice, now - pDevice->WakeTime);
+        if (pDevice->WakeReportUs > pDevice->MaxWakeReportUs)
+            pDevice->MaxWakeReportUs = pDevice->WakeReportUs;
+    }
+
+    LatencyHistogramAdd(&pDevice->LatencyHistograms[HIDMINI_LATENCY_STAGE_PENDING],
+                        TouchTicksToUs(pDevice, now - pTimes->Queued));
+    LatencyHistogramAdd(&pDevice->LatencyHistograms[HIDMINI_LATENCY_STAGE_TOTAL],
+                        TouchTicksToUs(pDevice, now - pTimes->Interrupt));
+}
+
+ULONG
+TouchTicksToUs(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ LONGLONG ticks
+)
+{
+    if (ticks <= 0 || pDevice->PerfFrequency.QuadPart == 0)
+        return 0;
+
+    return (ULONG)min((ticks * 1000000) / pDevice->PerfFrequency.QuadPart, MAXULONG);
+}
+
+VOID
+LatencyHistogramAdd(
+    _Inout_ PLATENCY_HISTOGRAM pHistogram,
+    _In_ ULONG latencyUs
+)
+/*++
+
+  Routine Description:
+
+    Counts one sample in its log2 bucket: bucket 0 holds samples below
+    1us, bucket n holds [2^(n-1), 2^n) us, and the last bucket everything
+    above. Each field is updated atomically on its own; a reader may see
+    a sample in Count before it shows up in its bucket.
+
+--*/
+{
+    ULONG bucket = 0;
+
+    if (latencyUs != 0)
+    {
+        BitScanReverse(&bucket, latencyUs);
+        bucket = min(bucket + 1, HIDMINI_LATENCY_BUCKETS - 1);
+    }
+
+    InterlockedIncrement(&pHistogram->Buckets[bucket]);
+    InterlockedIncrement(&pHistogram->Count);
+    InterlockedExchangeAdd64(&pHistogram->SumUs, latencyUs);
+    CounterRaiseMax(&pHistogram->MaxUs, latencyUs);
+}
+
+VOID
+CounterRaiseMax(
+    _Inout_ volatile LONG* pMax,
+    _In_ ULONG value
+)
+/*++
+
+  Routine Description:
+
+    Raises an unsigned maximum kept in a LONG to value. The compare-exchange
+    is retried until either it lands or another writer has stored a value
+    at least as large, so concurrent updates never lower the maximum.
+
+--*/
+{
+    LONG current = ReadNoFence(pMax);
+    LONG seen;
+
+    while ((ULONG)current < value)
+    {
+        seen = InterlockedCompareExchange(pMax, (LONG)value, current);
+        if (seen == current)
+            break;
+        current = seen;
+    }
+}
+
+BOOLEAN
+TouchReportDequeueHybrid(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _Out_ inputReport54_t* pReport,
+    _Out_ PREPORT_TIMES pTimes
+)
+/*++
+
+  Routine Description:
+
+    Hybrid mode counterpart of TouchReportDequeue. Hands out the next
+    ContactsPerReport contacts of the frame in progress, taking a new frame
+    from the ring once the previous one has been sent in full. The first
+    piece of a frame carries its total contact count, the rest carry zero.
+
+  Arguments:
+
+    pDevice - the device context
+    pReport - receives the next report
+    pTimes - receives the times of the frame it belongs to
+
+  Return Value:
+
+    TRUE if a report was returned.
+
+--*/
+{
+    PREPORT_RING ring = &pDevice->ReportRing;
+    inputReport54_t* frame = &pDevice->HybridReport;
+
+    WdfSpinLockAcquire(pDevice->HybridLock);
+
+    if (!pDevice->HybridPending)
+    {
+        if (!ReportRingPop(ring, frame, &pDevice->HybridTimes))
+        {
+            WdfSpinLockRelease(pDevice->HybridLock);
+            return FALSE;
+        }
+
+        InterlockedDecrement(&ring->Queued);
+
+        if (CoalesceMotion)
+        {
+            while (ReportRingPopMotion(ring, frame, &pDevice->HybridTimes))
+            {
+                InterlockedDecrement(&ring->Queued);
+                InterlockedIncrement(&ring->Coalesced);
+            }
+        }
+
+        pDevice->HybridOffset = 0;
+        InterlockedExchange(&pDevice->HybridPending, TRUE);
+    }
+
+    pDevice->HybridOffset = TouchReportSlice(&pDevice->Profile,
+                                             frame,
+                                             pDevice->HybridOffset,
+                                             pReport);
+    *pTimes = pDevice->HybridTimes;
+    if (pDevice->HybridOffset >= frame->DIG_TouchScreenContactCount)
+        InterlockedExchange(&pDevice->HybridPending, FALSE);
+
+    WdfSpinLockRelease(pDevice->HybridLock);
+
+    return TRUE;
+}
+
+BOOLEAN
+TouchReportDequeue(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _Out_ inputReport54_t* pReport,
+    _Out_ PREPORT_TIMES pTimes
+)
+/*++
+
+  Routine Description:
+
+    Takes the oldest report from the ring. When motion coalescing is
+    enabled and the consumer has fallen behind, consecutive motion-only
+    reports for the same set of contacts are merged into the newest one;
+    reports that add or lift a contact are never merged away.
+
+  Arguments:
+
+    pDevice - the device context
+    pReport - receives the report
+    pTimes - receives the times of the report
+
+  Return Value:
+
+    TRUE if a report was returned.
+
+--*/
+{
+    PREPORT_RING ring = &pDevice->ReportRing;
+
+    if (pDevice->HybridLock != NULL)
+        return TouchReportDequeueHybrid(pDevice, pReport, pTimes);
+
+    if (!ReportRingPop(ring, pReport, pTimes))
+        return FALSE;
+
+    InterlockedDecrement(&ring->Queued);
+
+    if (CoalesceMotion)
+    {
+        while (ReportRingPopMotion(ring, pReport, pTimes))
+        {
+            InterlockedDecrement(&ring->Queued);
+            InterlockedIncrement(&ring->Coalesced);
+        }
+    }
+
+    return TRUE;
+}
+
+NTSTATUS
+ReportRingCreate(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ ULONG depth
+)
+/*++
+
+  Routine Description:
+
+    Allocates the report ring. The depth is clamped to
+    [2, REPORT_RING_MAX_DEPTH] and rounded up to a power of two.
+
+  Arguments:
+
+    pDevice - the device context
+    depth - requested number of reports the ring can hold
+
+  Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS                status;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    PREPORT_RING_CELL       ringCells;
+    ULONG                   cells = 2;
+
+    depth = min(max(depth, 2), REPORT_RING_MAX_DEPTH);
+    while (cells < depth)
+        cells <<= 1;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = pDevice->Device;
+
+    status = WdfMemoryCreate(&attributes,
+                             NonPagedPoolNx,
+                             TOUCH_POOL_TAG,
+                             cells * sizeof(REPORT_RING_CELL),
+                             &pDevice->ReportRingMemory,
+                             (PVOID*)&ringCells);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    ReportRingInit(&pDevice->ReportRing, ringCells, cells);
+
+    return status;
+}
+
+NTSTATUS
+FlightRecorderCreate(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ ULONG depth
+)
+/*++
+
+  Routine Description:
+
+    Allocates the flight recorder. The depth is clamped to
+    FLIGHT_RECORDER_MAX_DEPTH and rounded up to a power of two; a depth of
+    zero leaves the recorder disabled.
+
+  Arguments:
+
+    pDevice - the device context
+    depth - requested number of records the recorder keeps
+
+  Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS                status;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    PFLIGHT_RECORDER        recorder = &pDevice->FlightRecorder;
+    ULONG                   records = 2;
+
+    if (depth == 0)
+        return STATUS_SUCCESS;
+
+    depth = min(depth, FLIGHT_RECORDER_MAX_DEPTH);
+    while (records < depth)
+        records <<= 1;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = pDevice->Device;
+
+    status = WdfMemoryCreate(&attributes,
+                             NonPagedPoolNx,
+                             TOUCH_POOL_TAG,
+                             records * sizeof(HIDMINI_FLIGHT_RECORD),
+                             &recorder->Memory,
+                             (PVOID*)&recorder->Records);
+    if (!NT_SUCCESS(status)) {
+        recorder->Records = NULL;
+        return status;
+    }
+
+    RtlZeroMemory(recorder->Records, records * sizeof(HIDMINI_FLIGHT_RECORD));
+    recorder->Mask = records - 1;
+    recorder->Next = 0;
+
+    return status;
+}
+
+VOID
+FlightRecorderLog(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ LONGLONG interruptTime,
+    _In_ NTSTATUS spbStatus,
+    _In_reads_(TOUCH_FRAME_SIZE) const UINT8* touchFrame,
+    _In_ UINT8 touchCount
+)
+/*++
+
+  Routine Description:
+
+    Appends one frame to the flight recorder, overwriting the oldest
+    record once the ring has wrapped. Safe to call concurrently from the
+    interrupt thread and SPB completion routines.
+
+  Arguments:
+
+    pDevice - the device context
+    interruptTime - performance counter value of the frame's interrupt
+    spbStatus - status of the bus transfer that read the frame
+    touchFrame - status byte followed by the point records
+    touchCount - number of valid point records in touchFrame
+
+--*/
+{
+    PFLIGHT_RECORDER recorder = &pDevice->FlightRecorder;
+    PHIDMINI_FLIGHT_RECORD record;
+    const UINT8* point;
+    LONG sequence;
+
+    if (recorder->Records == NULL)
+        return;
+
+    sequence = InterlockedIncrement(&recorder->Next);
+    record = &recorder->Records[(ULONG)(sequence - 1) & recorder->Mask];
+
+    //
+    // Mark the record invalid before touching its payload
+    //
+    InterlockedExchange((volatile LONG*)&record->Sequence, 0);
+
+    touchCount = min(touchCount, MAX_POINT_NUM);
+
+    record->Timestamp = (ULONGLONG)interruptTime;
+    record->SpbStatus = spbStatus;
+    record->Status = touchFrame[0];
+    record->ContactCount = touchCount;
+
+    for (UINT8 i = 0; i < touchCount; i++)
+    {
+        point = &touchFrame[1 + i * BYTES_PER_COORD];
+        record->Contacts[i] = ((ULONG)(point[0] & 0x0F) << 28) |
+                              ((ULONG)((point[1] | (point[2] << 8)) & 0x3FFF) << 14) |
+                              ((ULONG)(point[3] | (point[4] << 8)) & 0x3FFF);
+    }
+
+    WriteRelease((volatile LONG*)&record->Sequence, sequence);
+}
+
+BOOLEAN
+FlightRecorderRead(
+    _In_ PFLIGHT_RECORDER pRecorder,
+    _In_ ULONG sequence,
+    _Out_ PHIDMINI_FLIGHT_RECORD pRecord
+)
+/*++
+
+  Routine Description:
+
+    Copies the record with the given sequence number, if it is complete
+    and has not been overwritten.
+
+  Return Value:
+
+    TRUE if pRecord holds the record.
+
+--*/
+{
+    PHIDMINI_FLIGHT_RECORD record = &pRecorder->Records[(sequence - 1) & pRecorder->Mask];
+
+    if ((ULONG)ReadAcquire((volatile LONG*)&record->Sequence) != sequence)
+        return FALSE;
+
+    RtlCopyMemory(pRecord, record, sizeof(HIDMINI_FLIGHT_RECORD));
+
+    //
+    // a writer that claimed the record meanwhile has cleared the sequence
+    //
+    MemoryBarrier();
+    return (ULONG)ReadNoFence((volatile LONG*)&record->Sequence) == sequence;
+}
+
+NTSTATUS
+CaptureRingCreate(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ ULONG depth
+)
+/*++
+
+  Routine Description:
+
+    Allocates the raw frame capture ring, sized like the flight recorder.
+    Capture starts disabled; a depth of zero leaves it unavailable.
+
+  Arguments:
+
+    pDevice - the device context
+    depth - requested number of frames the ring can hold
+
+  Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS                status;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+    PCAPTURE_RING           ring = &pDevice->CaptureRing;
+    ULONG                   frames = 2;
+
+    if (depth == 0)
+        return STATUS_SUCCESS;
+
+    depth = min(depth, CAPTURE_RING_MAX_DEPTH);
+    while (frames < depth)
+        frames <<= 1;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = pDevice->Device;
+
+    status = WdfMemoryCreate(&attributes,
+                             NonPagedPoolNx,
+                             TOUCH_POOL_TAG,
+                             frames * sizeof(HIDMINI_CAPTURE_FRAME),
+                             &ring->Memory,
+                             (PVOID*)&ring->Frames);
+    if (!NT_SUCCESS(status)) {
+        ring->Frames = NULL;
+        return status;
+    }
+
+    RtlZeroMemory(ring->Frames, frames * sizeof(HIDMINI_CAPTURE_FRAME));
+    ring->Mask = frames - 1;
+    ring->Next = 0;
+    ring->Enabled = FALSE;
+    ring->StartSequence = 1;
+
+    return status;
+}
+
+VOID
+CaptureRingLog(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ LONGLONG interruptTime,
+    _In_reads_(TOUCH_FRAME_SIZE) const UINT8* touchFrame,
+    _In_ UINT8 touchCount
+)
+/*++
+
+  Routine Description:
+
+    Records the bytes of a frame read, if the host has capture enabled.
+
+  Arguments:
+
+    pDevice - the device context
+    interruptTime - performance counter value of the frame's interrupt
+    touchFrame - status byte followed by the point records
+    touchCount - number of valid point records in touchFrame
+
+--*/
+{
+    PCAPTURE_RING ring = &pDevice->CaptureRing;
+    PHIDMINI_CAPTURE_FRAME frame;
+    LONG sequence;
+
+    if (ring->Frames == NULL || !ReadNoFence(&ring->Enabled))
+        return;
+
+    sequence = InterlockedIncrement(&ring->Next);
+    frame = &ring->Frames[(ULONG)(sequence - 1) & ring->Mask];
+
+    InterlockedExchange((volatile LONG*)&frame->Sequence, 0);
+
+    touchCount = min(touchCount, MAX_POINT_NUM);
+
+    frame->Timestamp = (ULONGLONG)interruptTime;
+    frame->Length = (UCHAR)(1 + touchCount * BYTES_PER_COORD);
+    RtlCopyMemory(frame->Bytes, touchFrame, frame->Length);
+
+    WriteRelease((volatile LONG*)&frame->Sequence, sequence);
+}
+
+BOOLEAN
+CaptureRingRead(
+    _In_ PCAPTURE_RING pRing,
+    _In_ ULONG sequence,
+    _Out_ PHIDMINI_CAPTURE_FRAME pFrame
+)
+/*++
+
+  Routine Description:
+
+    Copies the frame with the given sequence number, if it is complete and
+    has not been overwritten; see FlightRecorderRead.
+
+  Return Value:
+
+    TRUE if pFrame holds the frame.
+
+--*/
+{
+    PHIDMINI_CAPTURE_FRAME frame = &pRing->Frames[(sequence - 1) & pRing->Mask];
+
+    if ((ULONG)ReadAcquire((volatile LONG*)&frame->Sequence) != sequence)
+        return FALSE;
+
+    RtlCopyMemory(pFrame, frame, sizeof(HIDMINI_CAPTURE_FRAME));
+
+    MemoryBarrier();
+    return (ULONG)ReadNoFence((volatile LONG*)&frame->Sequence) == sequence;
+}
+
+NTSTATUS
+SpbArenaCreate(
+    _In_ PDEVICE_CONTEXT pDevice
+)
+/*++
+
+  Routine Description:
+
+    Allocates the per-device SPB transfer arena and the lock that
+    serializes its users. Both objects are parented to the device and
+    released by the framework when the device is deleted.
+
+  Arguments:
+
+    pDevice - the device context
+
+  Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS                status;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = pDevice->Device;
+
+    status = WdfWaitLockCreate(&attributes, &pDevice->SpbLock);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    status = WdfMemoryCreate(&attributes,
+                             NonPagedPoolNxCacheAligned,
+                             TOUCH_POOL_TAG,
+                             sizeof(SPB_TRANSFER_ARENA),
+                             &pDevice->SpbArenaMemory,
+                             (PVOID*)&pDevice->SpbArena);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    RtlZeroMemory(pDevice->SpbArena, sizeof(SPB_TRANSFER_ARENA));
+    pDevice->SpbPoolAllocations = 0;
+
+    return status;
+}
+
+NTSTATUS
+GoodixRead(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ UINT32 addr,
+    _In_ UINT8* readBuf,
+    _In_ UINT32 readLen
+)
+{
+    NTSTATUS status;
+    PUINT8 TxBuf;
+    PUINT8 RxBuf;
+    BOOLEAN fromPool = FALSE;
+
+    if (readLen == 0 || readBuf == NULL)
+        return STATUS_INVALID_PARAMETER;
+
+    WdfWaitLockAcquire(pDevice->SpbLock, NULL);
+
+    TxBuf = pDevice->SpbArena->TxBuffer;
+    RxBuf = pDevice->SpbArena->RxBuffer;
+
+    if (readLen > sizeof(pDevice->SpbArena->RxBuffer))
+    {
+        RxBuf = (PUINT8)ExAllocatePool2(
+            POOL_FLAG_NON_PAGED,
+            readLen,
+            TOUCH_POOL_TAG
+        );
+        if (RxBuf == NULL)
+        {
+            WdfWaitLockRelease(pDevice->SpbLock);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        InterlockedIncrement(&pDevice->SpbPoolAllocations);
+        fromPool = TRUE;
+    }
+
+    TxBuf[0] = (addr >> 8) & 0xFF;
+    TxBuf[1] = addr & 0xFF;
+
+    status = SpbDeviceWriteRead(pDevice, TxBuf, RxBuf, GOODIX_ADDR_LEN, readLen);
+
+    if (NT_SUCCESS(status))
+        RtlCopyMemory(readBuf, RxBuf, readLen);
+
+    if (fromPool)
+        ExFreePoolWithTag(RxBuf, TOUCH_POOL_TAG);
+
+    WdfWaitLockRelease(pDevice->SpbLock);
+    return status;
+}
+
+NTSTATUS
+GoodixLoadControllerConfig(
+    _In_ PDEVICE_CONTEXT pDevice
+)
+/*++
+
+  Routine Description:
+
+    Reads the product ID, firmware version and configuration version, and
+    unless they match the snapshot in the registry, the configuration block
+    with its checksum. The configuration version is the first byte of the
+    block, so a configuration written since the snapshot was taken is
+    noticed for the cost of one more byte.
+    The resolution and contact count found there replace XMax, YMax and
+    MaxContacts from the registry, and the profile, transform and report
+    descriptor are rebuilt from them. The contact count can only go down,
+    so the report layout chosen in EvtDeviceAdd still fits.
+
+  Arguments:
+
+    pDevice - the device context
+
+  Return Value:
+
+    NTSTATUS; on failure the registry settings stay in effect.
+
+--*/
+{
+    NTSTATUS status;
+    UCHAR id[GOODIX_PRODUCT_ID_LENGTH + sizeof(USHORT)];
+    UCHAR config[GOODIX_CONFIG_LENGTH + 1];
+    UCHAR configVersion;
+    GOODIX_CONTROLLER_INFO info = { 0 };
+    GOODIX_CONTROLLER_INFO snapshot;
+    TOUCH_CONFIG touchConfig = TouchConfig;
+    TOUCH_PROFILE profile;
+    TOUCH_TRANSFORM transform;
+    UCHAR descriptor[TOUCH_REPORT_DESCRIPTOR_MAX_SIZE];
+    USHORT descriptorLength;
+
+    status = GoodixRead(pDevice, GOODIX_REG_PRODUCT_ID, id, sizeof(id));
+    if (!NT_SUCCESS(status))
+        return status;
+
+    RtlCopyMemory(info.ProductId, id, GOODIX_PRODUCT_ID_LENGTH);
+    info.FirmwareVersion = id[GOODIX_PRODUCT_ID_LENGTH] | (id[GOODIX_PRODUCT_ID_LENGTH + 1] << 8);
+
+    status = GoodixRead(pDevice, GOODIX_REG_CONFIG + GOODIX_CONFIG_VERSION, &configVersion, 1);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (ControllerSnapshotQuery(pDevice, &snapshot) &&
+        RtlCompareMemory(snapshot.ProductId, info.ProductId, GOODIX_PRODUCT_ID_LENGTH) == GOODIX_PRODUCT_ID_LENGTH &&
+        snapshot.FirmwareVersion == info.FirmwareVersion &&
+        snapshot.ConfigVersion == configVersion)
+    {
+        info = snapshot;
+    }
+    else
+    {
+        status = GoodixRead(pDevice, GOODIX_REG_CONFIG, config, sizeof(config));
+        if (!NT_SUCCESS(status))
+            return status;
+
+        if (!GoodixParseConfig(config, &info))
+            return STATUS_DEVICE_DATA_ERROR;
+
+        ControllerSnapshotSave(pDevice, &info);
+    }
+
+#ifdef DEBUG
+    TraceEvents(TRACE_LEVEL_INFORMATION, TRACE_DEVICE, "GT%c%c%c%c fw %04x cfg %02x: %dx%d, %d contacts",
+                info.ProductId[0], info.ProductId[1], info.ProductId[2], info.ProductId[3],
+                info.FirmwareVersion, info.ConfigVersion, info.XResolution, info.YResolution,
+                info.MaxContacts);
+#endif
+
+    touchConfig.XMax = info.XResolution;
+    touchConfig.YMax = info.YResolution;
+    touchConfig.MaxContacts = min(touchConfig.MaxContacts, info.MaxContacts);
+
+    //
+    // Built aside and installed together, so a failure leaves the device
+    // as EvtDeviceAdd configured it
+    //
+    TouchProfileInit(&touchConfig, &profile);
+    TouchTransformInit(&touchConfig, &profile, &transform);
+
+    status = TouchReportDescriptorBuild(&profile,
+                                        descriptor,
+                                        sizeof(descriptor),
+                                        &descriptorLength);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    RtlCopyMemory(pDevice->ReportDescriptorBuffer, descriptor, descriptorLength);
+    pDevice->HidDescriptor.DescriptorList[0].wReportLength = descriptorLength;
+    pDevice->Transform = transform;
+    pDevice->Profile = profile;
+    pDevice->Controller = info;
+
+    return status;
+}
+
+BOOLEAN
+ControllerSnapshotQuery(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _Out_ PGOODIX_CONTROLLER_INFO Info
+)
+{
+    WDFKEY hKey;
+    NTSTATUS status;
+    UNICODE_STRING snapshotName;
+    CONTROLLER_SNAPSHOT snapshot;
+    ULONG valueLength = 0;
+    ULONG valueType = 0;
+
+    RtlZeroMemory(Info, sizeof(GOODIX_CONTROLLER_INFO));
+
+    status = WdfDeviceOpenRegistryKey(pDevice->Device,
+        PLUGPLAY_REGKEY_DEVICE,
+        KEY_READ,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &hKey);
+    if (!NT_SUCCESS(status))
+        return FALSE;
+
+    RtlInitUnicodeString(&snapshotName, L"ControllerSnapshot");
+    status = WdfRegistryQueryValue(hKey, &snapshotName, sizeof(snapshot),
+                                   &snapshot, &valueLength, &valueType);
+    WdfRegistryClose(hKey);
+
+    if (!NT_SUCCESS(status) || valueType != REG_BINARY || valueLength != sizeof(snapshot) ||
+        snapshot.Version != CONTROLLER_SNAPSHOT_VERSION)
+        return FALSE;
+
+    *Info = snapshot.Info;
+
+    return TRUE;
+}
+
+VOID
+ControllerSnapshotSave(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ PGOODIX_CONTROLLER_INFO Info
+)
+{
+    WDFKEY hKey;
+    NTSTATUS status;
+    UNICODE_STRING snapshotName;
+    CONTROLLER_SNAPSHOT snapshot;
+
+    status = WdfDeviceOpenRegistryKey(pDevice->Device,
+        PLUGPLAY_REGKEY_DEVICE,
+        KEY_READ | KEY_WRITE,
+        WDF_NO_OBJECT_ATTRIBUTES,
+        &hKey);
+    if (!NT_SUCCESS(status))
+        return;
+
+    RtlZeroMemory(&snapshot, sizeof(snapshot));
+    snapshot.Version = CONTROLLER_SNAPSHOT_VERSION;
+    snapshot.Info = *Info;
+
+    RtlInitUnicodeString(&snapshotName, L"ControllerSnapshot");
+    WdfRegistryAssignValue(hKey, &snapshotName, REG_BINARY, sizeof(snapshot), &snapshot);
+    WdfRegistryClose(hKey);
+}
+
+NTSTATUS
+GoodixReadFrame(
+    _In_  PDEVICE_CONTEXT pDevice,
+    _Out_writes_(TOUCH_READ_SIZE) UINT8* frameBuf,
+    _Out_ UINT8* touchCount,
+    _Out_ BOOLEAN* cleared
+)
+/*++
+
+  Routine Description:
+
+    Reads a frame with GoodixReadFrameFrom over the SPB bus. The number of
+    records fetched with the status byte follows the contact count of the
+    previous frame, or of a short frame that had to be dropped.
+
+  Arguments:
+
+    pDevice - the device context
+    frameBuf - receives the status byte followed by the point records
+    touchCount - receives the number of valid point records
+    cleared - receives whether the status byte was cleared
+
+  Return Value:
+
+    STATUS_CRC_ERROR if the frame was corrupt, STATUS_DEVICE_DATA_ERROR if
+    it was short, otherwise the bus status.
+
+--*/
+{
+    NTSTATUS status;
+    TOUCH_BUS bus;
+    ULONG events;
+
+    bus.Context = pDevice;
+    bus.Read = GoodixBusRead;
+    bus.Write = GoodixBusWrite;
+
+    status = GoodixReadFrameFrom(&bus,
+                                 pDevice->BurstPointCount,
+                                 FrameChecksum != 0,
+                                 frameBuf,
+                                 touchCount,
+                                 &events);
+
+    if (events & GOODIX_FRAME_TOP_UP)
+        InterlockedIncrement(&pDevice->BurstTopUpReads);
+    if (events & GOODIX_FRAME_REREAD)
+        InterlockedIncrement(&pDevice->FrameRereads);
+    if (events & GOODIX_FRAME_CORRUPT)
+        InterlockedIncrement(&pDevice->CorruptFrames);
+
+    if (events & GOODIX_FRAME_SHORT)
+    {
+        InterlockedIncrement(&pDevice->BurstShortFrames);
+        pDevice->BurstPointCount = min(frameBuf[0] & GOODIX_TOUCH_COUNT_MASK, MAX_POINT_NUM);
+    }
+
+    if (NT_SUCCESS(status) && (frameBuf[0] & 0xF0) == GOODIX_TOUCH_EVENT)
+        pDevice->BurstPointCount = max(*touchCount, 1);
+
+    *cleared = (events & GOODIX_FRAME_CLEARED) != 0;
+
+    return status;
+}
+
+NTSTATUS
+GoodixBusRead(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _Out_writes_bytes_(Length) UINT8* Buffer,
+    _In_ ULONG Length,
+    _In_ BOOLEAN Clear
+)
+/*++
+
+  Routine Description:
+
+    TOUCH_BUS_READ over the SPB target. A read that clears the status byte
+    goes out as one SPB sequence built in the transfer arena: address
+    write, read, clear write.
+
+--*/
+{
+    PDEVICE_CONTEXT pDevice = (PDEVICE_CONTEXT)Context;
+    PSPB_TRANSFER_ARENA arena = pDevice->SpbArena;
+    SPB_SEQUENCE sequence;
+    NTSTATUS status;
+
+    if (!Clear)
+        return GoodixRead(pDevice, Address, Buffer, Length);
+
+    if (Length == 0 || Length > sizeof(arena->RxBuffer))
+        return STATUS_INVALID_PARAMETER;
+
+    WdfWaitLockAcquire(pDevice->SpbLock, NULL);
+
+    arena->TxBuffer[0] = (Address >> 8) & 0xFF;
+    arena->TxBuffer[1] = Address & 0xFF;
+    arena->ClearBuffer[0] = (TOUCH_INFO_ADDR >> 8) & 0xFF;
+    arena->ClearBuffer[1] = TOUCH_INFO_ADDR & 0xFF;
+    arena->ClearBuffer[2] = 0;
+
+    SpbSequenceInit(&sequence);
+    SpbSequenceAdd(&sequence, SpbTransferDirectionToDevice, arena->TxBuffer, GOODIX_ADDR_LEN);
+    SpbSequenceAdd(&sequence, SpbTransferDirectionFromDevice, arena->RxBuffer, Length);
+    SpbSequenceAdd(&sequence, SpbTransferDirectionToDevice, arena->ClearBuffer, sizeof(arena->ClearBuffer));
+
+    status = SpbDeviceExecuteSequence(pDevice, &sequence);
+    if (NT_SUCCESS(status))
+        RtlCopyMemory(Buffer, arena->RxBuffer, Length);
+
+    WdfWaitLockRelease(pDevice->SpbLock);
+
+    return status;
+}
+
+NTSTATUS
+GoodixBusWrite(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _In_reads_bytes_(Length) const UINT8* Buffer,
+    _In_ ULONG Length
+)
+{
+    return GoodixWrite((PDEVICE_CONTEXT)Context, Address, (UINT8*)Buffer, Length);
+}
+
+NTSTATUS
+GoodixWrite(
+    _In_ PDEVICE_CONTEXT pDevice, 
+    _In_ UINT32 addr, 
+    _In_ UINT8* writeBuf, 
+    _In_ UINT32 writeLen
+)
+{
+    NTSTATUS status;
+    UINT8* SpbBuf;
+    BOOLEAN fromPool = FALSE;
+
+    if (writeLen == 0 || writeBuf == NULL)
+        return STATUS_INVALID_PARAMETER;
+
+    WdfWaitLockAcquire(pDevice->SpbLock, NULL);
+
+    SpbBuf = pDevice->SpbArena->TxBuffer;
+
+    if (writeLen + GOODIX_ADDR_LEN > sizeof(pDevice->SpbArena->TxBuffer))
+    {
+        SpbBuf = (UINT8*)ExAllocatePool2(
+            POOL_FLAG_NON_PAGED,
+            writeLen + GOODIX_ADDR_LEN,
+            TOUCH_POOL_TAG
+        );
+        if (SpbBuf == NULL)
+        {
+            WdfWaitLockRelease(pDevice->SpbLock);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        InterlockedIncrement(&pDevice->SpbPoolAllocations);
+        fromPool = TRUE;
+    }
+
+    SpbBuf[0] = (addr >> 8) & 0xFF;
+    SpbBuf[1] = addr & 0xFF;
+    RtlCopyMemory(&SpbBuf[GOODIX_ADDR_LEN], writeBuf, writeLen);
+
+    status = SpbDeviceWrite(pDevice, SpbBuf, writeLen + GOODIX_ADDR_LEN);
+
+    if (fromPool)
+        ExFreePoolWithTag(SpbBuf, TOUCH_POOL_TAG);
+
+    WdfWaitLockRelease(pDevice->SpbLock);
+    return status;
+}
+
+NTSTATUS
+SpbRequestPoolCreate(
+    _In_ PDEVICE_CONTEXT pDevice
+)
+/*++
+
+  Routine Description:
+
+    Creates the SPB request pool against the current SPB target: one
+    request for synchronous register access and one per asynchronous
+    frame read slot. Called from OnPrepareHardware once the target is open.
+
+  Arguments:
+
+    pDevice - the device context
+
+  Return Value:
+
+    NTSTATUS
+
+--*/
+{
+    NTSTATUS                status = STATUS_SUCCESS;
+    WDF_OBJECT_ATTRIBUTES   attributes;
+
+    KeQueryPerformanceCounter(&pDevice->PerfFrequency);
+
+    pDevice->AsyncDepth = min(SpbAsyncDepth, SPB_ASYNC_MAX_DEPTH);
+    pDevice->AsyncInFlight = 0;
+    pDevice->AsyncSubmitted = 0;
+    pDevice->AsyncRetired = 0;
+    KeInitializeEvent(&pDevice->AsyncSlotFreed, SynchronizationEvent, FALSE);
+
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = pDevice->Device;
+
+    status = WdfRequestCreate(&attributes,
+                              pDevice->SpbController,
+                              &pDevice->SpbSyncRequest);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    //
+    // The buffer is reassigned before every send; the arena only gives the
+    // memory object something valid to describe until then.
+    //
+    WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+    attributes.ParentObject = pDevice->SpbSyncRequest;
+
+    status = WdfMemoryCreatePreallocated(&attributes,
+                                         pDevice->SpbArena->TxBuffer,
+                                         sizeof(pDevice->SpbArena->TxBuffer),
+                                         &pDevice->SpbSyncMemory);
+    if (!NT_SUCCESS(status)) {
+        SpbRequestPoolRelease(pDevice);
+        return status;
+    }
+
+    for (ULONG i = 0; i < pDevice->AsyncDepth; i++)
+    {
+        PSPB_ASYNC_SLOT slot = &pDevice->AsyncSlots[i];
+
+        RtlZeroMemory(slot, sizeof(SPB_ASYNC_SLOT));
+        slot->Device = pDevice;
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = pDevice->Device;
+
+        status = WdfRequestCreate(&attributes,
+                                  pDevice->SpbController,
+                                  &slot->Request);
+        if (!NT_SUCCESS(status)) {
+            break;
+        }
+
+        WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+        attributes.ParentObject = slot->Request;
+
+        status = WdfMemoryCreatePreallocated(&attributes,
+                                             &slot->Sequence.Entries,
+                                             sizeof(slot->Sequence.Entries),
+                                             &slot->SequenceMemory);
+        if (!NT_SUCCESS(status)) {
+            break;
+        }
+    }
+
+    if (!NT_SUCCESS(status)) {
+        SpbRequestPoolRelease(pDevice);
+    }
+
+    return status;
+}
+
+VOID
+SpbRequestPoolRelease(
+    _In_ PDEVICE_CONTEXT pDevice
+)
+/*++
+
+  Routine Description:
+
+    Deletes the SPB request pool. The SPB target must already be closed so
+    that no request is still in flight.
+
+  Arguments:
+
+    pDevice - the device context
+
+--*/
+{
+    if (pDevice->SpbSyncRequest != NULL)
+    {
+        WdfObjectDelete(pDevice->SpbSyncRequest);
+        pDevice->SpbSyncRequest = NULL;
+        pDevice->SpbSyncMemory = NULL;
+    }
+
+    for (ULONG i = 0; i < SPB_ASYNC_MAX_DEPTH; i++)
+    {
+        PSPB_ASYNC_SLOT slot = &pDevice->AsyncSlots[i];
+
+        if (slot->Request != NULL)
+        {
+            WdfObjectDelete(slot->Request);
+            slot->Request = NULL;
+            slot->SequenceMemory = NULL;
+        }
+    }
+
+    pDevice->AsyncDepth = 0;
+}
+
+NTSTATUS
+SpbAsyncSend(
+    _In_ PSPB_ASYNC_SLOT slot
+)
+{
+    PDEVICE_CONTEXT pDevice = slot->Device;
+    WDF_REQUEST_REUSE_PARAMS reuseParams;
+    NTSTATUS status;
+
+    WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+    WdfRequestReuse(slot->Request, &reuseParams);
+
+    SPB_TRANSFER_LIST_INIT(&(slot->Sequence.Entries.List), slot->Sequence.Count);
+
+    status = WdfIoTargetFormatRequestForIoctl(pDevice->SpbController,
+                                              slot->Request,
+                                              IOCTL_SPB_EXECUTE_SEQUENCE,
+                                              slot->SequenceMemory,
+                                              NULL,
+                                              NULL,
+                                              NULL);
+    if (!NT_SUCCESS(status)) {
+        return status;
+    }
+
+    WdfRequestSetCompletionRoutine(slot->Request, SpbAsyncCompletion, slot);
+
+    KeQueryPerformanceCounter(&slot->SubmitTime);
+    InterlockedIncrement(&pDevice->BusOperations);
+    InterlockedExchangeAdd64(&pDevice->BusBytes, slot->Sequence.Bytes);
+
+    if (WdfRequestSend(slot->Request, pDevice->SpbController, WDF_NO_SEND_OPTIONS) == FALSE) {
+        return WdfRequestGetStatus(slot->Request);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+NTSTATUS
+SpbAsyncSubmitFrameRead(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ LONGLONG interruptTime
+)
+/*++
+
+  Routine Description:
+
+    Sends the status/point read, fused with the status clear when frames
+    carry no checksum, on a free slot without waiting for it to complete. When every slot is in flight the
+    caller waits for one to be retired rather than reading the frame
+    synchronously, which would overtake the frames still in flight.
+
+  Arguments:
+
+    pDevice - the device context
+    interruptTime - performance counter value of the interrupt, carried
+        with the frame to the report it produces
+
+  Return Value:
+
+    STATUS_DEVICE_BUSY if no slot was retired within SPB_ASYNC_SLOT_WAIT_MS,
+    otherwise the status of sending the request. On failure the frame is
+    neither read nor cleared.
+
+--*/
+{
+    NTSTATUS status;
+    PSPB_ASYNC_SLOT slot = NULL;
+    LARGE_INTEGER timeout;
+    BOOLEAN stalled = FALSE;
+
+    timeout.QuadPart = WDF_REL_TIMEOUT_IN_MS(SPB_ASYNC_SLOT_WAIT_MS);
+
+    for (;;)
+    {
+        for (ULONG i = 0; i < pDevice->AsyncDepth; i++)
+        {
+            if (InterlockedCompareExchange(&pDevice->AsyncSlots[i].InUse, 1, 0) == 0)
+            {
+                slot = &pDevice->AsyncSlots[i];
+                break;
+            }
+        }
+
+        if (slot != NULL)
+            break;
+
+        if (!stalled)
+        {
+            InterlockedIncrement(&pDevice->AsyncStalls);
+            stalled = TRUE;
+        }
+
+        status = KeWaitForSingleObject(&pDevice->AsyncSlotFreed, Executive, KernelMode, FALSE, &timeout);
+        if (status == STATUS_TIMEOUT)
+            return STATUS_DEVICE_BUSY;
+    }
+
+    slot->Stage = SPB_ASYNC_STAGE_READ;
+    slot->Cleared = FALSE;
+    slot->Done = FALSE;
+    slot->Process = FALSE;
+    slot->Fetched = pDevice->BurstPointCount;
+    slot->Count = 0;
+    slot->FrameStatus = STATUS_SUCCESS;
+    slot->InterruptTime = interruptTime;
+    RtlZeroMemory(slot->FrameBuffer, sizeof(slot->FrameBuffer));
+
+    slot->TxBuffer[0] = (TOUCH_INFO_ADDR >> 8) & 0xFF;
+    slot->TxBuffer[1] = TOUCH_INFO_ADDR & 0xFF;
+    slot->ClearBuffer[0] = (TOUCH_INFO_ADDR >> 8) & 0xFF;
+    slot->ClearBuffer[1] = TOUCH_INFO_ADDR & 0xFF;
+    slot->ClearBuffer[2] = 0;
+
+    SpbSequenceInit(&slot->Sequence);
+    SpbSequenceAdd(&slot->Sequence, SpbTransferDirectionToDevice, slot->TxBuffer, GOODIX_ADDR_LEN);
+    SpbSequenceAdd(&slot->Sequence,
+                   SpbTransferDirectionFromDevice,
+                   slot->FrameBuffer,
+                   1 + slot->Fetched * BYTES_PER_COORD + (FrameChecksum ? BYTES_CHKSUM : 0));
+
+    //
+    // As in GoodixReadFrameFrom, the clear is only fused with the read
+    // without checksum; otherwise it goes out once the frame is checked.
+    //
+    if (!FrameChecksum)
+        SpbSequenceAdd(&slot->Sequence, SpbTransferDirectionToDevice, slot->ClearBuffer, sizeof(slot->ClearBuffer));
+
+    //
+    // Only the interrupt thread submits, so the order numbers are handed
+    // out in the order the frames were signalled.
+    //
+    slot->Order = (ULONG)InterlockedIncrement(&pDevice->AsyncSubmitted);
+    InterlockedIncrement(&pDevice->AsyncInFlight);
+
+    status = SpbAsyncSend(slot);
+    if (!NT_SUCCESS(status))
+    {
+        slot->FrameStatus = status;
+        SpbAsyncRetire(slot);
+    }
+
+    return status;
+}
+
+VOID
+SpbAsyncCompletion(
+    _In_ WDFREQUEST Request,
+    _In_ WDFIOTARGET Target,
+    _In_ PWDF_REQUEST_COMPLETION_PARAMS Params,
+    _In_ WDFCONTEXT Context
+)
+/*++
 
-Return Value:
+  Routine Description:
 
-    VOID
+    Completion routine for asynchronous frame reads. Records the status and
+    latency of the transaction and moves the slot through the steps of
+    GoodixReadFrameFrom, one transaction at a time: a top-up read when more
+    contacts were reported than fetched, a single re-read when the frame
+    fails its checksum, and then the clear when it was not fused with the
+    read. A failed transaction may have left the status byte set, so the
+    clear is also sent on its own then. The frame is handed to
+    SpbAsyncRetire, which processes frames in the order they were
+    submitted.
 
 --*/
 {
-    NTSTATUS                status;
-    WDFQUEUE                queue;
-    PMANUAL_QUEUE_CONTEXT   queueContext;
-    WDFREQUEST              request;
-    HIDMINI_INPUT_REPORT    readReport;
+    PSPB_ASYNC_SLOT slot = (PSPB_ASYNC_SLOT)Context;
+    PDEVICE_CONTEXT pDevice = slot->Device;
+    NTSTATUS status = Params->IoStatus.Status;
+    LARGE_INTEGER now;
+    ULONG latencyUs;
+    UINT8 count;
 
-    queue = (WDFQUEUE)WdfTimerGetParentObject(Timer);
-    queueContext = GetManualQueueContext(queue);
+    UNREFERENCED_PARAMETER(Request);
+    UNREFERENCED_PARAMETER(Target);
 
-    //
-    // see if we have a request in manual queue
-    //
-    status = WdfIoQueueRetrieveNextRequest(
-                            queueContext->Queue,
-                            &request);
+    now = KeQueryPerformanceCounter(NULL);
+    latencyUs = (ULONG)(((now.QuadPart - slot->SubmitTime.QuadPart) * 1000000) /
+                        pDevice->PerfFrequency.QuadPart);
 
-    if (NT_SUCCESS(status)) {
+    pDevice->LastAsyncStatus = status;
+    pDevice->LastAsyncLatencyUs = latencyUs;
+    CounterRaiseMax(&pDevice->MaxAsyncLatencyUs, latencyUs);
 
-        readReport.ReportId = CONTROL_FEATURE_REPORT_ID;
-        readReport.Data     = queueContext->DeviceContext->DeviceData;
+    if (!NT_SUCCESS(status))
+    {
+        InterlockedIncrement(&pDevice->AsyncFailed);
+        if (NT_SUCCESS(slot->FrameStatus))
+            slot->FrameStatus = status;
+        if (slot->Stage == SPB_ASYNC_STAGE_CLEAR)
+            goto retire;
+        goto clear;
+    }
 
-        status = RequestCopyFromBuffer(request,
-                            &readReport,
-                            sizeof(readReport));
+    InterlockedIncrement(&pDevice->AsyncCompleted);
 
-        WdfRequestComplete(request, status);
+    if (slot->Stage == SPB_ASYNC_STAGE_CLEAR)
+    {
+        slot->Cleared = TRUE;
+        if (NT_SUCCESS(slot->FrameStatus) && !pDevice->OnClose &&
+            (slot->FrameBuffer[0] & 0xF0) == GOODIX_TOUCH_EVENT)
+        {
+            pDevice->BurstPointCount = max(slot->Count, 1);
+            slot->Process = TRUE;
+        }
+        goto retire;
     }
-}
 
-BOOLEAN
-OnInterruptIsr(
-    _In_  WDFINTERRUPT FxInterrupt,
-    _In_  ULONG        MessageID
-)
-/*++
+    if (slot->Stage == SPB_ASYNC_STAGE_READ)
+    {
+        slot->Cleared = !FrameChecksum;
 
-  Routine Description:
+        if (pDevice->OnClose)
+            goto retire;
 
-    This routine responds to interrupts generated by the H/W.
-    It then waits indefinitely for the user to signal that
-    the interrupt has been acknowledged, allowing the ISR to
-    return. This ISR is called at PASSIVE_LEVEL.
+        if ((slot->FrameBuffer[0] & 0xF0) != GOODIX_TOUCH_EVENT)
+        {
+            InterlockedIncrement(&pDevice->NonTouchFrames);
+            goto clear;
+        }
 
-  Arguments:
+        count = min(slot->FrameBuffer[0] & GOODIX_TOUCH_COUNT_MASK, MAX_POINT_NUM);
+        slot->Count = count;
 
-    Interrupt - a handle to a framework interrupt object
-    MessageID - message number identifying the device's
-        hardware interrupt message (if using MSI)
+        if (count > slot->Fetched && slot->Cleared)
+        {
+            //
+            // The records may already belong to the next frame; drop this
+            // one and fetch enough for the next.
+            //
+            InterlockedIncrement(&pDevice->BurstShortFrames);
+            pDevice->BurstPointCount = count;
+            slot->FrameStatus = STATUS_DEVICE_DATA_ERROR;
+            slot->Count = 0;
+            goto retire;
+        }
 
-  Return Value:
+        if (count > slot->Fetched)
+        {
+            InterlockedIncrement(&pDevice->BurstTopUpReads);
 
-    TRUE if interrupt recognized.
+            slot->Stage = SPB_ASYNC_STAGE_TOP_UP;
+            slot->TxBuffer[0] = ((TOUCH_INFO_ADDR + 1 + slot->Fetched * BYTES_PER_COORD) >> 8) & 0xFF;
+            slot->TxBuffer[1] = (TOUCH_INFO_ADDR + 1 + slot->Fetched * BYTES_PER_COORD) & 0xFF;
 
---*/
-{
-    BOOLEAN           fInterruptRecognized = TRUE;
-    WDFDEVICE         device;
-    PDEVICE_CONTEXT   pDevice;
-    NTSTATUS          status;
-    WDFREQUEST        request;
-    inputReport54_t   readReport = { 0 };
-    UINT8 touchInfo = 0;
-    UINT8 touchBuf[10 + MAX_POINT_NUM * BYTES_PER_COORD] = { 0 };
-    UINT8 touchEvtClear = 0;
-    UINT8 touchCount;
+            SpbSequenceInit(&slot->Sequence);
+            SpbSequenceAdd(&slot->Sequence, SpbTransferDirectionToDevice, slot->TxBuffer, GOODIX_ADDR_LEN);
+            SpbSequenceAdd(&slot->Sequence,
+                           SpbTransferDirectionFromDevice,
+                           &slot->FrameBuffer[1 + slot->Fetched * BYTES_PER_COORD],
+                           (count - slot->Fetched) * BYTES_PER_COORD + BYTES_CHKSUM);
 
-    UINT8 touchId = 0;
-    UINT16 x = 0, y = 0;
-    UNREFERENCED_PARAMETER(MessageID);
+            status = SpbAsyncSend(slot);
+            if (NT_SUCCESS(status))
+                return;
 
-    device = WdfInterruptGetDevice(FxInterrupt);
+            InterlockedIncrement(&pDevice->AsyncFailed);
+            slot->FrameStatus = status;
+            slot->Count = slot->Fetched;
+            goto clear;
+        }
+    }
 
-    pDevice = GetDeviceContext(device);
     if (pDevice->OnClose)
-        return TRUE;
-
-    RtlZeroMemory(touchBuf, sizeof(touchBuf));
+        goto retire;
 
-    GoodixRead(pDevice, TOUCH_INFO_ADDR, &touchInfo, sizeof(touchInfo));
+    count = slot->Count;
 
-    // touchBuf[0] EventID
-    switch (touchInfo & 0xF0)
+    //
+    // The status byte is still set when frames carry a checksum, so the
+    // controller cannot have replaced the records under the check.
+    //
+    if (FrameChecksum && !GoodixFrameValid(slot->FrameBuffer, count))
     {
-    case GOODIX_TOUCH_EVENT:
-        break;
-    default:
-        goto exit;
-    }
+        if (slot->Stage == SPB_ASYNC_STAGE_REREAD)
+        {
+            InterlockedIncrement(&pDevice->CorruptFrames);
+            slot->FrameStatus = STATUS_CRC_ERROR;
+            goto clear;
+        }
 
-    touchCount = touchInfo & 0x0F;
+        InterlockedIncrement(&pDevice->FrameRereads);
 
-    readReport.DIG_TouchScreenContactCount = touchCount;
+        slot->Stage = SPB_ASYNC_STAGE_REREAD;
+        slot->TxBuffer[0] = ((TOUCH_INFO_ADDR + 1) >> 8) & 0xFF;
+        slot->TxBuffer[1] = (TOUCH_INFO_ADDR + 1) & 0xFF;
 
-    if (touchCount)
-    GoodixRead(pDevice, TOUCH_INFO_ADDR + 1, touchBuf, 8 + BYTES_PER_COORD * (touchCount - 1));
+        SpbSequenceInit(&slot->Sequence);
+        SpbSequenceAdd(&slot->Sequence, SpbTransferDirectionToDevice, slot->TxBuffer, GOODIX_ADDR_LEN);
+        SpbSequenceAdd(&slot->Sequence,
+                       SpbTransferDirectionFromDevice,
+                       &slot->FrameBuffer[1],
+                       count * BYTES_PER_COORD + BYTES_CHKSUM);
 
-    switch(touchCount)
-    {
-    case 0:
-        // All points leave
-        readReport.points[0] = 0x06;
-        readReport.points[1] = pDevice->LastTouchID;
-        readReport.DIG_TouchScreenContactCount = 1;
-#ifdef DEBUG
-        TraceEvents(TRACE_LEVEL_WARNING, TRACE_DEVICE, "Point Leave X:%d, Y:%d", x, y);
-#endif
-        break;
+        status = SpbAsyncSend(slot);
+        if (NT_SUCCESS(status))
+            return;
 
-    default:
-        for (UINT8 i = 0; i < touchCount; i++)
-        {
-            touchId = (touchBuf[0 + i * 8] & 0x0F);
-            x = (touchBuf[2 + i * 8] << 8) | touchBuf[1 + i * 8];
-            y = (UINT16)YMax - ((touchBuf[4 + i * 8] << 8) | touchBuf[3 + i * 8]);
-            readReport.points[i * 6 + 0] = 0x07;  // In Point
-            readReport.points[i * 6 + 1] = touchId;
-            readReport.points[i * 6 + 2] = x & 0xFF;
-            readReport.points[i * 6 + 3] = (x >> 8) & 0x0F;
-            readReport.points[i * 6 + 4] = y & 0xFF;
-            readReport.points[i * 6 + 5] = (y >> 8) & 0x0F;
-#ifdef DEBUG
-            TraceEvents(TRACE_LEVEL_WARNING, TRACE_DEVICE, "Touch %d X:%d, Y:%d", touchId + 1, x, y);
-            TraceEvents(TRACE_LEVEL_WARNING, TRACE_DEVICE, "Touch %d Buffer %x %x %x %x %x %x %x %x", touchId + 1, touchBuf[0 + i * 8], touchBuf[1 + i * 8], touchBuf[2 + i * 8], touchBuf[3 + i * 8], touchBuf[4 + i * 8], touchBuf[5 + i * 8], touchBuf[6 + i * 8], touchBuf[7 + i * 8]);
-#endif
-        }
+        InterlockedIncrement(&pDevice->AsyncFailed);
+        slot->FrameStatus = status;
+        goto clear;
     }
 
-    status = WdfIoQueueRetrieveNextRequest(
-        pDevice->ManualQueue,
-        &request);
+    if (slot->Cleared)
+    {
+        pDevice->BurstPointCount = max(count, 1);
+        slot->Process = TRUE;
+        goto retire;
+    }
 
-    if (NT_SUCCESS(status)) {
+clear:
+    if (!slot->Cleared && !pDevice->OnClose)
+    {
+        slot->Stage = SPB_ASYNC_STAGE_CLEAR;
 
-        readReport.reportId = CONTROL_FEATURE_REPORT_ID;
+        SpbSequenceInit(&slot->Sequence);
+        SpbSequenceAdd(&slot->Sequence, SpbTransferDirectionToDevice, slot->ClearBuffer, sizeof(slot->ClearBuffer));
 
-        status = RequestCopyFromBuffer(request,
-            &readReport,
-            sizeof(readReport));
+        status = SpbAsyncSend(slot);
+        if (NT_SUCCESS(status))
+            return;
 
-        WdfRequestComplete(request, status);
+        InterlockedIncrement(&pDevice->AsyncFailed);
+        if (NT_SUCCESS(slot->FrameStatus))
+            slot->FrameStatus = status;
     }
 
-exit:
-    GoodixWrite(pDevice, TOUCH_INFO_ADDR, &touchEvtClear, 1);
-    return fInterruptRecognized;
+retire:
+    SpbAsyncRetire(slot);
 }
 
 VOID
-GoodixRead(
-    _In_ PDEVICE_CONTEXT pDevice,
-    _In_ UINT32 addr,
-    _In_ UINT8* readBuf,
-    _In_ UINT32 readLen
+SpbAsyncRetire(
+    _In_ PSPB_ASYNC_SLOT slot
 )
-{
-    if (readLen == 0 || readBuf == NULL)
-        return;
-
-    PUINT8 TxBuf = (PUINT8)ExAllocatePool2(
-        POOL_FLAG_NON_PAGED,
-        2,
-        TOUCH_POOL_TAG
-    );
-    PUINT8 RxBuf = (PUINT8)ExAllocatePool2(
-        POOL_FLAG_NON_PAGED,
-        2 + readLen,
-        TOUCH_POOL_TAG
-    );
+/*++
 
-    TxBuf[0] = (addr >> 8) & 0xFF;
-    TxBuf[1] = addr & 0xFF;
+  Routine Description:
 
-    SpbDeviceWriteRead(pDevice, TxBuf, RxBuf, 2, readLen);
+    Marks the slot's frame as finished and processes every finished frame
+    that is next in submission order, then releases those slots. A frame
+    that finished ahead of an older one waits here until the older one is
+    retired, so reports never go out of order.
 
-    RtlCopyMemory(readBuf, RxBuf, readLen);
+  Arguments:
 
-    ExFreePoolWithTag(TxBuf, TOUCH_POOL_TAG);
-    ExFreePoolWithTag(RxBuf, TOUCH_POOL_TAG);
-}
+    slot - the slot whose transactions have all completed
 
-VOID
-GoodixWrite(
-    _In_ PDEVICE_CONTEXT pDevice, 
-    _In_ UINT32 addr, 
-    _In_ UINT8* writeBuf, 
-    _In_ UINT32 writeLen
-)
+--*/
 {
-    if (writeLen == 0 || writeBuf == NULL)
-        return;
+    PDEVICE_CONTEXT pDevice = slot->Device;
+    PSPB_ASYNC_SLOT next;
 
-    UINT8* SpbBuf = (UINT8*)ExAllocatePool2(
-        POOL_FLAG_NON_PAGED,
-        writeLen + 2,
-        TOUCH_POOL_TAG
-    );
+    WdfSpinLockAcquire(pDevice->AsyncOrderLock);
 
-    SpbBuf[0] = (addr >> 8) & 0xFF;
-    SpbBuf[1] = addr & 0xFF;
-    RtlCopyMemory(&SpbBuf[2], writeBuf, writeLen);
+    slot->Done = TRUE;
+
+    for (;;)
+    {
+        next = NULL;
+        for (ULONG i = 0; i < pDevice->AsyncDepth; i++)
+        {
+            if (pDevice->AsyncSlots[i].Done &&
+                pDevice->AsyncSlots[i].Order == pDevice->AsyncRetired + 1)
+            {
+                next = &pDevice->AsyncSlots[i];
+                break;
+            }
+        }
+
+        if (next == NULL)
+            break;
+
+        if (!pDevice->OnClose)
+        {
+            FlightRecorderLog(pDevice, next->InterruptTime, next->FrameStatus, next->FrameBuffer, next->Count);
+            if (NT_SUCCESS(next->FrameStatus))
+                CaptureRingLog(pDevice, next->InterruptTime, next->FrameBuffer, next->Count);
+            if (next->Process)
+                TouchProcessFrame(pDevice, next->FrameBuffer, next->Count, next->InterruptTime);
+        }
 
-    SpbDeviceWrite(pDevice, SpbBuf, writeLen + 2);
+        pDevice->AsyncRetired++;
+        next->Done = FALSE;
+        InterlockedDecrement(&pDevice->AsyncInFlight);
+        InterlockedExchange(&next->InUse, 0);
+        KeSetEvent(&pDevice->AsyncSlotFreed, IO_NO_INCREMENT, FALSE);
+    }
 
-    ExFreePoolWithTag(SpbBuf, TOUCH_POOL_TAG);
+    WdfSpinLockRelease(pDevice->AsyncOrderLock);
 }
 
-VOID 
+NTSTATUS
 SpbDeviceOpen(
     _In_  PDEVICE_CONTEXT  pDevice
 )
@@ -2193,12 +4378,7 @@ SpbDeviceOpen(
         pDevice->SpbController,
         &openParams);
 
-    if (!NT_SUCCESS(status))
-    {
-    }
-
-    //enable interrupt
-    WdfInterruptEnable(pDevice->Interrupt);
+    return status;
 }
 
 VOID
@@ -2210,7 +4390,124 @@ SpbDeviceClose(
     WdfIoTargetClose(pDevice->SpbController);
 }
 
+WDFREQUEST
+SpbSyncRequestPrepare(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _Out_ PWDF_MEMORY_DESCRIPTOR pMemoryDescriptor,
+    _In_ PVOID pBuffer,
+    _In_ size_t bufferLength
+)
+/*++
+
+  Routine Description:
+
+    Recycles the pooled synchronous request and points its memory object
+    at the caller's buffer, so the framework does not have to build a
+    request or memory object for the send. When the pool is unavailable the
+    descriptor falls back to a plain buffer and NULL is returned, letting
+    the framework allocate a request; such sends are counted in
+    FrameworkRequestAllocations. The caller holds SpbLock.
+
+  Arguments:
+
+    pDevice - the device context
+    pMemoryDescriptor - receives the descriptor to pass to the send
+    pBuffer - the buffer to send
+    bufferLength - length of pBuffer in bytes
+
+  Return Value:
+
+    The request to send on, or NULL.
+
+--*/
+{
+    WDF_REQUEST_REUSE_PARAMS reuseParams;
+
+    if (pDevice->SpbSyncRequest != NULL &&
+        NT_SUCCESS(WdfMemoryAssignBuffer(pDevice->SpbSyncMemory, pBuffer, bufferLength)))
+    {
+        WDF_REQUEST_REUSE_PARAMS_INIT(&reuseParams, WDF_REQUEST_REUSE_NO_FLAGS, STATUS_SUCCESS);
+        WdfRequestReuse(pDevice->SpbSyncRequest, &reuseParams);
+
+        WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(pMemoryDescriptor, pDevice->SpbSyncMemory, NULL);
+        InterlockedIncrement(&pDevice->PooledRequestSends);
+        return pDevice->SpbSyncRequest;
+    }
+
+    WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(pMemoryDescriptor, pBuffer, (ULONG)bufferLength);
+    InterlockedIncrement(&pDevice->FrameworkRequestAllocations);
+    return NULL;
+}
+
+VOID
+SpbSequenceInit(
+    _Out_ PSPB_SEQUENCE pSequence
+)
+{
+    RtlZeroMemory(pSequence, sizeof(SPB_SEQUENCE));
+}
+
 VOID
+SpbSequenceAdd(
+    _Inout_ PSPB_SEQUENCE pSequence,
+    _In_ SPB_TRANSFER_DIRECTION direction,
+    _In_ PVOID pBuffer,
+    _In_ size_t bufferLength
+)
+{
+    NT_ASSERT(pSequence->Count < SPB_SEQUENCE_MAX_TRANSFERS);
+
+    pSequence->Entries.List.Transfers[pSequence->Count] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+        direction,
+        0,
+        pBuffer,
+        (ULONG)bufferLength
+    );
+    pSequence->Count++;
+    pSequence->Bytes += (ULONG)bufferLength;
+}
+
+NTSTATUS
+SpbDeviceExecuteSequence(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ PSPB_SEQUENCE pSequence
+)
+{
+    WDF_MEMORY_DESCRIPTOR  memoryDescriptor;
+    WDFREQUEST request;
+    NTSTATUS status;
+
+    SPB_TRANSFER_LIST_INIT(&(pSequence->Entries.List), pSequence->Count);
+
+    request = SpbSyncRequestPrepare(pDevice,
+                                    &memoryDescriptor,
+                                    &pSequence->Entries,
+                                    sizeof(pSequence->Entries));
+
+    InterlockedIncrement(&pDevice->BusOperations);
+    InterlockedExchangeAdd64(&pDevice->BusBytes, pSequence->Bytes);
+
+    status = WdfIoTargetSendIoctlSynchronously(
+        pDevice->SpbController,
+        request,
+        IOCTL_SPB_EXECUTE_SEQUENCE,
+        &memoryDescriptor,
+        NULL,
+        NULL,
+        NULL
+    );
+
+    if (!NT_SUCCESS(status)) {
+        InterlockedIncrement(&pDevice->SpbFailures);
+#ifdef DEBUG
+        Trace(TRACE_LEVEL_ERROR, TRACE_DEVICE, "Failed to send IOCTL, NTSTATUS=0x%08lX", status);
+#endif
+    }
+
+    return status;
+}
+
+NTSTATUS
 SpbDeviceWrite(
     _In_ PDEVICE_CONTEXT pDevice,
     _In_ PVOID pInputBuffer,
@@ -2219,16 +4516,21 @@ SpbDeviceWrite(
 {
     WDF_MEMORY_DESCRIPTOR  inMemoryDescriptor;
     ULONG_PTR  bytesWritten = (ULONG_PTR)NULL;
+    WDFREQUEST request;
     NTSTATUS status;
 
 
-    WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(&inMemoryDescriptor,
-        pInputBuffer,
-        (ULONG)inputBufferLength);
+    request = SpbSyncRequestPrepare(pDevice,
+                                    &inMemoryDescriptor,
+                                    pInputBuffer,
+                                    inputBufferLength);
+
+    InterlockedIncrement(&pDevice->BusOperations);
+    InterlockedExchangeAdd64(&pDevice->BusBytes, (LONG64)inputBufferLength);
 
     status = WdfIoTargetSendWriteSynchronously(
         pDevice->SpbController,
-        NULL,
+        request,
         &inMemoryDescriptor,
         NULL,
         NULL,
@@ -2237,11 +4539,13 @@ SpbDeviceWrite(
 
     if (!NT_SUCCESS(status))
     {
+        InterlockedIncrement(&pDevice->SpbFailures);
     }
 
+    return status;
 }
 
-VOID
+NTSTATUS
 SpbDeviceWriteRead(
     _In_ PDEVICE_CONTEXT pDevice,
     _In_ PVOID pInputBuffer,
@@ -2250,49 +4554,13 @@ SpbDeviceWriteRead(
     _In_ size_t outputBufferLength
 )
 {
-    WDF_MEMORY_DESCRIPTOR  memoryDescriptor;
-    NTSTATUS status;
-
-    SPB_TRANSFER_LIST_AND_ENTRIES(2) seq;
-    SPB_TRANSFER_LIST_INIT(&(seq.List), 2);
-
-    {
-        ULONG index = 0;
-        seq.List.Transfers[index] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
-            SpbTransferDirectionToDevice,
-            0,
-            pInputBuffer,
-            (ULONG)inputBufferLength
-        );
-        seq.List.Transfers[index + 1] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
-            SpbTransferDirectionFromDevice,
-            0,
-            pOutputBuffer,
-            (ULONG)outputBufferLength
-        );
-    }
-
-    WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
-        &memoryDescriptor,
-        &seq,
-        sizeof(seq)
-    );
+    SPB_SEQUENCE sequence;
 
-    status = WdfIoTargetSendIoctlSynchronously(
-        pDevice->SpbController,
-        NULL,
-        IOCTL_SPB_EXECUTE_SEQUENCE,
-        &memoryDescriptor,
-        NULL,
-        NULL,
-        NULL
-    );
+    SpbSequenceInit(&sequence);
+    SpbSequenceAdd(&sequence, SpbTransferDirectionToDevice, pInputBuffer, inputBufferLength);
+    SpbSequenceAdd(&sequence, SpbTransferDirectionFromDevice, pOutputBuffer, outputBufferLength);
 
-    if (!NT_SUCCESS(status)) {
-#ifdef DEBUG
-        Trace(TRACE_LEVEL_ERROR, TRACE_DEVICE, "Failed to send IOCTL, NTSTATUS=0x%08lX", status);
-#endif
-    }
+    return SpbDeviceExecuteSequence(pDevice, &sequence);
 }
 
 
@@ -2319,6 +4587,25 @@ Return Value:
     UNICODE_STRING  xMaxName;
     UNICODE_STRING  yMinName;
     UNICODE_STRING  yMaxName;
+    UNICODE_STRING  spbAsyncDepthName;
+    UNICODE_STRING  reportQueueDepthName;
+    UNICODE_STRING  coalesceMotionName;
+    UNICODE_STRING  maxContactsName;
+    UNICODE_STRING  touchUsagesName;
+    UNICODE_STRING  contactsPerReportName;
+    UNICODE_STRING  flightRecorderDepthName;
+    UNICODE_STRING  captureDepthName;
+    UNICODE_STRING  filterMinCutoffName;
+    UNICODE_STRING  filterBetaName;
+    UNICODE_STRING  filterDerivCutoffName;
+    UNICODE_STRING  predictionHorizonName;
+    UNICODE_STRING  frameChecksumName;
+    UNICODE_STRING  controllerConfigName;
+    UNICODE_STRING  idleTimeoutName;
+    UNICODE_STRING  calibrationMatrixName;
+    LONG            calibrationMatrix[ARRAYSIZE(TouchConfig.CalibrationMatrix)];
+    ULONG           valueLength = 0;
+    ULONG           valueType = 0;
     PDEVICE_CONTEXT deviceContext;
     WDF_OBJECT_ATTRIBUTES   attributes;
 
@@ -2339,17 +4626,57 @@ Return Value:
         RtlInitUnicodeString(&xMaxName, L"XMax");
         RtlInitUnicodeString(&yMinName, L"YMin");
         RtlInitUnicodeString(&yMaxName, L"YMax");
+        RtlInitUnicodeString(&spbAsyncDepthName, L"SpbAsyncDepth");
+        RtlInitUnicodeString(&reportQueueDepthName, L"ReportQueueDepth");
+        RtlInitUnicodeString(&coalesceMotionName, L"CoalesceMotion");
+        RtlInitUnicodeString(&maxContactsName, L"MaxContacts");
+        RtlInitUnicodeString(&touchUsagesName, L"TouchUsages");
+        RtlInitUnicodeString(&contactsPerReportName, L"ContactsPerReport");
+        RtlInitUnicodeString(&flightRecorderDepthName, L"FlightRecorderDepth");
+        RtlInitUnicodeString(&captureDepthName, L"CaptureDepth");
+        RtlInitUnicodeString(&filterMinCutoffName, L"FilterMinCutoff");
+        RtlInitUnicodeString(&filterBetaName, L"FilterBeta");
+        RtlInitUnicodeString(&filterDerivCutoffName, L"FilterDerivCutoff");
+        RtlInitUnicodeString(&predictionHorizonName, L"PredictionHorizon");
+        RtlInitUnicodeString(&frameChecksumName, L"FrameChecksum");
+        RtlInitUnicodeString(&controllerConfigName, L"ControllerConfig");
+        RtlInitUnicodeString(&idleTimeoutName, L"IdleTimeout");
+        RtlInitUnicodeString(&calibrationMatrixName, L"CalibrationMatrix");
 
         WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
         attributes.ParentObject = Device;
 
-        status = WdfRegistryQueryULong(hKey, &xRevertName, &XRevert);
-        status = WdfRegistryQueryULong(hKey, &yRevertName, &YRevert);
-        status = WdfRegistryQueryULong(hKey, &xYExchangeName, &XYExchange);
-        status = WdfRegistryQueryULong(hKey, &xMinName, &XMin);
-        status = WdfRegistryQueryULong(hKey, &xMaxName, &XMax);
-        status = WdfRegistryQueryULong(hKey, &yMinName, &YMin);
-        status = WdfRegistryQueryULong(hKey, &yMaxName, &YMax);
+        status = WdfRegistryQueryULong(hKey, &xRevertName, &TouchConfig.XRevert);
+        status = WdfRegistryQueryULong(hKey, &yRevertName, &TouchConfig.YRevert);
+        status = WdfRegistryQueryULong(hKey, &xYExchangeName, &TouchConfig.XYExchange);
+        status = WdfRegistryQueryULong(hKey, &xMinName, &TouchConfig.XMin);
+        status = WdfRegistryQueryULong(hKey, &xMaxName, &TouchConfig.XMax);
+        status = WdfRegistryQueryULong(hKey, &yMinName, &TouchConfig.YMin);
+        status = WdfRegistryQueryULong(hKey, &yMaxName, &TouchConfig.YMax);
+        status = WdfRegistryQueryULong(hKey, &spbAsyncDepthName, &SpbAsyncDepth);
+        status = WdfRegistryQueryULong(hKey, &reportQueueDepthName, &ReportQueueDepth);
+        status = WdfRegistryQueryULong(hKey, &coalesceMotionName, &CoalesceMotion);
+        status = WdfRegistryQueryULong(hKey, &maxContactsName, &TouchConfig.MaxContacts);
+        status = WdfRegistryQueryULong(hKey, &touchUsagesName, &TouchConfig.TouchUsages);
+        status = WdfRegistryQueryULong(hKey, &contactsPerReportName, &TouchConfig.ContactsPerReport);
+        status = WdfRegistryQueryULong(hKey, &flightRecorderDepthName, &FlightRecorderDepth);
+        status = WdfRegistryQueryULong(hKey, &captureDepthName, &CaptureDepth);
+        status = WdfRegistryQueryULong(hKey, &filterMinCutoffName, &TouchConfig.FilterMinCutoff);
+        status = WdfRegistryQueryULong(hKey, &filterBetaName, &TouchConfig.FilterBeta);
+        status = WdfRegistryQueryULong(hKey, &filterDerivCutoffName, &TouchConfig.FilterDerivCutoff);
+        status = WdfRegistryQueryULong(hKey, &predictionHorizonName, &TouchConfig.PredictionHorizon);
+        status = WdfRegistryQueryULong(hKey, &frameChecksumName, &FrameChecksum);
+        status = WdfRegistryQueryULong(hKey, &controllerConfigName, &ControllerConfig);
+        status = WdfRegistryQueryULong(hKey, &idleTimeoutName, &IdleTimeout);
+
+        //
+        // Optional REG_BINARY with six LONGs; see TouchTransformInit.
+        //
+        status = WdfRegistryQueryValue(hKey, &calibrationMatrixName, sizeof(calibrationMatrix),
+                                       calibrationMatrix, &valueLength, &valueType);
+        if (NT_SUCCESS(status) && valueType == REG_BINARY && valueLength == sizeof(calibrationMatrix)) {
+            RtlCopyMemory(TouchConfig.CalibrationMatrix, calibrationMatrix, sizeof(calibrationMatrix));
+        }
 
         WdfRegistryClose(hKey);
     }
@@ -32,17 +32,112 @@ Environment:
 #include <hidport.h>  // located in $(DDK_INC_PATH)/wdm
 
 #include "common.h"
+#include "touchcore.h"
 
 #define RESHUB_USE_HELPER_ROUTINES
 #include "reshub.h"
 
 #define DEFAULT_SPB_BUFFER_SIZE 256
 
-#define TOUCH_INFO_ADDR         0x814E
 #define TOUCH_POOL_TAG          (ULONG)'dooG'
 
+//
+// Scratch buffers for GoodixRead/GoodixWrite. They are carved out once per
+// device so the touch path never touches the pool; transfers that do not fit
+// fall back to a pool allocation that is counted in SpbPoolAllocations.
+//
+typedef struct DECLSPEC_CACHEALIGN _SPB_TRANSFER_ARENA
+{
+    UCHAR                   TxBuffer[GOODIX_ADDR_LEN + DEFAULT_SPB_BUFFER_SIZE];
+    UCHAR                   RxBuffer[DEFAULT_SPB_BUFFER_SIZE];
+    UCHAR                   ClearBuffer[GOODIX_ADDR_LEN + 1];
+} SPB_TRANSFER_ARENA, *PSPB_TRANSFER_ARENA;
+
+//
+// A transfer list for IOCTL_SPB_EXECUTE_SEQUENCE. The controller runs the
+// whole list as one bus transaction, so entries are never interleaved with
+// another client's transfers.
+//
+#define SPB_SEQUENCE_MAX_TRANSFERS  4
+
+typedef struct _SPB_SEQUENCE
+{
+    SPB_TRANSFER_LIST_AND_ENTRIES(SPB_SEQUENCE_MAX_TRANSFERS) Entries;
+    ULONG                   Count;
+    ULONG                   Bytes;
+} SPB_SEQUENCE, *PSPB_SEQUENCE;
+
+C_ASSERT(DEFAULT_SPB_BUFFER_SIZE >= TOUCH_READ_SIZE);
+C_ASSERT(MAX_POINT_NUM <= HIDMINI_MAX_CONTACTS);
+
 typedef UCHAR HID_REPORT_DESCRIPTOR, *PHID_REPORT_DESCRIPTOR;
 
+//
+// Depth of the report ring; see REPORT_RING in touchcore.h.
+//
+#define REPORT_RING_DEFAULT_DEPTH   16
+#define REPORT_RING_MAX_DEPTH       256
+
+#define FEATURE_SELECTION_SLOTS         4
+
+//
+// A data-returning control code selected with SetFeature on the control
+// collection, waiting for the GetFeature that reads it. hidclass passes
+// the caller's IRP down, so the file object and requesting process tell
+// the handles apart; a GetFeature from any other handle, such as the
+// input stack asking for the contact count maximum, is answered with the
+// regular feature report.
+//
+typedef struct _FEATURE_SELECTION
+{
+    PVOID                   FileObject;
+    ULONG                   ProcessId;
+    UCHAR                   ControlCode;        // zero while the slot is free
+    UCHAR                   LatencyStage;
+    ULONG                   FlightSequence;
+    ULONG                   CaptureSequence;
+} FEATURE_SELECTION, *PFEATURE_SELECTION;
+
+//
+// Flight recorder: a fixed ring of compact HIDMINI_FLIGHT_RECORD entries,
+// one per frame read, kept in release builds so the frames leading up to
+// a field issue can be dumped through the control collection. A writer
+// claims a record with one interlocked increment of Next and publishes it
+// by storing its sequence last; a reader accepts a record only if the
+// sequence is the one it expects both before and after copying it.
+//
+#define FLIGHT_RECORDER_DEFAULT_DEPTH   512
+#define FLIGHT_RECORDER_MAX_DEPTH       4096
+
+typedef struct _FLIGHT_RECORDER
+{
+    WDFMEMORY               Memory;
+    PHIDMINI_FLIGHT_RECORD  Records;
+    ULONG                   Mask;
+    volatile LONG           Next;
+} FLIGHT_RECORDER, *PFLIGHT_RECORDER;
+
+//
+// Raw frame capture. Same publication scheme as the flight recorder;
+// frames are only recorded while the host has capture enabled. Readers
+// keep their own position and pass it with each READ, so the ring only
+// remembers where the current capture started.
+//
+#define CAPTURE_RING_DEFAULT_DEPTH      256
+#define CAPTURE_RING_MAX_DEPTH          4096
+
+C_ASSERT(TOUCH_FRAME_SIZE <= HIDMINI_CAPTURE_FRAME_BYTES);
+
+typedef struct _CAPTURE_RING
+{
+    WDFMEMORY               Memory;
+    PHIDMINI_CAPTURE_FRAME  Frames;
+    ULONG                   Mask;
+    volatile LONG           Next;
+    volatile LONG           Enabled;
+    volatile LONG           StartSequence;
+} CAPTURE_RING, *PCAPTURE_RING;
+
 DRIVER_INITIALIZE                   DriverEntry;
 EVT_WDF_DRIVER_DEVICE_ADD           EvtDeviceAdd;
 EVT_WDF_TIMER                       EvtTimerFunc;
@@ -53,6 +148,81 @@ EVT_WDF_DEVICE_RELEASE_HARDWARE      OnReleaseHardware;
 EVT_WDF_DEVICE_D0_ENTRY              OnD0Entry;
 EVT_WDF_DEVICE_D0_EXIT               OnD0Exit;
 
+//
+// Asynchronous frame reads. Each slot owns a preformatted request and the
+// buffers its transfer list points at, so the interrupt thread can hand the
+// read to the SPB controller and return; the frame is decoded and reported
+// from the completion routine. A slot may need a second transaction (top-up,
+// re-read or a resent clear), so slots can finish out of submission order;
+// each slot is numbered when it is submitted and frames are processed
+// strictly in that order by SpbAsyncRetire. The interrupt thread waits up
+// to SPB_ASYNC_SLOT_WAIT_MS for a slot to be retired when all are in flight.
+//
+#define SPB_ASYNC_MAX_DEPTH     2
+#define SPB_ASYNC_SLOT_WAIT_MS  50
+
+#define SPB_ASYNC_STAGE_READ    0
+#define SPB_ASYNC_STAGE_TOP_UP  1
+#define SPB_ASYNC_STAGE_REREAD  2
+#define SPB_ASYNC_STAGE_CLEAR   3
+
+//
+// The synchronous request and the asynchronous slots together form the
+// device's SPB request pool. The pool is created against the SPB target in
+// OnD0Entry, each request is recycled with WdfRequestReuse, and everything
+// is deleted in OnD0Exit.
+//
+
+struct _DEVICE_CONTEXT;
+
+typedef struct _LATENCY_HISTOGRAM
+{
+    volatile LONG           Buckets[HIDMINI_LATENCY_BUCKETS];
+    volatile LONG           Count;
+    volatile LONG           MaxUs;
+    volatile LONG64         SumUs;
+} LATENCY_HISTOGRAM, *PLATENCY_HISTOGRAM;
+
+//
+// Copy of the controller information kept in the device's registry key
+// as ControllerSnapshot, so the configuration block is only read again
+// when the product, firmware or configuration version changes.
+//
+#define CONTROLLER_SNAPSHOT_VERSION 2
+
+typedef struct _CONTROLLER_SNAPSHOT
+{
+    ULONG                   Version;
+    GOODIX_CONTROLLER_INFO  Info;
+} CONTROLLER_SNAPSHOT, *PCONTROLLER_SNAPSHOT;
+
+//
+// Shortest period of the idle governor's timer, in ms.
+//
+#define IDLE_TIMER_MIN_PERIOD       100
+
+typedef struct _SPB_ASYNC_SLOT
+{
+    struct _DEVICE_CONTEXT* Device;
+    WDFREQUEST              Request;
+    WDFMEMORY               SequenceMemory;
+    SPB_SEQUENCE            Sequence;
+    volatile LONG           InUse;
+    ULONG                   Order;
+    UCHAR                   Stage;
+    BOOLEAN                 Cleared;
+    BOOLEAN                 Done;
+    BOOLEAN                 Process;
+    UINT8                   Fetched;
+    UINT8                   Count;
+    NTSTATUS                FrameStatus;
+    LARGE_INTEGER           SubmitTime;
+    LONGLONG                InterruptTime;
+    UCHAR                   TxBuffer[GOODIX_ADDR_LEN];
+    UCHAR                   ClearBuffer[GOODIX_ADDR_LEN + 1];
+    UCHAR                   FrameBuffer[TOUCH_READ_SIZE];
+} SPB_ASYNC_SLOT, *PSPB_ASYNC_SLOT;
+
 typedef struct _DEVICE_CONTEXT
 {
     WDFDEVICE               Device;
@@ -68,7 +238,110 @@ typedef struct _DEVICE_CONTEXT
     WDFINTERRUPT            Interrupt;
     WDFIOTARGET             SpbController;
     BOOLEAN                 OnClose;
-    UINT8                   LastTouchID;
+    TOUCH_TRACKER           Tracker;
+    GOODIX_CONTROLLER_INFO  Controller;
+    TOUCH_FILTER            Filter;
+    TOUCH_PREDICTOR         Predictor;
+    WDFSPINLOCK             TrackerLock;
+
+    WDFWAITLOCK             SpbLock;
+    WDFMEMORY               SpbArenaMemory;
+    PSPB_TRANSFER_ARENA     SpbArena;
+    volatile LONG           SpbPoolAllocations;
+
+    UINT8                   BurstPointCount;
+    volatile LONG           BurstTopUpReads;
+    volatile LONG           BurstShortFrames;
+    volatile LONG           FrameRereads;
+    volatile LONG           CorruptFrames;
+
+    volatile LONG           BusOperations;
+    LONG                    LastFrameBusOps;
+    volatile LONG           MultiOpFrames;
+    volatile LONG64         BusBytes;
+    LONG                    LastFrameBusBytes;
+    volatile LONG           SpbFailures;
+
+    WDFREQUEST              SpbSyncRequest;
+    WDFMEMORY               SpbSyncMemory;
+    volatile LONG           PooledRequestSends;
+    volatile LONG           FrameworkRequestAllocations;
+
+    WDFMEMORY               ReportRingMemory;
+    REPORT_RING             ReportRing;
+    FLIGHT_RECORDER         FlightRecorder;
+    CAPTURE_RING            CaptureRing;
+
+    SPB_ASYNC_SLOT          AsyncSlots[SPB_ASYNC_MAX_DEPTH];
+    ULONG                   AsyncDepth;
+    WDFSPINLOCK             AsyncOrderLock;
+    volatile LONG           AsyncSubmitted;
+    ULONG                   AsyncRetired;
+    KEVENT                  AsyncSlotFreed;
+    LARGE_INTEGER           PerfFrequency;
+    volatile LONG           AsyncInFlight;
+    volatile LONG           AsyncCompleted;
+    volatile LONG           AsyncFailed;
+    volatile LONG           AsyncStalls;
+    NTSTATUS                LastAsyncStatus;
+    ULONG                   LastAsyncLatencyUs;
+    volatile LONG           MaxAsyncLatencyUs;
+
+    LONGLONG                ResumeTime;
+    volatile LONG           ResumeReportPending;
+    volatile LONG           Resumes;
+    ULONG                   ResumeArmUs;
+    ULONG                   ResumeReportUs;
+
+    WDFTIMER                IdleTimer;
+    ULONG                   IdleTimerPeriod;
+    LONGLONG                LastActivity;
+    volatile LONG           Dozing;
+    volatile LONG           DozeEntries;
+    volatile LONG           DozeExits;
+    LONGLONG                WakeTime;
+    volatile LONG           WakeReportPending;
+    ULONG                   WakeReportUs;
+    ULONG                   MaxWakeReportUs;
+
+    TOUCH_TRANSFORM         Transform;
+
+    TOUCH_PROFILE           Profile;
+    UCHAR                   ReportDescriptorBuffer[TOUCH_REPORT_DESCRIPTOR_MAX_SIZE];
+
+    //
+    // Hybrid mode: the frame being handed out in pieces, guarded by
+    // HybridLock since reads complete from more than one thread.
+    //
+    WDFSPINLOCK             HybridLock;
+    inputReport54_t         HybridReport;
+    REPORT_TIMES            HybridTimes;
+    UCHAR                   HybridOffset;
+    volatile LONG           HybridPending;
+    volatile LONG           ReportsCompleted;
+    volatile LONG           ReportBytesCopied;
+
+    //
+    // Time spent in each stage of the interrupt-to-report path, indexed by
+    // HIDMINI_LATENCY_STAGE_*. Together with FramesProcessed, BusBytes and
+    // the allocation counters this gives the per-frame cost of the path.
+    //
+    volatile LONG           FramesProcessed;
+    LATENCY_HISTOGRAM       LatencyHistograms[HIDMINI_LATENCY_STAGE_COUNT];
+
+    volatile LONG           Interrupts;
+    volatile LONG           NonTouchFrames;
+    volatile LONG           ContactsReported;
+    volatile LONG           FramesByContacts[HIDMINI_MAX_CONTACTS + 1];
+    volatile LONG           FramesSuppressed;
+
+    //
+    // Control codes selected with SetFeature whose report the next
+    // GetFeature from the same handle returns.
+    //
+    WDFSPINLOCK             FeatureLock;
+    FEATURE_SELECTION       FeatureSelections[FEATURE_SELECTION_SLOTS];
+    ULONG                   FeatureSelectionNext;
 } DEVICE_CONTEXT, *PDEVICE_CONTEXT;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_CONTEXT, GetDeviceContext);
@@ -125,6 +398,58 @@ GetFeature(
     _In_  WDFREQUEST        Request
     );
 
+VOID
+FeatureSelectionInit(
+    _In_  WDFREQUEST        Request,
+    _In_  UCHAR             ControlCode,
+    _Out_ PFEATURE_SELECTION Selection
+    );
+
+VOID
+FeatureSelectionSet(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  PFEATURE_SELECTION Selection
+    );
+
+BOOLEAN
+FeatureSelectionTake(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  ULONG             BufferLength,
+    _Out_ PFEATURE_SELECTION Selection
+    );
+
+NTSTATUS
+GetLatencyFeature(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  HID_XFER_PACKET*  Packet,
+    _In_  UCHAR             Stage
+    );
+
+NTSTATUS
+GetCountersFeature(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  HID_XFER_PACKET*  Packet
+    );
+
+NTSTATUS
+GetFlightRecorderFeature(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  HID_XFER_PACKET*  Packet,
+    _In_  ULONG             Sequence
+    );
+
+NTSTATUS
+GetCaptureFeature(
+    _In_  PDEVICE_CONTEXT   DeviceContext,
+    _In_  WDFREQUEST        Request,
+    _In_  HID_XFER_PACKET*  Packet,
+    _In_  ULONG             Sequence
+    );
+
 NTSTATUS
 SetFeature(
     _In_  PQUEUE_CONTEXT    QueueContext,
@@ -186,7 +511,7 @@ OnInterruptIsr(
     _In_  ULONG        MessageID
 );
 
-VOID
+NTSTATUS
 SpbDeviceOpen(
     _In_  PDEVICE_CONTEXT  pDevice
 );
@@ -195,14 +520,41 @@ SpbDeviceClose(
     _In_  PDEVICE_CONTEXT  pDevice
 );
 
+WDFREQUEST
+SpbSyncRequestPrepare(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _Out_ PWDF_MEMORY_DESCRIPTOR pMemoryDescriptor,
+    _In_ PVOID pBuffer,
+    _In_ size_t bufferLength
+);
+
 VOID
+SpbSequenceInit(
+    _Out_ PSPB_SEQUENCE pSequence
+);
+
+VOID
+SpbSequenceAdd(
+    _Inout_ PSPB_SEQUENCE pSequence,
+    _In_ SPB_TRANSFER_DIRECTION direction,
+    _In_ PVOID pBuffer,
+    _In_ size_t bufferLength
+);
+
+NTSTATUS
+SpbDeviceExecuteSequence(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ PSPB_SEQUENCE pSequence
+);
+
+NTSTATUS
 SpbDeviceWrite(
     _In_ PDEVICE_CONTEXT pDevice,
     _In_ PVOID pInputBuffer,
     _In_ size_t inputBufferLength
 );
 
-VOID
+NTSTATUS
 SpbDeviceWriteRead(
     _In_ PDEVICE_CONTEXT pDevice,
     _In_ PVOID pInputBuffer,
@@ -211,7 +563,176 @@ SpbDeviceWriteRead(
     _In_ size_t outputBufferLength
 );
 
+NTSTATUS
+SpbArenaCreate(
+    _In_ PDEVICE_CONTEXT pDevice
+);
+
+NTSTATUS
+SpbRequestPoolCreate(
+    _In_ PDEVICE_CONTEXT pDevice
+);
+
+VOID
+SpbRequestPoolRelease(
+    _In_ PDEVICE_CONTEXT pDevice
+);
+
+NTSTATUS
+SpbAsyncSend(
+    _In_ PSPB_ASYNC_SLOT slot
+);
+
+NTSTATUS
+SpbAsyncSubmitFrameRead(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ LONGLONG interruptTime
+);
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE SpbAsyncCompletion;
+
 VOID
+SpbAsyncRetire(
+    _In_ PSPB_ASYNC_SLOT slot
+);
+
+NTSTATUS
+ReportRingCreate(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ ULONG depth
+);
+
+
+
+
+NTSTATUS
+FlightRecorderCreate(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ ULONG depth
+);
+
+VOID
+FlightRecorderLog(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ LONGLONG interruptTime,
+    _In_ NTSTATUS spbStatus,
+    _In_reads_(TOUCH_FRAME_SIZE) const UINT8* touchFrame,
+    _In_ UINT8 touchCount
+);
+
+BOOLEAN
+FlightRecorderRead(
+    _In_ PFLIGHT_RECORDER pRecorder,
+    _In_ ULONG sequence,
+    _Out_ PHIDMINI_FLIGHT_RECORD pRecord
+);
+
+NTSTATUS
+CaptureRingCreate(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ ULONG depth
+);
+
+VOID
+CaptureRingLog(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ LONGLONG interruptTime,
+    _In_reads_(TOUCH_FRAME_SIZE) const UINT8* touchFrame,
+    _In_ UINT8 touchCount
+);
+
+BOOLEAN
+CaptureRingRead(
+    _In_ PCAPTURE_RING pRing,
+    _In_ ULONG sequence,
+    _Out_ PHIDMINI_CAPTURE_FRAME pFrame
+);
+
+
+BOOLEAN
+TouchReportDequeueHybrid(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _Out_ inputReport54_t* pReport,
+    _Out_ PREPORT_TIMES pTimes
+);
+
+BOOLEAN
+TouchReportDequeue(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _Out_ inputReport54_t* pReport,
+    _Out_ PREPORT_TIMES pTimes
+);
+
+VOID
+TouchSubmitReport(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ inputReport54_t* pReport,
+    _In_ PREPORT_TIMES pTimes
+);
+
+VOID
+TouchRecordLatency(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ PREPORT_TIMES pTimes
+);
+
+ULONG
+TouchTicksToUs(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ LONGLONG ticks
+);
+
+VOID
+LatencyHistogramAdd(
+    _Inout_ PLATENCY_HISTOGRAM pHistogram,
+    _In_ ULONG latencyUs
+);
+
+VOID
+CounterRaiseMax(
+    _Inout_ volatile LONG* pMax,
+    _In_ ULONG value
+);
+
+VOID
+TouchDeliverReports(
+    _In_ PDEVICE_CONTEXT pDevice
+);
+
+
+
+
+
+
+
+
+
+NTSTATUS
+IdleGovernorCreate(
+    _In_ PDEVICE_CONTEXT pDevice
+);
+
+EVT_WDF_TIMER IdleGovernorTimer;
+
+VOID
+IdleGovernorWake(
+    _In_ PDEVICE_CONTEXT pDevice
+);
+
+VOID
+TouchProcessFrame(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_reads_(TOUCH_FRAME_SIZE) UINT8* touchFrame,
+    _In_ UINT8 touchCount,
+    _In_ LONGLONG interruptTime
+);
+
+VOID
+TouchLiftContacts(
+    _In_ PDEVICE_CONTEXT pDevice
+);
+
+NTSTATUS
 GoodixRead(
     _In_ PDEVICE_CONTEXT pDevice,
     _In_ UINT32 addr,
@@ -219,7 +740,18 @@ GoodixRead(
     _In_ UINT32 readLen
 );
 
-VOID
+NTSTATUS
+GoodixReadFrame(
+    _In_  PDEVICE_CONTEXT pDevice,
+    _Out_writes_(TOUCH_READ_SIZE) UINT8* frameBuf,
+    _Out_ UINT8* touchCount,
+    _Out_ BOOLEAN* cleared
+);
+
+TOUCH_BUS_READ GoodixBusRead;
+TOUCH_BUS_WRITE GoodixBusWrite;
+
+NTSTATUS
 GoodixWrite(
     _In_ PDEVICE_CONTEXT pDevice,
     _In_ UINT32 addr,
@@ -227,6 +759,23 @@ GoodixWrite(
     _In_ UINT32 writeLen
 );
 
+NTSTATUS
+GoodixLoadControllerConfig(
+    _In_ PDEVICE_CONTEXT pDevice
+);
+
+BOOLEAN
+ControllerSnapshotQuery(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _Out_ PGOODIX_CONTROLLER_INFO Info
+);
+
+VOID
+ControllerSnapshotSave(
+    _In_ PDEVICE_CONTEXT pDevice,
+    _In_ PGOODIX_CONTROLLER_INFO Info
+);
+
 NTSTATUS
 ReadDescriptorFromRegistry(
     WDFDEVICE Device
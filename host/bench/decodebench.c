@@ -0,0 +1,83 @@
+/*++
+
+Module Name:
+
+    decodebench.c
+
+Abstract:
+
+    Microbenchmark of point record decoding: ns per frame for
+    GoodixDecodePoints (SSE2/NEON) and GoodixDecodePointsScalar at every
+    contact count from 1 to MAX_POINT_NUM. One JSON line per count:
+
+        {"bench":"decode","contacts":N,"vector_ns":V,"scalar_ns":S}
+
+Environment:
+
+    User mode
+
+--*/
+
+#include <stdlib.h>
+
+#include "touchcore.h"
+#include "hostbench.h"
+
+#define DECODE_BENCH_FRAMES     2000000
+
+typedef VOID DECODE_ROUTINE(const UINT8*, UINT8, UINT8*);
+
+static double
+DecodeBenchRun(
+    _In_ DECODE_ROUTINE* Decode,
+    _In_reads_bytes_(MAX_POINT_NUM * BYTES_PER_COORD) const UINT8* records,
+    _In_ UINT8 count,
+    _In_ ULONG frames
+)
+{
+    UINT8 points[MAX_POINT_NUM * sizeof(inputpoint)];
+    ULONGLONG start;
+
+    start = HostBenchNowNs();
+    for (ULONG i = 0; i < frames; i++)
+    {
+        Decode(records, count, points);
+        HostBenchKeep(points);
+    }
+
+    return (double)(HostBenchNowNs() - start) / frames;
+}
+
+int
+main(int argc, char** argv)
+{
+    UINT8 records[MAX_POINT_NUM * BYTES_PER_COORD];
+    ULONG frames = DECODE_BENCH_FRAMES;
+
+    if (argc > 1)
+        frames = (ULONG)strtoul(argv[1], NULL, 0);
+    if (frames == 0)
+        frames = 1;
+
+    for (ULONG i = 0; i < sizeof(records); i++)
+        records[i] = (UINT8)(i * 37 + 11);
+
+    for (UINT8 count = 1; count <= MAX_POINT_NUM; count++)
+    {
+        double vector;
+        double scalar;
+
+        //
+        // warm up, then measure each decoder
+        //
+        DecodeBenchRun(GoodixDecodePoints, records, count, frames / 10 + 1);
+
+        vector = DecodeBenchRun(GoodixDecodePoints, records, count, frames);
+        scalar = DecodeBenchRun(GoodixDecodePointsScalar, records, count, frames);
+
+        printf("{\"bench\":\"decode\",\"contacts\":%u,\"vector_ns\":%.2f,\"scalar_ns\":%.2f}\n",
+               count, vector, scalar);
+    }
+
+    return 0;
+}
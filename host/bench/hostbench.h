@@ -0,0 +1,54 @@
+/*++
+
+Module Name:
+
+    hostbench.h
+
+Abstract:
+
+    Timing and output helpers shared by the host benchmarks. Results are
+    printed as one JSON object per line so runs can be collected and
+    compared by script.
+
+Environment:
+
+    User mode, POSIX
+
+--*/
+
+#ifndef __HOSTBENCH_H__
+#define __HOSTBENCH_H__
+
+#include <stdio.h>
+#include <time.h>
+
+static inline ULONGLONG
+HostBenchNowNs(VOID)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ULONGLONG)now.tv_sec * 1000000000ULL + (ULONGLONG)now.tv_nsec;
+}
+
+static inline ULONGLONG
+HostBenchCpuNs(VOID)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (ULONGLONG)now.tv_sec * 1000000000ULL + (ULONGLONG)now.tv_nsec;
+}
+
+//
+// Keeps the compiler from discarding a result the benchmark never uses.
+//
+static inline VOID
+HostBenchKeep(
+    _In_ const void* p
+)
+{
+    __asm__ __volatile__("" : : "r"(p) : "memory");
+}
+
+#endif // __HOSTBENCH_H__
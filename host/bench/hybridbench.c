@@ -0,0 +1,142 @@
+/*++
+
+Module Name:
+
+    hybridbench.c
+
+Abstract:
+
+    Measures what a frame costs on the report path in hybrid mode: bytes
+    copied and filled, copy calls, and read completions per frame, for 1
+    to MAX_POINT_NUM contacts and each number of contacts per report. The
+    steps follow the driver: the decoded frame is pushed on the report
+    ring, popped, cut into slices with TouchReportSlice, each slice packed
+    with TouchReportPack and copied into the read buffer. Contacts per
+    report equal to the contact maximum is the non-hybrid baseline.
+
+    Built against touchcore_counted, whose Rtl routines count the bytes
+    they move. One JSON line per combination:
+
+        {"bench":"hybrid","contacts_per_report":R,"contacts":N,
+         "completions":C,"bytes_copied":B,"copies":K,"bytes_filled":F,
+         "ns":T}
+
+    all per frame.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include <stdlib.h>
+
+#include "touchcore.h"
+#include "hostbench.h"
+
+#define HYBRID_BENCH_FRAMES     200000
+#define HYBRID_RING_DEPTH       8
+
+ULONGLONG HostCopyBytes;
+ULONGLONG HostCopyCalls;
+ULONGLONG HostFillBytes;
+
+static VOID
+HybridBenchFrame(
+    _Out_ inputReport54_t* Report,
+    _In_ UCHAR count
+)
+{
+    UINT8 records[MAX_POINT_NUM * BYTES_PER_COORD] = { 0 };
+
+    for (UCHAR i = 0; i < count; i++)
+    {
+        records[i * BYTES_PER_COORD] = i;
+        records[i * BYTES_PER_COORD + 1] = (UINT8)(i * 40);
+        records[i * BYTES_PER_COORD + 3] = (UINT8)(i * 20);
+    }
+
+    RtlZeroMemory(Report, sizeof(inputReport54_t));
+    Report->reportId = TOUCH_REPORT_ID;
+    Report->DIG_TouchScreenContactCount = count;
+    GoodixDecodePoints(records, count, Report->points);
+}
+
+int
+main(int argc, char** argv)
+{
+    REPORT_RING_CELL cells[HYBRID_RING_DEPTH];
+    REPORT_RING ring;
+    TOUCH_CONFIG config = { 0 };
+    TOUCH_PROFILE profile;
+    inputReport54_t decoded;
+    inputReport54_t frame;
+    inputReport54_t slice;
+    REPORT_TIMES times = { 0 };
+    UCHAR packed[sizeof(inputReport54_t)];
+    UCHAR readBuffer[sizeof(inputReport54_t)];
+    ULONG frames = HYBRID_BENCH_FRAMES;
+
+    if (argc > 1)
+        frames = (ULONG)strtoul(argv[1], NULL, 0);
+    if (frames == 0)
+        frames = 1;
+
+    config.MaxContacts = MAX_POINT_NUM;
+    config.TouchUsages = TOUCH_USAGES_DEFAULT;
+
+    ReportRingInit(&ring, cells, ARRAYSIZE(cells));
+
+    for (UCHAR perReport = 1; perReport <= MAX_POINT_NUM; perReport++)
+    {
+        config.ContactsPerReport = perReport;
+        TouchProfileInit(&config, &profile);
+
+        for (UCHAR count = 1; count <= MAX_POINT_NUM; count++)
+        {
+            ULONGLONG completions = 0;
+            ULONGLONG start;
+            ULONGLONG elapsed;
+
+            HybridBenchFrame(&decoded, count);
+
+            HostCopyBytes = 0;
+            HostCopyCalls = 0;
+            HostFillBytes = 0;
+            start = HostBenchNowNs();
+
+            for (ULONG f = 0; f < frames; f++)
+            {
+                UCHAR offset = 0;
+
+                ReportRingPush(&ring, &decoded, &times);
+                ReportRingPop(&ring, &frame, &times);
+
+                do
+                {
+                    ULONG length;
+
+                    offset = TouchReportSlice(&profile, &frame, offset, &slice);
+                    length = TouchReportPack(&profile, &slice, packed);
+                    RtlCopyMemory(readBuffer, packed, length);
+                    HostBenchKeep(readBuffer);
+                    completions++;
+                } while (offset < frame.DIG_TouchScreenContactCount);
+            }
+
+            elapsed = HostBenchNowNs() - start;
+
+            printf("{\"bench\":\"hybrid\",\"contacts_per_report\":%u,\"contacts\":%u,"
+                   "\"completions\":%.2f,\"bytes_copied\":%.1f,\"copies\":%.2f,"
+                   "\"bytes_filled\":%.1f,\"ns\":%.1f}\n",
+                   perReport, count,
+                   (double)completions / frames,
+                   (double)HostCopyBytes / frames,
+                   (double)HostCopyCalls / frames,
+                   (double)HostFillBytes / frames,
+                   (double)elapsed / frames);
+        }
+    }
+
+    return 0;
+}
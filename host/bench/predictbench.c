@@ -0,0 +1,599 @@
+/*++
+
+Module Name:
+
+    predictbench.c
+
+Abstract:
+
+    Replays strokes through the contact predictor and measures how far the
+    reported position is from the finger, as a curve over the prediction
+    horizon. With a total report latency of H milliseconds the finger is
+    where the stroke will be H ms after the frame; the lag error is the
+    distance from there to the position as read, the predicted error the
+    distance to the position TouchPredictPoints reports with a horizon of
+    H. Points go through GoodixDecodePoints and TouchTransformPoints as in
+    TouchProcessFrame; the jitter filter is left off, as it is by default.
+
+    Two kinds of stroke are replayed:
+
+        synthetic - straight swipes, flings that speed up and slow down,
+                    circles and zigzags, one contact, 500 ms each with
+                    100 ms lifts between them, at 60, 120 and 240 Hz.
+                    Every stroke starts at a new place and direction and
+                    samples carry up to PREDICT_BENCH_NOISE pixels of
+                    noise, all from a fixed seed, so a run reproduces
+                    exactly. The finger position is the noise-free path.
+        recorded  - each capture file named on the command line (see
+                    touchcapture.h), mapped and decoded a frame at a
+                    time as it is needed. The finger position is the
+                    recorded one, interpolated between the frames around
+                    the time it is needed, as long as the contact stays
+                    down.
+
+    One JSON line per stroke set, rate and horizon:
+
+        {"bench":"predict","stream":S,"rate_hz":R,"horizon_ms":H,
+         "samples":N,"lag_mean_px":A,"lag_p95_px":B,
+         "predicted_mean_px":C,"predicted_p95_px":D,"predicted_max_px":E}
+
+    Errors are in panel pixels of the default 1080 x 2160 panel. Samples
+    whose finger position would fall after the contact lifts are left
+    out.
+
+    Usage: predictbench [synthetic strokes per kind] [capture file ...]
+
+Environment:
+
+    User mode
+
+--*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "capturefile.h"
+
+#define PREDICT_BENCH_STROKES       40
+#define PREDICT_BENCH_FREQUENCY     10000000LL      // timestamp ticks per second
+#define PREDICT_BENCH_STROKE_S      0.5
+#define PREDICT_BENCH_PERIOD_S      0.6             // stroke plus lift
+#define PREDICT_BENCH_NOISE         2               // pixels either way
+#define PREDICT_BENCH_X_RESOLUTION  1080
+#define PREDICT_BENCH_Y_RESOLUTION  2160
+#define PREDICT_BENCH_PI            3.14159265358979323846
+
+static const ULONG PredictBenchRates[] = { 60, 120, 240 };
+static const ULONG PredictBenchHorizons[] = { 4, 8, 12, 16, 24, 32, 48 };
+
+typedef enum _PREDICT_BENCH_KIND
+{
+    PredictBenchLine,
+    PredictBenchFling,
+    PredictBenchCircle,
+    PredictBenchZigzag,
+    PredictBenchCapture,
+} PREDICT_BENCH_KIND;
+
+static const char* const PredictBenchKindNames[] = { "line", "fling", "circle", "zigzag" };
+
+//
+// Where and which way a synthetic stroke goes.
+//
+typedef struct _PREDICT_BENCH_STROKE
+{
+    double                  X;
+    double                  Y;
+    double                  Angle;
+} PREDICT_BENCH_STROKE;
+
+//
+// Synthetic streams are generated into Frames; captures are decoded from
+// the mapped file on demand.
+//
+typedef struct _PREDICT_BENCH_STREAM
+{
+    const char*             Name;
+    PREDICT_BENCH_KIND      Kind;
+    double                  Rate;
+    LONGLONG                Frequency;
+    TOUCH_CAPTURE_FRAME*    Frames;
+    CAPTURE_MAP             Map;
+    ULONG                   FrameCount;
+    PREDICT_BENCH_STROKE*   Strokes;
+    ULONG                   StrokeCount;
+} PREDICT_BENCH_STREAM, *PPREDICT_BENCH_STREAM;
+
+static ULONG64 PredictBenchSeed;
+
+static double
+PredictBenchRandom(VOID)
+{
+    PredictBenchSeed ^= PredictBenchSeed << 13;
+    PredictBenchSeed ^= PredictBenchSeed >> 7;
+    PredictBenchSeed ^= PredictBenchSeed << 17;
+    return (double)(PredictBenchSeed >> 11) / (double)(1ULL << 53);
+}
+
+//
+// Noise-free position of a synthetic stroke Tau seconds after touch-down.
+//
+static VOID
+PredictBenchPath(
+    _In_ PREDICT_BENCH_KIND Kind,
+    _In_ const PREDICT_BENCH_STROKE* Stroke,
+    _In_ double Tau,
+    _Out_ double* X,
+    _Out_ double* Y
+)
+{
+    double ux = cos(Stroke->Angle);
+    double uy = sin(Stroke->Angle);
+    double along = 0.0;
+    double across = 0.0;
+
+    switch (Kind)
+    {
+    case PredictBenchLine:
+        along = 1500.0 * Tau - 375.0;
+        break;
+
+    case PredictBenchFling:
+        //
+        // 16000 px/s^2 up to 4000 px/s at the midpoint, then back down
+        //
+        if (Tau < 0.25)
+            along = 8000.0 * Tau * Tau;
+        else
+            along = 500.0 + 4000.0 * (Tau - 0.25) - 8000.0 * (Tau - 0.25) * (Tau - 0.25);
+        along -= 500.0;
+        break;
+
+    case PredictBenchCircle:
+        *X = Stroke->X + 250.0 * cos(Stroke->Angle + 2.0 * PREDICT_BENCH_PI * 1.5 * Tau);
+        *Y = Stroke->Y + 250.0 * sin(Stroke->Angle + 2.0 * PREDICT_BENCH_PI * 1.5 * Tau);
+        return;
+
+    default:
+        //
+        // 800 px/s forward, 150 px triangle wave sideways at 4 Hz
+        //
+        along = 800.0 * Tau - 200.0;
+        across = fmod(Tau * 4.0, 1.0);
+        across = 150.0 * (across < 0.5 ? 4.0 * across - 1.0 : 3.0 - 4.0 * across);
+        break;
+    }
+
+    *X = Stroke->X + along * ux - across * uy;
+    *Y = Stroke->Y + along * uy + across * ux;
+}
+
+static VOID
+PredictBenchRecord(
+    _Out_writes_bytes_(BYTES_PER_COORD) UINT8* Record,
+    _In_ UINT8 Id,
+    _In_ LONG X,
+    _In_ LONG Y
+)
+{
+    X = min(max(X, 0), PREDICT_BENCH_X_RESOLUTION);
+    Y = min(max(Y, 0), PREDICT_BENCH_Y_RESOLUTION);
+
+    Record[0] = Id;
+    Record[1] = (UINT8)X;
+    Record[2] = (UINT8)(X >> 8);
+    Record[3] = (UINT8)Y;
+    Record[4] = (UINT8)(Y >> 8);
+    Record[5] = 30;
+    Record[6] = 0;
+    Record[7] = 0;
+}
+
+static BOOLEAN
+PredictBenchSynthetic(
+    _Out_ PPREDICT_BENCH_STREAM Stream,
+    _In_ PREDICT_BENCH_KIND Kind,
+    _In_ ULONG Rate,
+    _In_ ULONG Strokes
+)
+{
+    RtlZeroMemory(Stream, sizeof(PREDICT_BENCH_STREAM));
+    Stream->Name = PredictBenchKindNames[Kind];
+    Stream->Kind = Kind;
+    Stream->Rate = Rate;
+    Stream->Frequency = PREDICT_BENCH_FREQUENCY;
+    Stream->StrokeCount = Strokes;
+    Stream->FrameCount = (ULONG)(Strokes * PREDICT_BENCH_PERIOD_S * Rate);
+    Stream->Frames = calloc(Stream->FrameCount, sizeof(TOUCH_CAPTURE_FRAME));
+    Stream->Strokes = calloc(Strokes, sizeof(PREDICT_BENCH_STROKE));
+
+    if (Stream->Frames == NULL || Stream->Strokes == NULL)
+        return FALSE;
+
+    //
+    // Same seed for every rate, so each rate samples the same strokes.
+    //
+    PredictBenchSeed = 0x9E3779B97F4A7C15ULL + Kind;
+
+    for (ULONG k = 0; k < Strokes; k++)
+    {
+        Stream->Strokes[k].X = PREDICT_BENCH_X_RESOLUTION / 2 + (PredictBenchRandom() - 0.5) * 200.0;
+        Stream->Strokes[k].Y = PREDICT_BENCH_Y_RESOLUTION / 2 + (PredictBenchRandom() - 0.5) * 200.0;
+        Stream->Strokes[k].Angle = PREDICT_BENCH_PI / 2 + (PredictBenchRandom() - 0.5) * 1.6 +
+                                   (k % 2 != 0 ? PREDICT_BENCH_PI : 0.0);
+    }
+
+    for (ULONG f = 0; f < Stream->FrameCount; f++)
+    {
+        TOUCH_CAPTURE_FRAME* frame = &Stream->Frames[f];
+        double t = (double)f / Rate;
+        ULONG k = (ULONG)(t / PREDICT_BENCH_PERIOD_S);
+        double tau = t - k * PREDICT_BENCH_PERIOD_S;
+        double x;
+        double y;
+
+        frame->Timestamp = (LONGLONG)f * PREDICT_BENCH_FREQUENCY / Rate;
+
+        if (k >= Strokes || tau > PREDICT_BENCH_STROKE_S)
+        {
+            frame->Bytes[0] = GOODIX_TOUCH_EVENT;
+            continue;
+        }
+
+        PredictBenchPath(Kind, &Stream->Strokes[k], tau, &x, &y);
+
+        frame->Count = 1;
+        frame->Bytes[0] = GOODIX_TOUCH_EVENT | 1;
+        PredictBenchRecord(&frame->Bytes[1],
+                           0,
+                           lround(x + (PredictBenchRandom() * 2.0 - 1.0) * PREDICT_BENCH_NOISE),
+                           lround(y + (PredictBenchRandom() * 2.0 - 1.0) * PREDICT_BENCH_NOISE));
+    }
+
+    return TRUE;
+}
+
+//
+// Frame Index of a stream. FALSE, with the reason printed, if a capture
+// record does not decode.
+//
+static BOOLEAN
+PredictBenchFrame(
+    _In_ PPREDICT_BENCH_STREAM Stream,
+    _In_ ULONG Index,
+    _Out_ PTOUCH_CAPTURE_FRAME Frame
+)
+{
+    if (Stream->Frames != NULL)
+    {
+        *Frame = Stream->Frames[Index];
+        return TRUE;
+    }
+
+    if (!TouchCaptureDecodeFrame(&Stream->Map.View, Index, Frame))
+    {
+        fprintf(stderr, "%s: frame %lu is corrupt\n", Stream->Name, (unsigned long)Index);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static BOOLEAN
+PredictBenchRecorded(
+    _Out_ PPREDICT_BENCH_STREAM Stream,
+    _In_ const char* Path
+)
+{
+    TOUCH_CAPTURE_FRAME first;
+    TOUCH_CAPTURE_FRAME last;
+
+    RtlZeroMemory(Stream, sizeof(PREDICT_BENCH_STREAM));
+    Stream->Name = Path;
+    Stream->Kind = PredictBenchCapture;
+
+    if (!CaptureFileMap(&Stream->Map, Path))
+        return FALSE;
+
+    if (Stream->Map.View.Header.PerfFrequency == 0 || Stream->Map.View.Header.FrameCount < 2)
+    {
+        fprintf(stderr, "%s: no frames to replay\n", Path);
+        return FALSE;
+    }
+
+    Stream->Frequency = (LONGLONG)Stream->Map.View.Header.PerfFrequency;
+    Stream->FrameCount = Stream->Map.View.Header.FrameCount;
+
+    if (!PredictBenchFrame(Stream, 0, &first) ||
+        !PredictBenchFrame(Stream, Stream->FrameCount - 1, &last))
+        return FALSE;
+
+    if (last.Timestamp > first.Timestamp)
+    {
+        Stream->Rate = (Stream->FrameCount - 1) * (double)Stream->Frequency /
+                       (double)(last.Timestamp - first.Timestamp);
+    }
+
+    return TRUE;
+}
+
+static const UINT8*
+PredictBenchFindContact(
+    _In_ const TOUCH_CAPTURE_FRAME* Frame,
+    _In_ UINT8 Id
+)
+{
+    for (UCHAR i = 0; i < Frame->Count; i++)
+    {
+        const UINT8* record = &Frame->Bytes[1 + i * BYTES_PER_COORD];
+
+        if ((record[0] & 0x0F) == Id)
+            return record;
+    }
+
+    return NULL;
+}
+
+//
+// Where the finger of contact Id in frame Index is Horizon ms later, as a
+// point record. FALSE if the contact lifts before then.
+//
+static BOOLEAN
+PredictBenchFinger(
+    _In_ PPREDICT_BENCH_STREAM Stream,
+    _In_ const TOUCH_CAPTURE_FRAME* Frame,
+    _In_ ULONG Index,
+    _In_ UINT8 Id,
+    _In_ ULONG Horizon,
+    _Out_writes_bytes_(BYTES_PER_COORD) UINT8* Record
+)
+{
+    TOUCH_CAPTURE_FRAME frames[2];
+    LONGLONG target = Frame->Timestamp + (LONGLONG)Horizon * Stream->Frequency / 1000;
+    const UINT8* before = PredictBenchFindContact(Frame, Id);
+    LONGLONG beforeTime = Frame->Timestamp;
+
+    if (Stream->Kind != PredictBenchCapture)
+    {
+        double t = (double)target / Stream->Frequency;
+        ULONG k = (ULONG)((double)Frame->Timestamp / Stream->Frequency / PREDICT_BENCH_PERIOD_S);
+        double tau = t - k * PREDICT_BENCH_PERIOD_S;
+        double x;
+        double y;
+
+        if (tau > PREDICT_BENCH_STROKE_S)
+            return FALSE;
+
+        PredictBenchPath(Stream->Kind, &Stream->Strokes[k], tau, &x, &y);
+        PredictBenchRecord(Record, Id, lround(x), lround(y));
+        return TRUE;
+    }
+
+    //
+    // Later frames alternate between two buffers, so the one holding the
+    // contact's previous position stays valid.
+    //
+    for (ULONG g = Index + 1; g < Stream->FrameCount; g++)
+    {
+        TOUCH_CAPTURE_FRAME* next = &frames[g & 1];
+        const UINT8* after;
+
+        if (!PredictBenchFrame(Stream, g, next))
+            return FALSE;
+
+        after = PredictBenchFindContact(next, Id);
+        if (after == NULL || next->Timestamp <= beforeTime)
+            return FALSE;
+
+        if (next->Timestamp >= target)
+        {
+            double w = (double)(target - beforeTime) / (double)(next->Timestamp - beforeTime);
+            LONG bx = before[1] | (before[2] << 8);
+            LONG by = before[3] | (before[4] << 8);
+            LONG ax = after[1] | (after[2] << 8);
+            LONG ay = after[3] | (after[4] << 8);
+
+            PredictBenchRecord(Record, Id, lround(bx + (ax - bx) * w), lround(by + (ay - by) * w));
+            return TRUE;
+        }
+
+        before = after;
+        beforeTime = next->Timestamp;
+    }
+
+    return FALSE;
+}
+
+static int
+PredictBenchCompare(
+    const void* a,
+    const void* b
+)
+{
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static double
+PredictBenchDistance(
+    _In_ const inputpoint* A,
+    _In_ const inputpoint* B,
+    _In_ const TOUCH_PROFILE* Profile
+)
+{
+    LONG ax = A->GD_TouchScreenFingerXL | (A->GD_TouchScreenFingerXH << 8);
+    LONG ay = A->GD_TouchScreenFingerYL | (A->GD_TouchScreenFingerYH << 8);
+    LONG bx = B->GD_TouchScreenFingerXL | (B->GD_TouchScreenFingerXH << 8);
+    LONG by = B->GD_TouchScreenFingerYL | (B->GD_TouchScreenFingerYH << 8);
+    double dx = (double)(ax - bx) * PREDICT_BENCH_X_RESOLUTION / Profile->LogicalMaxX;
+    double dy = (double)(ay - by) * PREDICT_BENCH_Y_RESOLUTION / Profile->LogicalMaxY;
+
+    return sqrt(dx * dx + dy * dy);
+}
+
+static BOOLEAN
+PredictBenchRun(
+    _In_ PPREDICT_BENCH_STREAM Stream,
+    _In_ ULONG Horizon,
+    _Inout_ double* Lag,
+    _Inout_ double* Predicted
+)
+{
+    TOUCH_CONFIG config = { 0 };
+    TOUCH_PROFILE profile;
+    TOUCH_TRANSFORM transform;
+    TOUCH_PREDICTOR predictor;
+    ULONG samples = 0;
+    double lagSum = 0.0;
+    double predictedSum = 0.0;
+
+    config.YRevert = 1;
+    config.XMax = PREDICT_BENCH_X_RESOLUTION;
+    config.YMax = PREDICT_BENCH_Y_RESOLUTION;
+    config.MaxContacts = MAX_POINT_NUM;
+    config.TouchUsages = TOUCH_USAGES_DEFAULT;
+    config.CalibrationMatrix[0] = TOUCH_TRANSFORM_ONE;
+    config.CalibrationMatrix[4] = TOUCH_TRANSFORM_ONE;
+    config.PredictionHorizon = Horizon;
+
+    TouchProfileInit(&config, &profile);
+    TouchTransformInit(&config, &profile, &transform);
+    TouchPredictorInit(&config, &profile, &predictor);
+
+    for (ULONG f = 0; f < Stream->FrameCount; f++)
+    {
+        TOUCH_CAPTURE_FRAME frame;
+        inputpoint points[MAX_POINT_NUM];
+        inputpoint read[MAX_POINT_NUM];
+        UCHAR count;
+
+        if (!PredictBenchFrame(Stream, f, &frame))
+            return FALSE;
+
+        count = (UCHAR)min(frame.Count, MAX_POINT_NUM);
+
+        GoodixDecodePoints(&frame.Bytes[1], count, (UINT8*)points);
+        TouchTransformPoints(&transform, (UINT8*)points, count);
+        RtlCopyMemory(read, points, count * sizeof(inputpoint));
+
+        TouchPredictPoints(&predictor, (UINT8*)points, count, frame.Timestamp, Stream->Frequency);
+
+        for (UCHAR i = 0; i < count; i++)
+        {
+            UINT8 record[BYTES_PER_COORD];
+            inputpoint finger;
+
+            if (!PredictBenchFinger(Stream, &frame, f, frame.Bytes[1 + i * BYTES_PER_COORD] & 0x0F, Horizon, record))
+                continue;
+
+            GoodixDecodePoints(record, 1, (UINT8*)&finger);
+            TouchTransformPoints(&transform, (UINT8*)&finger, 1);
+
+            Lag[samples] = PredictBenchDistance(&read[i], &finger, &profile);
+            Predicted[samples] = PredictBenchDistance(&points[i], &finger, &profile);
+            lagSum += Lag[samples];
+            predictedSum += Predicted[samples];
+            samples++;
+        }
+    }
+
+    qsort(Lag, samples, sizeof(double), PredictBenchCompare);
+    qsort(Predicted, samples, sizeof(double), PredictBenchCompare);
+
+    printf("{\"bench\":\"predict\",\"stream\":\"%s\",\"rate_hz\":%.1f,\"horizon_ms\":%lu,"
+           "\"samples\":%lu,\"lag_mean_px\":%.2f,\"lag_p95_px\":%.2f,"
+           "\"predicted_mean_px\":%.2f,\"predicted_p95_px\":%.2f,\"predicted_max_px\":%.2f}\n",
+           Stream->Name, Stream->Rate, (unsigned long)Horizon,
+           (unsigned long)samples,
+           samples != 0 ? lagSum / samples : 0.0,
+           samples != 0 ? Lag[(ULONG)(samples * 0.95)] : 0.0,
+           samples != 0 ? predictedSum / samples : 0.0,
+           samples != 0 ? Predicted[(ULONG)(samples * 0.95)] : 0.0,
+           samples != 0 ? Predicted[samples - 1] : 0.0);
+
+    return TRUE;
+}
+
+//
+// Runs every horizon over a stream.
+//
+static BOOLEAN
+PredictBenchStream(
+    _In_ PPREDICT_BENCH_STREAM Stream
+)
+{
+    TOUCH_CAPTURE_FRAME frame;
+    ULONG contacts = 0;
+    double* lag;
+    double* predicted;
+    BOOLEAN ok;
+
+    for (ULONG f = 0; f < Stream->FrameCount; f++)
+    {
+        if (!PredictBenchFrame(Stream, f, &frame))
+            return FALSE;
+
+        contacts += min(frame.Count, MAX_POINT_NUM);
+    }
+
+    lag = malloc((contacts + 1) * sizeof(double));
+    predicted = malloc((contacts + 1) * sizeof(double));
+    ok = lag != NULL && predicted != NULL;
+
+    for (ULONG h = 0; ok && h < ARRAYSIZE(PredictBenchHorizons); h++)
+        ok = PredictBenchRun(Stream, PredictBenchHorizons[h], lag, predicted);
+
+    free(lag);
+    free(predicted);
+
+    return ok;
+}
+
+static VOID
+PredictBenchFree(
+    _Inout_ PPREDICT_BENCH_STREAM Stream
+)
+{
+    free(Stream->Frames);
+    free(Stream->Strokes);
+    CaptureFileUnmap(&Stream->Map);
+    RtlZeroMemory(Stream, sizeof(PREDICT_BENCH_STREAM));
+}
+
+int
+main(int argc, char** argv)
+{
+    PREDICT_BENCH_STREAM stream;
+    ULONG strokes = PREDICT_BENCH_STROKES;
+    int result = 0;
+
+    if (argc > 1)
+        strokes = (ULONG)strtoul(argv[1], NULL, 0);
+    if (strokes == 0)
+        strokes = 1;
+
+    for (ULONG kind = PredictBenchLine; kind <= PredictBenchZigzag; kind++)
+    {
+        for (ULONG r = 0; r < ARRAYSIZE(PredictBenchRates); r++)
+        {
+            if (!PredictBenchSynthetic(&stream, (PREDICT_BENCH_KIND)kind, PredictBenchRates[r], strokes) ||
+                !PredictBenchStream(&stream))
+                result = 1;
+
+            PredictBenchFree(&stream);
+        }
+    }
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (!PredictBenchRecorded(&stream, argv[i]) || !PredictBenchStream(&stream))
+            result = 1;
+
+        PredictBenchFree(&stream);
+    }
+
+    return result;
+}
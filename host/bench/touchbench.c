@@ -0,0 +1,555 @@
+/*++
+
+Module Name:
+
+    touchbench.c
+
+Abstract:
+
+    End-to-end benchmark of the interrupt-to-report path. Frame streams
+    are played into the GT9xx simulator, and every interrupt it raises is
+    serviced the way OnInterruptIsr and TouchProcessFrame do it: the frame
+    is read with GoodixReadFrameFrom, decoded, transformed, filtered,
+    predicted and tracked, queued on the report ring, and popped, sliced,
+    packed and copied into a read buffer as TouchCompleteReads would.
+
+    Two kinds of stream are played:
+
+        synthetic - 1 to MAX_POINT_NUM contacts swiping up and down at
+                    60, 120, 240 and 480 Hz, lifting every half second
+        recorded  - each capture file named on the command line (see
+                    touchcapture.h), at its own timestamps, mapped and
+                    decoded a frame at a time as it is played
+
+    One JSON line per stream:
+
+        {"bench":"touch","stream":S,"rate_hz":R,"contacts":N,
+         "frames":F,"reports":C,"p50_ns":A,"p99_ns":B,"p999_ns":D,
+         "fps_per_core":P,"bus_bytes":Y,"bus_transfers":T,"allocs":M}
+
+    Latency runs from the interrupt to the copy of the last report the
+    frame produced, and is only sampled for frames that produced one.
+    fps_per_core is frames per second of path time on one core, counting
+    every frame. reports, bus_bytes, bus_transfers and allocs are per
+    frame. Bus bytes count the I2C address byte of every message and the
+    register address and data bytes, so they scale directly to bus time at
+    a given clock; the time the simulator takes in their place is not
+    representative of the bus. Allocations are every malloc, calloc and
+    realloc call made while a stream plays, counted by wrapping them at
+    link time.
+
+    The filter and predictor run with the registry defaults plus a 100 Hz
+    minimum cutoff and an 8 ms horizon, so both are on the path.
+
+    Usage: touchbench [frames per synthetic stream] [capture file ...]
+
+Environment:
+
+    User mode
+
+--*/
+
+#include <stdlib.h>
+
+#include "goodixsim.h"
+#include "capturefile.h"
+#include "hostbench.h"
+
+#define TOUCH_BENCH_FRAMES          100000
+#define TOUCH_BENCH_FREQUENCY       10000000LL      // timestamp ticks per second
+#define TOUCH_BENCH_RING_DEPTH      8
+#define TOUCH_BENCH_SPEED           2000            // swipe speed, pixels per second
+#define TOUCH_BENCH_X_RESOLUTION    1080
+#define TOUCH_BENCH_Y_RESOLUTION    2160
+#define TOUCH_BENCH_I2C_ADDRESS     1               // address byte per I2C message
+
+static const ULONG TouchBenchRates[] = { 60, 120, 240, 480 };
+
+typedef struct _TOUCH_BENCH
+{
+    GOODIX_SIM              Sim;
+    TOUCH_BUS               Bus;
+    TOUCH_CONFIG            Config;
+    TOUCH_PROFILE           Profile;
+    TOUCH_TRANSFORM         Transform;
+    TOUCH_TRACKER           Tracker;
+    TOUCH_FILTER            Filter;
+    TOUCH_PREDICTOR         Predictor;
+    REPORT_RING             Ring;
+    REPORT_RING_CELL        Cells[TOUCH_BENCH_RING_DEPTH];
+    UINT8                   Fetched;
+
+    //
+    // Timestamp of the scan being played, and its ticks per second.
+    //
+    LONGLONG                Timestamp;
+    LONGLONG                Frequency;
+
+    ULONGLONG               Frames;
+    ULONGLONG               Reports;
+    ULONGLONG               BusBytes;
+    ULONGLONG               BusTransfers;
+    ULONGLONG               PathNs;
+
+    ULONGLONG*              Latency;
+    ULONG                   Samples;
+    ULONG                   Capacity;
+
+    UCHAR                   ReadBuffer[sizeof(inputReport54_t)];
+} TOUCH_BENCH, *PTOUCH_BENCH;
+
+//
+// Allocation counting. The linker routes every malloc, calloc and realloc
+// reference in the benchmark and in touchcore through these.
+//
+static ULONGLONG HostAllocations;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* p, size_t size);
+
+void*
+__wrap_malloc(size_t size)
+{
+    HostAllocations++;
+    return __real_malloc(size);
+}
+
+void*
+__wrap_calloc(size_t count, size_t size)
+{
+    HostAllocations++;
+    return __real_calloc(count, size);
+}
+
+void*
+__wrap_realloc(void* p, size_t size)
+{
+    HostAllocations++;
+    return __real_realloc(p, size);
+}
+
+static NTSTATUS
+TouchBenchBusRead(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _Out_writes_bytes_(Length) UINT8* Buffer,
+    _In_ ULONG Length,
+    _In_ BOOLEAN Clear
+)
+{
+    PTOUCH_BENCH bench = (PTOUCH_BENCH)Context;
+    UCHAR tx[GOODIX_ADDR_LEN + 1];
+    NTSTATUS status;
+
+    tx[0] = (UCHAR)(Address >> 8);
+    tx[1] = (UCHAR)Address;
+
+    bench->BusTransfers++;
+    bench->BusBytes += TOUCH_BENCH_I2C_ADDRESS + GOODIX_ADDR_LEN +
+                       TOUCH_BENCH_I2C_ADDRESS + Length;
+
+    status = GoodixSimTransfer(&bench->Sim, tx, GOODIX_ADDR_LEN, Buffer, Length);
+    if (NT_SUCCESS(status) && Clear)
+    {
+        tx[0] = (UCHAR)(TOUCH_INFO_ADDR >> 8);
+        tx[1] = (UCHAR)TOUCH_INFO_ADDR;
+        tx[2] = 0;
+
+        bench->BusBytes += TOUCH_BENCH_I2C_ADDRESS + sizeof(tx);
+        status = GoodixSimTransfer(&bench->Sim, tx, sizeof(tx), NULL, 0);
+    }
+
+    return status;
+}
+
+static NTSTATUS
+TouchBenchBusWrite(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _In_reads_bytes_(Length) const UINT8* Buffer,
+    _In_ ULONG Length
+)
+{
+    PTOUCH_BENCH bench = (PTOUCH_BENCH)Context;
+    UCHAR tx[GOODIX_ADDR_LEN + 8];
+
+    if (Length > sizeof(tx) - GOODIX_ADDR_LEN)
+        return STATUS_INVALID_PARAMETER;
+
+    tx[0] = (UCHAR)(Address >> 8);
+    tx[1] = (UCHAR)Address;
+    RtlCopyMemory(&tx[GOODIX_ADDR_LEN], Buffer, Length);
+
+    bench->BusTransfers++;
+    bench->BusBytes += TOUCH_BENCH_I2C_ADDRESS + GOODIX_ADDR_LEN + Length;
+
+    return GoodixSimTransfer(&bench->Sim, tx, GOODIX_ADDR_LEN + Length, NULL, 0);
+}
+
+//
+// Hands every queued report to a read, one slice at a time, as
+// TouchCompleteReads does with a pending read for each.
+//
+static ULONG
+TouchBenchComplete(
+    _Inout_ PTOUCH_BENCH Bench
+)
+{
+    inputReport54_t frame;
+    inputReport54_t slice;
+    REPORT_TIMES times;
+    UCHAR packed[sizeof(inputReport54_t)];
+    ULONG completions = 0;
+
+    while (ReportRingPop(&Bench->Ring, &frame, &times))
+    {
+        UCHAR offset = 0;
+
+        do
+        {
+            ULONG length;
+
+            offset = TouchReportSlice(&Bench->Profile, &frame, offset, &slice);
+            length = TouchReportPack(&Bench->Profile, &slice, packed);
+            RtlCopyMemory(Bench->ReadBuffer, packed, length);
+            HostBenchKeep(Bench->ReadBuffer);
+            completions++;
+        } while (offset < frame.DIG_TouchScreenContactCount);
+    }
+
+    return completions;
+}
+
+//
+// Same steps as OnInterruptIsr and TouchProcessFrame, run from inside the
+// simulator's scan.
+//
+static VOID
+TouchBenchInterrupt(
+    _In_opt_ PVOID Context
+)
+{
+    PTOUCH_BENCH bench = (PTOUCH_BENCH)Context;
+    UINT8 frameBuf[TOUCH_READ_SIZE];
+    inputReport54_t report = { 0 };
+    REPORT_TIMES times = { 0 };
+    ULONGLONG start;
+    ULONGLONG elapsed;
+    ULONG completions = 0;
+    ULONG events;
+    UINT8 count;
+    NTSTATUS status;
+    BOOLEAN changed;
+
+    start = HostBenchNowNs();
+
+    status = GoodixReadFrameFrom(&bench->Bus, bench->Fetched, FALSE, frameBuf, &count, &events);
+
+    if (events & GOODIX_FRAME_SHORT)
+        bench->Fetched = min(frameBuf[0] & GOODIX_TOUCH_COUNT_MASK, MAX_POINT_NUM);
+
+    if (NT_SUCCESS(status) && (frameBuf[0] & 0xF0) == GOODIX_TOUCH_EVENT)
+    {
+        bench->Fetched = max(count, 1);
+        count = (UINT8)min(count, bench->Profile.MaxContacts);
+
+        if (count != 0)
+        {
+            GoodixDecodePoints(&frameBuf[1], count, report.points);
+            TouchTransformPoints(&bench->Transform, report.points, count);
+        }
+
+        changed = TouchFilterPoints(&bench->Filter,
+                                    report.points,
+                                    count,
+                                    bench->Timestamp,
+                                    bench->Frequency);
+        if (TouchPredictPoints(&bench->Predictor,
+                               report.points,
+                               count,
+                               bench->Timestamp,
+                               bench->Frequency))
+        {
+            changed = TRUE;
+        }
+        report.DIG_TouchScreenContactCount = TouchTrackerUpdate(&bench->Tracker,
+                                                                report.points,
+                                                                count,
+                                                                bench->Profile.MaxContacts);
+
+        if (report.DIG_TouchScreenContactCount != 0 &&
+            (changed || report.DIG_TouchScreenContactCount != count))
+        {
+            report.reportId = TOUCH_REPORT_ID;
+            ReportRingPush(&bench->Ring, &report, &times);
+            completions = TouchBenchComplete(bench);
+        }
+    }
+
+    elapsed = HostBenchNowNs() - start;
+
+    bench->Frames++;
+    bench->PathNs += elapsed;
+
+    if (completions != 0)
+    {
+        bench->Reports += completions;
+        if (bench->Samples < bench->Capacity)
+            bench->Latency[bench->Samples++] = elapsed;
+    }
+}
+
+static VOID
+TouchBenchInit(
+    _Out_ PTOUCH_BENCH Bench,
+    _In_ ULONGLONG* Latency,
+    _In_ ULONG Capacity,
+    _In_ LONGLONG Frequency
+)
+{
+    RtlZeroMemory(Bench, sizeof(TOUCH_BENCH));
+
+    GoodixSimInit(&Bench->Sim, TOUCH_BENCH_X_RESOLUTION, TOUCH_BENCH_Y_RESOLUTION, MAX_POINT_NUM);
+    Bench->Sim.Interrupt = TouchBenchInterrupt;
+    Bench->Sim.InterruptContext = Bench;
+
+    Bench->Bus.Context = Bench;
+    Bench->Bus.Read = TouchBenchBusRead;
+    Bench->Bus.Write = TouchBenchBusWrite;
+
+    Bench->Config.YRevert = 1;
+    Bench->Config.XMax = TOUCH_BENCH_X_RESOLUTION;
+    Bench->Config.YMax = TOUCH_BENCH_Y_RESOLUTION;
+    Bench->Config.MaxContacts = MAX_POINT_NUM;
+    Bench->Config.TouchUsages = TOUCH_USAGES_DEFAULT;
+    Bench->Config.CalibrationMatrix[0] = TOUCH_TRANSFORM_ONE;
+    Bench->Config.CalibrationMatrix[4] = TOUCH_TRANSFORM_ONE;
+    Bench->Config.FilterMinCutoff = 100000;
+    Bench->Config.FilterBeta = TOUCH_FILTER_BETA_DEFAULT;
+    Bench->Config.FilterDerivCutoff = TOUCH_FILTER_DERIV_CUTOFF_DEFAULT;
+    Bench->Config.PredictionHorizon = 8;
+
+    TouchProfileInit(&Bench->Config, &Bench->Profile);
+    TouchTransformInit(&Bench->Config, &Bench->Profile, &Bench->Transform);
+    TouchTrackerReset(&Bench->Tracker);
+    TouchFilterInit(&Bench->Config, &Bench->Filter);
+    TouchPredictorInit(&Bench->Config, &Bench->Profile, &Bench->Predictor);
+    ReportRingInit(&Bench->Ring, Bench->Cells, ARRAYSIZE(Bench->Cells));
+
+    Bench->Fetched = 1;
+    Bench->Frequency = Frequency;
+    Bench->Latency = Latency;
+    Bench->Capacity = Capacity;
+}
+
+static int
+TouchBenchCompareNs(
+    const void* a,
+    const void* b
+)
+{
+    ULONGLONG x = *(const ULONGLONG*)a;
+    ULONGLONG y = *(const ULONGLONG*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static ULONGLONG
+TouchBenchPercentile(
+    _In_ PTOUCH_BENCH Bench,
+    _In_ ULONG PerMille
+)
+{
+    ULONG index;
+
+    if (Bench->Samples == 0)
+        return 0;
+
+    index = (ULONG)((ULONGLONG)Bench->Samples * PerMille / 1000);
+    return Bench->Latency[min(index, Bench->Samples - 1)];
+}
+
+static VOID
+TouchBenchPrint(
+    _In_ PTOUCH_BENCH Bench,
+    _In_ const char* Stream,
+    _In_ double Rate,
+    _In_ double Contacts,
+    _In_ ULONGLONG Allocations
+)
+{
+    double frames = Bench->Frames != 0 ? (double)Bench->Frames : 1.0;
+
+    qsort(Bench->Latency, Bench->Samples, sizeof(ULONGLONG), TouchBenchCompareNs);
+
+    printf("{\"bench\":\"touch\",\"stream\":\"%s\",\"rate_hz\":%.1f,\"contacts\":%.2f,"
+           "\"frames\":%llu,\"reports\":%.3f,\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu,"
+           "\"fps_per_core\":%.0f,\"bus_bytes\":%.1f,\"bus_transfers\":%.3f,\"allocs\":%.3f}\n",
+           Stream, Rate, Contacts,
+           (unsigned long long)Bench->Frames,
+           (double)Bench->Reports / frames,
+           (unsigned long long)TouchBenchPercentile(Bench, 500),
+           (unsigned long long)TouchBenchPercentile(Bench, 990),
+           (unsigned long long)TouchBenchPercentile(Bench, 999),
+           Bench->PathNs != 0 ? Bench->Frames * 1e9 / Bench->PathNs : 0.0,
+           (double)Bench->BusBytes / frames,
+           (double)Bench->BusTransfers / frames,
+           (double)Allocations / frames);
+}
+
+//
+// Contacts swipe up and down a column each, all lifting for one frame
+// every half second.
+//
+static VOID
+TouchBenchSynthetic(
+    _In_ ULONG Rate,
+    _In_ UCHAR Contacts,
+    _In_ ULONG Frames,
+    _In_ ULONGLONG* Latency
+)
+{
+    TOUCH_BENCH bench;
+    GOODIX_SIM_CONTACT contacts[MAX_POINT_NUM];
+    const ULONG span = TOUCH_BENCH_Y_RESOLUTION - 200;
+    ULONGLONG allocations;
+
+    TouchBenchInit(&bench, Latency, Frames, TOUCH_BENCH_FREQUENCY);
+
+    allocations = HostAllocations;
+
+    for (ULONG f = 0; f < Frames; f++)
+    {
+        ULONG travel = (ULONG)((ULONGLONG)f * TOUCH_BENCH_SPEED / Rate % (2 * span));
+        UCHAR down = (f % (Rate / 2) == Rate / 2 - 1) ? 0 : Contacts;
+
+        for (UCHAR i = 0; i < down; i++)
+        {
+            contacts[i].Id = i;
+            contacts[i].X = (USHORT)(50 + i * (TOUCH_BENCH_X_RESOLUTION - 100) / MAX_POINT_NUM);
+            contacts[i].Y = (USHORT)(100 + (travel < span ? travel : 2 * span - travel));
+            contacts[i].Size = 30;
+        }
+
+        bench.Timestamp = (LONGLONG)f * TOUCH_BENCH_FREQUENCY / Rate;
+        GoodixSimScan(&bench.Sim, contacts, down);
+    }
+
+    TouchBenchPrint(&bench, "synthetic", Rate, Contacts, HostAllocations - allocations);
+}
+
+static BOOLEAN
+TouchBenchRecorded(
+    _In_ const char* Path
+)
+{
+    TOUCH_BENCH bench;
+    CAPTURE_MAP map;
+    PTOUCH_CAPTURE_VIEW view = &map.View;
+    TOUCH_CAPTURE_FRAME frame;
+    GOODIX_SIM_CONTACT contacts[MAX_POINT_NUM];
+    ULONGLONG* latency;
+    ULONGLONG allocations;
+    ULONGLONG contactSum = 0;
+    double seconds;
+    BOOLEAN ok = FALSE;
+
+    if (!CaptureFileMap(&map, Path))
+        return FALSE;
+
+    if (view->Header.PerfFrequency == 0)
+    {
+        fprintf(stderr, "%s: capture has no timestamp frequency\n", Path);
+        CaptureFileUnmap(&map);
+        return FALSE;
+    }
+
+    latency = malloc((view->Header.FrameCount + 1) * sizeof(ULONGLONG));
+    if (latency == NULL)
+    {
+        CaptureFileUnmap(&map);
+        return FALSE;
+    }
+
+    TouchBenchInit(&bench, latency, view->Header.FrameCount, (LONGLONG)view->Header.PerfFrequency);
+
+    allocations = HostAllocations;
+
+    for (ULONG f = 0; f < view->Header.FrameCount; f++)
+    {
+        if (!TouchCaptureDecodeFrame(view, f, &frame))
+        {
+            fprintf(stderr, "%s: frame %lu is corrupt\n", Path, (unsigned long)f);
+            goto exit;
+        }
+
+        for (UCHAR i = 0; i < frame.Count; i++)
+        {
+            const UINT8* record = &frame.Bytes[1 + i * BYTES_PER_COORD];
+
+            contacts[i].Id = record[0] & 0x0F;
+            contacts[i].X = (USHORT)(record[1] | (record[2] << 8));
+            contacts[i].Y = (USHORT)(record[3] | (record[4] << 8));
+            contacts[i].Size = (USHORT)(record[5] | (record[6] << 8));
+        }
+
+        contactSum += frame.Count;
+        bench.Timestamp = frame.Timestamp;
+        GoodixSimScan(&bench.Sim, contacts, frame.Count);
+    }
+
+    seconds = 0.0;
+    if (view->Header.FrameCount > 1)
+    {
+        TOUCH_CAPTURE_FRAME first;
+
+        if (TouchCaptureDecodeFrame(view, 0, &first))
+            seconds = (double)(frame.Timestamp - first.Timestamp) / view->Header.PerfFrequency;
+    }
+
+    TouchBenchPrint(&bench,
+                    Path,
+                    seconds > 0.0 ? (view->Header.FrameCount - 1) / seconds : 0.0,
+                    view->Header.FrameCount != 0 ? (double)contactSum / view->Header.FrameCount : 0.0,
+                    HostAllocations - allocations);
+    ok = TRUE;
+
+exit:
+    free(latency);
+    CaptureFileUnmap(&map);
+    return ok;
+}
+
+int
+main(int argc, char** argv)
+{
+    ULONGLONG* latency;
+    ULONG frames = TOUCH_BENCH_FRAMES;
+    int result = 0;
+
+    if (argc > 1)
+        frames = (ULONG)strtoul(argv[1], NULL, 0);
+    if (frames == 0)
+        frames = 1;
+
+    latency = malloc(frames * sizeof(ULONGLONG));
+    if (latency == NULL)
+        return 1;
+
+    for (ULONG r = 0; r < ARRAYSIZE(TouchBenchRates); r++)
+    {
+        for (UCHAR contacts = 1; contacts <= MAX_POINT_NUM; contacts++)
+            TouchBenchSynthetic(TouchBenchRates[r], contacts, frames, latency);
+    }
+
+    free(latency);
+
+    for (int i = 2; i < argc; i++)
+    {
+        if (!TouchBenchRecorded(argv[i]))
+            result = 1;
+    }
+
+    return result;
+}
@@ -0,0 +1,4 @@
+//
+// Host shim: MSVC's name for the NEON intrinsics header.
+//
+#include <arm_neon.h>
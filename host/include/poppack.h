@@ -0,0 +1,5 @@
+//
+// Host shim for the WDK packing header: restore the packing saved by
+// pshpack1.h.
+//
+#pragma pack(pop)
@@ -0,0 +1,5 @@
+//
+// Host shim for the WDK packing header: byte-pack the structures that
+// follow until poppack.h.
+//
+#pragma pack(push, 1)
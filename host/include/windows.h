@@ -0,0 +1,218 @@
+/*++
+
+Module Name:
+
+    windows.h
+
+Abstract:
+
+    Host shim standing in for the Windows headers, so the platform-neutral
+    driver sources (touchcore, goodixsim, touchcapture) build with an
+    ordinary C compiler. Only what those sources and the host tests use is
+    defined: the base types, SAL annotations as no-ops, the NTSTATUS values,
+    the Rtl memory routines and the interlocked and barrier intrinsics on
+    top of the compiler's __atomic builtins.
+
+    Not used by the driver build, which gets the real headers from the WDK.
+
+Environment:
+
+    User mode, GCC or Clang
+
+--*/
+
+#ifndef __HOST_WINDOWS_H__
+#define __HOST_WINDOWS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//
+// touchcore.c picks its SIMD decoder by the MSVC architecture macros.
+//
+#if defined(__x86_64__) && !defined(_M_AMD64)
+#define _M_AMD64 1
+#elif defined(__aarch64__) && !defined(_M_ARM64)
+#define _M_ARM64 1
+#endif
+
+typedef void                VOID, *PVOID;
+typedef uint8_t             UINT8, UCHAR, BYTE, BOOLEAN, *PUINT8, *PUCHAR, *PBOOLEAN;
+typedef uint16_t            UINT16, USHORT, *PUSHORT;
+typedef uint32_t            UINT32, ULONG, *PULONG;
+typedef int32_t             LONG, *PLONG, NTSTATUS;
+typedef int16_t             SHORT;
+typedef uint64_t            UINT64, ULONGLONG, ULONG64;
+typedef int64_t             LONGLONG, LONG64;
+typedef intptr_t            LONG_PTR;
+typedef uintptr_t           ULONG_PTR, SIZE_T;
+typedef char                CHAR;
+
+#define TRUE                1
+#define FALSE               0
+
+#define MAXUSHORT           0xFFFF
+#define MAXULONG            0xFFFFFFFFUL
+#define MAXLONG             0x7FFFFFFFL
+
+#define __declspec(x)       __declspec_##x
+#define __declspec_align(n) __attribute__((aligned(n)))
+
+#define C_ASSERT(e)         _Static_assert(e, #e)
+#define ARRAYSIZE(a)        (sizeof(a) / sizeof((a)[0]))
+#define FIELD_OFFSET(t, f)  ((LONG)offsetof(t, f))
+#define UNREFERENCED_PARAMETER(p) ((void)(p))
+
+#ifndef min
+#define min(a, b)           (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b)           (((a) > (b)) ? (a) : (b))
+#endif
+
+//
+// SAL annotations
+//
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _In_reads_(n)
+#define _In_reads_bytes_(n)
+#define _Out_writes_(n)
+#define _Out_writes_bytes_(n)
+#define _Out_writes_bytes_opt_(n)
+#define _Out_writes_bytes_to_(n, m)
+#define _Inout_updates_(n)
+#define _Inout_updates_bytes_(n)
+
+//
+// NTSTATUS
+//
+#define NT_SUCCESS(s)                   (((NTSTATUS)(s)) >= 0)
+#define STATUS_SUCCESS                  ((NTSTATUS)0x00000000L)
+#define STATUS_UNSUCCESSFUL             ((NTSTATUS)0xC0000001L)
+#define STATUS_INVALID_PARAMETER        ((NTSTATUS)0xC000000DL)
+#define STATUS_BUFFER_TOO_SMALL         ((NTSTATUS)0xC0000023L)
+#define STATUS_CRC_ERROR                ((NTSTATUS)0xC000003FL)
+#define STATUS_IO_DEVICE_ERROR          ((NTSTATUS)0xC0000185L)
+#define STATUS_DEVICE_BUSY              ((NTSTATUS)0x80000011L)
+#define STATUS_DEVICE_DATA_ERROR        ((NTSTATUS)0xC000009CL)
+
+//
+// Rtl. With HOST_COPY_ACCOUNTING defined the copy and fill routines also
+// add what they move to counters that the program defines, so a benchmark
+// can report bytes copied per frame.
+//
+#ifdef HOST_COPY_ACCOUNTING
+extern ULONGLONG HostCopyBytes;
+extern ULONGLONG HostCopyCalls;
+extern ULONGLONG HostFillBytes;
+
+#define RtlCopyMemory(d, s, n)          (HostCopyBytes += (n), HostCopyCalls++, memcpy((d), (s), (n)))
+#define RtlMoveMemory(d, s, n)          (HostCopyBytes += (n), HostCopyCalls++, memmove((d), (s), (n)))
+#define RtlZeroMemory(d, n)             (HostFillBytes += (n), memset((d), 0, (n)))
+#define RtlFillMemory(d, n, v)          (HostFillBytes += (n), memset((d), (v), (n)))
+#else
+#define RtlCopyMemory(d, s, n)          memcpy((d), (s), (n))
+#define RtlMoveMemory(d, s, n)          memmove((d), (s), (n))
+#define RtlZeroMemory(d, n)             memset((d), 0, (n))
+#define RtlFillMemory(d, n, v)          memset((d), (v), (n))
+#endif
+
+static inline SIZE_T
+RtlCompareMemory(const void* a, const void* b, SIZE_T n)
+{
+    const UCHAR* x = (const UCHAR*)a;
+    const UCHAR* y = (const UCHAR*)b;
+    SIZE_T i = 0;
+
+    while (i < n && x[i] == y[i])
+        i++;
+
+    return i;
+}
+
+//
+// Bit scans; the result is undefined when the mask is zero, as on Windows.
+//
+static inline BOOLEAN
+BitScanForward(ULONG* index, ULONG mask)
+{
+    if (mask == 0)
+        return FALSE;
+    *index = (ULONG)__builtin_ctz(mask);
+    return TRUE;
+}
+
+static inline BOOLEAN
+BitScanReverse(ULONG* index, ULONG mask)
+{
+    if (mask == 0)
+        return FALSE;
+    *index = 31 - (ULONG)__builtin_clz(mask);
+    return TRUE;
+}
+
+//
+// Interlocked operations and barriers, sequentially consistent like the
+// full-barrier Windows intrinsics.
+//
+static inline LONG
+InterlockedIncrement(volatile LONG* p)
+{
+    return __atomic_add_fetch(p, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG
+InterlockedDecrement(volatile LONG* p)
+{
+    return __atomic_sub_fetch(p, 1, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG
+InterlockedExchange(volatile LONG* p, LONG v)
+{
+    return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG
+InterlockedExchangeAdd(volatile LONG* p, LONG v)
+{
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG64
+InterlockedExchangeAdd64(volatile LONG64* p, LONG64 v)
+{
+    return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline LONG
+InterlockedCompareExchange(volatile LONG* p, LONG exchange, LONG comparand)
+{
+    __atomic_compare_exchange_n(p, &comparand, exchange, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+    return comparand;
+}
+
+static inline LONG
+ReadAcquire(const volatile LONG* p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline LONG
+ReadNoFence(const volatile LONG* p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline VOID
+WriteRelease(volatile LONG* p, LONG v)
+{
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+#endif // __HOST_WINDOWS_H__
@@ -0,0 +1,326 @@
+/*++
+
+Module Name:
+
+    capturetest.c
+
+Abstract:
+
+    Round trip of the capture format. Random frames, with contacts that
+    come, go and jump across the whole coordinate range, are written with
+    the capture file writer, mapped back and decoded in random order with
+    TouchCaptureDecodeFrame; every frame must come back exactly as
+    written. Damaged images must be refused rather than misread.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "capturefile.h"
+#include "hosttest.h"
+
+#define CAPTURE_TEST_FRAMES     (TOUCH_CAPTURE_KEY_INTERVAL * 20 + 7)
+#define CAPTURE_TEST_FREQUENCY  10000000ULL
+
+typedef struct _CAPTURE_TEST_FRAME
+{
+    LONGLONG                Timestamp;
+    UCHAR                   Count;
+    UINT8                   Bytes[TOUCH_FRAME_SIZE];
+} CAPTURE_TEST_FRAME;
+
+static ULONG64 CaptureSeed = 0x2545F4914F6CDD1DULL;
+
+static ULONG64
+CaptureRandom(VOID)
+{
+    CaptureSeed ^= CaptureSeed << 13;
+    CaptureSeed ^= CaptureSeed >> 7;
+    CaptureSeed ^= CaptureSeed << 17;
+    return CaptureSeed;
+}
+
+//
+// Builds frames that exercise the encoder: ids that stay, leave and come
+// back, coordinates that drift or jump anywhere, occasional timestamps
+// that run backwards, and every contact count.
+//
+static VOID
+CaptureTestFrames(
+    _Out_writes_(Count) CAPTURE_TEST_FRAME* Frames,
+    _In_ ULONG Count
+)
+{
+    LONGLONG timestamp = 1000;
+
+    for (ULONG f = 0; f < Count; f++)
+    {
+        CAPTURE_TEST_FRAME* frame = &Frames[f];
+        USHORT used = 0;
+
+        RtlZeroMemory(frame, sizeof(CAPTURE_TEST_FRAME));
+
+        timestamp += (CaptureRandom() % 16 == 0) ? -(LONGLONG)(CaptureRandom() % 5000)
+                                                 : (LONGLONG)(CaptureRandom() % 200000);
+        frame->Timestamp = timestamp;
+        frame->Count = (UCHAR)(CaptureRandom() % (MAX_POINT_NUM + 1));
+        frame->Bytes[0] = (UINT8)(GOODIX_TOUCH_EVENT | frame->Count);
+
+        for (UCHAR i = 0; i < frame->Count; i++)
+        {
+            UINT8* record = &frame->Bytes[1 + i * BYTES_PER_COORD];
+            const UINT8* previous = NULL;
+            UINT8 id;
+            ULONG x;
+            ULONG y;
+
+            do
+            {
+                id = (UINT8)(CaptureRandom() % TOUCH_TRACK_IDS);
+            } while (used & (1 << id));
+            used |= (USHORT)(1 << id);
+
+            if (f != 0)
+            {
+                for (UCHAR j = 0; j < Frames[f - 1].Count; j++)
+                {
+                    if ((Frames[f - 1].Bytes[1 + j * BYTES_PER_COORD] & 0x0F) == id)
+                        previous = &Frames[f - 1].Bytes[1 + j * BYTES_PER_COORD];
+                }
+            }
+
+            if (previous != NULL && CaptureRandom() % 8 != 0)
+            {
+                x = (ULONG)(previous[1] | (previous[2] << 8)) + (ULONG)(CaptureRandom() % 41) - 20;
+                y = (ULONG)(previous[3] | (previous[4] << 8)) + (ULONG)(CaptureRandom() % 41) - 20;
+            }
+            else
+            {
+                x = (ULONG)CaptureRandom();
+                y = (ULONG)CaptureRandom();
+            }
+
+            record[0] = (UINT8)((CaptureRandom() & 0xF0) | id);
+            record[1] = (UINT8)x;
+            record[2] = (UINT8)(x >> 8);
+            record[3] = (UINT8)y;
+            record[4] = (UINT8)(y >> 8);
+            record[5] = (UINT8)CaptureRandom();
+            record[6] = (UINT8)CaptureRandom();
+            record[7] = (UINT8)CaptureRandom();
+        }
+    }
+}
+
+static UCHAR*
+CaptureTestLoad(
+    _In_ const char* Path,
+    _Out_ ULONGLONG* Size
+)
+{
+    FILE* file = fopen(Path, "rb");
+    UCHAR* image;
+    long size;
+
+    *Size = 0;
+    if (file == NULL)
+        return NULL;
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    image = malloc(size > 0 ? (size_t)size : 1);
+    if (image != NULL && fread(image, 1, (size_t)size, file) != (size_t)size)
+    {
+        free(image);
+        image = NULL;
+    }
+
+    fclose(file);
+    *Size = (ULONGLONG)size;
+    return image;
+}
+
+static BOOLEAN
+CaptureTestSame(
+    _In_ const CAPTURE_TEST_FRAME* Expected,
+    _In_ const TOUCH_CAPTURE_FRAME* Actual
+)
+{
+    return Actual->Timestamp == Expected->Timestamp &&
+           Actual->Count == Expected->Count &&
+           memcmp(Actual->Bytes, Expected->Bytes, 1 + Expected->Count * BYTES_PER_COORD) == 0;
+}
+
+static VOID
+TestRoundTrip(
+    _In_ const char* Path
+)
+{
+    static CAPTURE_TEST_FRAME frames[CAPTURE_TEST_FRAMES];
+    CAPTURE_FILE capture;
+    CAPTURE_MAP map;
+    PTOUCH_CAPTURE_VIEW view = &map.View;
+    TOUCH_CAPTURE_FRAME decoded;
+    ULONG mismatches = 0;
+
+    CaptureTestFrames(frames, CAPTURE_TEST_FRAMES);
+
+    CHECK(CaptureFileCreate(&capture, Path, CAPTURE_TEST_FREQUENCY));
+    for (ULONG f = 0; f < CAPTURE_TEST_FRAMES; f++)
+        CHECK(CaptureFileAppend(&capture, frames[f].Timestamp, frames[f].Bytes, frames[f].Count));
+    CHECK(CaptureFileClose(&capture));
+
+    //
+    // Read back the way the benches do, from a mapping of the file.
+    //
+    CHECK(CaptureFileMap(&map, Path));
+    if (map.Base == NULL)
+        return;
+
+    CHECK_EQ(view->Header.FrameCount, CAPTURE_TEST_FRAMES);
+    CHECK_EQ(view->Header.KeyInterval, TOUCH_CAPTURE_KEY_INTERVAL);
+    CHECK_EQ(view->Header.PerfFrequency, CAPTURE_TEST_FREQUENCY);
+
+    //
+    // Delta records must actually be smaller than the frames they encode.
+    //
+    CHECK(map.Length < (size_t)CAPTURE_TEST_FRAMES * (sizeof(LONGLONG) + 1 + TOUCH_FRAME_SIZE));
+
+    for (ULONG f = 0; f < CAPTURE_TEST_FRAMES; f++)
+    {
+        if (!TouchCaptureDecodeFrame(view, f, &decoded) || !CaptureTestSame(&frames[f], &decoded))
+            mismatches++;
+    }
+
+    for (ULONG n = 0; n < CAPTURE_TEST_FRAMES; n++)
+    {
+        ULONG f = (ULONG)(CaptureRandom() % CAPTURE_TEST_FRAMES);
+
+        if (!TouchCaptureDecodeFrame(view, f, &decoded) || !CaptureTestSame(&frames[f], &decoded))
+            mismatches++;
+    }
+
+    CHECK_EQ(mismatches, 0);
+    CHECK(!TouchCaptureDecodeFrame(view, CAPTURE_TEST_FRAMES, &decoded));
+
+    CaptureFileUnmap(&map);
+}
+
+static VOID
+TestEmpty(
+    _In_ const char* Path
+)
+{
+    CAPTURE_FILE capture;
+    TOUCH_CAPTURE_VIEW view;
+    TOUCH_CAPTURE_FRAME decoded;
+    ULONGLONG size;
+    UCHAR* image;
+
+    CHECK(CaptureFileCreate(&capture, Path, CAPTURE_TEST_FREQUENCY));
+    CHECK(CaptureFileClose(&capture));
+
+    image = CaptureTestLoad(Path, &size);
+    CHECK(image != NULL);
+    if (image == NULL)
+        return;
+
+    CHECK(TouchCaptureOpen(image, size, &view));
+    CHECK_EQ(view.Header.FrameCount, 0);
+    CHECK(!TouchCaptureDecodeFrame(&view, 0, &decoded));
+
+    free(image);
+}
+
+static VOID
+TestDamaged(
+    _In_ const char* Path
+)
+{
+    static CAPTURE_TEST_FRAME frames[TOUCH_CAPTURE_KEY_INTERVAL * 2];
+    CAPTURE_FILE capture;
+    TOUCH_CAPTURE_VIEW view;
+    TOUCH_CAPTURE_FRAME decoded;
+    TOUCH_CAPTURE_HEADER header;
+    ULONGLONG* index;
+    ULONGLONG size;
+    ULONGLONG saved;
+    UCHAR* image;
+    ULONG last = ARRAYSIZE(frames) - 1;
+
+    CaptureTestFrames(frames, ARRAYSIZE(frames));
+    frames[last - 1].Count = MAX_POINT_NUM;
+
+    CHECK(CaptureFileCreate(&capture, Path, CAPTURE_TEST_FREQUENCY));
+    for (ULONG f = 0; f < ARRAYSIZE(frames); f++)
+        CHECK(CaptureFileAppend(&capture, frames[f].Timestamp, frames[f].Bytes, frames[f].Count));
+    CHECK(CaptureFileClose(&capture));
+
+    image = CaptureTestLoad(Path, &size);
+    CHECK(image != NULL);
+    if (image == NULL)
+        return;
+
+    RtlCopyMemory(&header, image, sizeof(header));
+
+    //
+    // an unfinished file, whose header is still zero
+    //
+    RtlZeroMemory(image, sizeof(header));
+    CHECK(!TouchCaptureOpen(image, size, &view));
+    RtlCopyMemory(image, &header, sizeof(header));
+
+    //
+    // cut short inside the index
+    //
+    CHECK(!TouchCaptureOpen(image, size - sizeof(ULONGLONG), &view));
+    CHECK(!TouchCaptureOpen(image, sizeof(header) - 1, &view));
+
+    //
+    // an index entry pointing past the records
+    //
+    CHECK(TouchCaptureOpen(image, size, &view));
+    index = (ULONGLONG*)(image + header.IndexOffset);
+    saved = index[1];
+    index[1] = header.IndexOffset + 8;
+    CHECK(!TouchCaptureDecodeFrame(&view, 1, &decoded));
+    index[1] = saved;
+    CHECK(TouchCaptureDecodeFrame(&view, 1, &decoded));
+
+    //
+    // a record with every contact cut after its first three bytes, as if
+    // the points were lost: the decoder must stop at the record's end
+    //
+    CHECK(TouchCaptureDecodeFrame(&view, last - 1, &decoded));
+    index[last] = index[last - 1] + 3;
+    CHECK(!TouchCaptureDecodeFrame(&view, last - 1, &decoded));
+
+    free(image);
+}
+
+int
+main(VOID)
+{
+    char path[] = "/tmp/capturetestXXXXXX";
+    int fd = mkstemp(path);
+
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return HOST_TEST_RESULT("capturetest");
+    close(fd);
+
+    TestRoundTrip(path);
+    TestEmpty(path);
+    TestDamaged(path);
+
+    unlink(path);
+
+    return HOST_TEST_RESULT("capturetest");
+}
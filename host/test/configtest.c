@@ -0,0 +1,181 @@
+/*++
+
+Module Name:
+
+    configtest.c
+
+Abstract:
+
+    Host test of the controller configuration checks: GoodixConfigChecksum
+    against a block summed by hand, and GoodixParseConfig accepting a good
+    block and refusing a bad checksum, a zero resolution and a contact
+    count of zero or above MAX_POINT_NUM, leaving Info untouched when it
+    refuses.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include "touchcore.h"
+#include "hosttest.h"
+
+//
+// A GT911 block for a 1080 x 2160 panel with 5 contacts; every byte not
+// set here is zero, so the bytes sum to 0xFA and the checksum is 0x06.
+//
+static VOID
+ConfigBlock(
+    _Out_writes_bytes_(GOODIX_CONFIG_LENGTH + 1) UCHAR* Config
+)
+{
+    RtlZeroMemory(Config, GOODIX_CONFIG_LENGTH + 1);
+
+    Config[GOODIX_CONFIG_VERSION] = 0x41;
+    Config[GOODIX_CONFIG_X_OUTPUT_MAX] = 0x38;
+    Config[GOODIX_CONFIG_X_OUTPUT_MAX + 1] = 0x04;
+    Config[GOODIX_CONFIG_Y_OUTPUT_MAX] = 0x70;
+    Config[GOODIX_CONFIG_Y_OUTPUT_MAX + 1] = 0x08;
+    Config[GOODIX_CONFIG_TOUCH_NUMBER] = 5;
+    Config[GOODIX_CONFIG_LENGTH] = 0x06;
+}
+
+static VOID
+ConfigSeal(
+    _Inout_updates_bytes_(GOODIX_CONFIG_LENGTH + 1) UCHAR* Config
+)
+{
+    Config[GOODIX_CONFIG_LENGTH] = GoodixConfigChecksum(Config);
+}
+
+static VOID
+TestChecksum(VOID)
+{
+    UCHAR config[GOODIX_CONFIG_LENGTH + 1];
+
+    ConfigBlock(config);
+    CHECK_EQ(GoodixConfigChecksum(config), 0x06);
+
+    //
+    // the checksum byte itself is not summed
+    //
+    config[GOODIX_CONFIG_LENGTH] = 0xFF;
+    CHECK_EQ(GoodixConfigChecksum(config), 0x06);
+
+    //
+    // a block summing to zero has a zero checksum, not 0x100
+    //
+    RtlZeroMemory(config, sizeof(config));
+    CHECK_EQ(GoodixConfigChecksum(config), 0);
+    config[0] = 0x80;
+    config[GOODIX_CONFIG_LENGTH - 1] = 0x80;
+    CHECK_EQ(GoodixConfigChecksum(config), 0);
+}
+
+static VOID
+TestGood(VOID)
+{
+    UCHAR config[GOODIX_CONFIG_LENGTH + 1];
+    GOODIX_CONTROLLER_INFO info = { 0 };
+
+    RtlCopyMemory(info.ProductId, "911", GOODIX_PRODUCT_ID_LENGTH);
+    info.FirmwareVersion = 0x1060;
+
+    ConfigBlock(config);
+    CHECK(GoodixParseConfig(config, &info));
+    CHECK_EQ(info.ConfigVersion, 0x41);
+    CHECK_EQ(info.XResolution, 1080);
+    CHECK_EQ(info.YResolution, 2160);
+    CHECK_EQ(info.MaxContacts, 5);
+
+    //
+    // identification is not part of the block
+    //
+    CHECK(memcmp(info.ProductId, "911", GOODIX_PRODUCT_ID_LENGTH) == 0);
+    CHECK_EQ(info.FirmwareVersion, 0x1060);
+
+    //
+    // the bits above the count are not part of it
+    //
+    config[GOODIX_CONFIG_TOUCH_NUMBER] = 0xF0 | MAX_POINT_NUM;
+    ConfigSeal(config);
+    CHECK(GoodixParseConfig(config, &info));
+    CHECK_EQ(info.MaxContacts, MAX_POINT_NUM);
+}
+
+//
+// Parses a block that must be refused and checks Info was left alone.
+//
+static VOID
+ConfigRefused(
+    _In_ const UCHAR* Config,
+    _In_ int Line
+)
+{
+    GOODIX_CONTROLLER_INFO info;
+    GOODIX_CONTROLLER_INFO before;
+
+    memset(&info, 0xA5, sizeof(info));
+    before = info;
+
+    if (GoodixParseConfig(Config, &info) || memcmp(&info, &before, sizeof(info)) != 0)
+    {
+        fprintf(stderr, "%s:%d: block accepted or Info changed\n", __FILE__, Line);
+        HostTestFailures++;
+    }
+}
+
+static VOID
+TestBad(VOID)
+{
+    UCHAR config[GOODIX_CONFIG_LENGTH + 1];
+
+    ConfigBlock(config);
+    config[GOODIX_CONFIG_LENGTH] ^= 0x01;
+    ConfigRefused(config, __LINE__);
+
+    //
+    // a byte changed behind the checksum's back
+    //
+    ConfigBlock(config);
+    config[GOODIX_CONFIG_LENGTH - 1] = 0x01;
+    ConfigRefused(config, __LINE__);
+
+    ConfigBlock(config);
+    config[GOODIX_CONFIG_TOUCH_NUMBER] = 0;
+    ConfigSeal(config);
+    ConfigRefused(config, __LINE__);
+
+    ConfigBlock(config);
+    config[GOODIX_CONFIG_TOUCH_NUMBER] = MAX_POINT_NUM + 1;
+    ConfigSeal(config);
+    ConfigRefused(config, __LINE__);
+
+    ConfigBlock(config);
+    config[GOODIX_CONFIG_TOUCH_NUMBER] = GOODIX_TOUCH_COUNT_MASK;
+    ConfigSeal(config);
+    ConfigRefused(config, __LINE__);
+
+    ConfigBlock(config);
+    config[GOODIX_CONFIG_X_OUTPUT_MAX] = 0;
+    config[GOODIX_CONFIG_X_OUTPUT_MAX + 1] = 0;
+    ConfigSeal(config);
+    ConfigRefused(config, __LINE__);
+
+    ConfigBlock(config);
+    config[GOODIX_CONFIG_Y_OUTPUT_MAX] = 0;
+    config[GOODIX_CONFIG_Y_OUTPUT_MAX + 1] = 0;
+    ConfigSeal(config);
+    ConfigRefused(config, __LINE__);
+}
+
+int
+main(VOID)
+{
+    TestChecksum();
+    TestGood();
+    TestBad();
+
+    return HOST_TEST_RESULT("configtest");
+}
@@ -0,0 +1,162 @@
+/*++
+
+Module Name:
+
+    decodetest.c
+
+Abstract:
+
+    Differential test of GoodixDecodePoints, the SSE2/NEON decoder, against
+    GoodixDecodePointsScalar. For every frame length up to MAX_POINT_NUM,
+    every byte of every record is swept through all 256 values over a
+    random background, and a long run of fully random frames follows. The
+    output must match byte for byte, and nothing past the last point may
+    be written.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include "touchcore.h"
+#include "hosttest.h"
+
+#define DECODE_GUARD            16
+#define DECODE_RANDOM_FRAMES    1000000
+
+static ULONG64 DecodeSeed = 0x9E3779B97F4A7C15ULL;
+
+static ULONG64
+DecodeRandom(VOID)
+{
+    DecodeSeed ^= DecodeSeed << 13;
+    DecodeSeed ^= DecodeSeed >> 7;
+    DecodeSeed ^= DecodeSeed << 17;
+    return DecodeSeed;
+}
+
+static VOID
+DecodeFill(
+    _Out_writes_bytes_(length) UINT8* buffer,
+    _In_ ULONG length
+)
+{
+    for (ULONG i = 0; i < length; i++)
+        buffer[i] = (UINT8)DecodeRandom();
+}
+
+//
+// Decodes records both ways and compares. Returns FALSE on the first
+// mismatch so a sweep does not flood the log.
+//
+static BOOLEAN
+DecodeCompare(
+    _In_reads_bytes_(count * BYTES_PER_COORD) const UINT8* records,
+    _In_ UINT8 count
+)
+{
+    UINT8 vector[MAX_POINT_NUM * sizeof(inputpoint) + DECODE_GUARD];
+    UINT8 scalar[MAX_POINT_NUM * sizeof(inputpoint) + DECODE_GUARD];
+    ULONG length = count * sizeof(inputpoint);
+
+    RtlFillMemory(vector, sizeof(vector), 0xA5);
+    RtlFillMemory(scalar, sizeof(scalar), 0xA5);
+
+    GoodixDecodePoints(records, count, vector);
+    GoodixDecodePointsScalar(records, count, scalar);
+
+    if (RtlCompareMemory(vector, scalar, length) != length)
+    {
+        fprintf(stderr, "decode mismatch, %u records\n", count);
+        HostTestFailures++;
+        return FALSE;
+    }
+
+    for (ULONG i = length; i < sizeof(vector); i++)
+    {
+        if (vector[i] != 0xA5)
+        {
+            fprintf(stderr, "decode wrote byte %lu past %u points\n", (unsigned long)i, count);
+            HostTestFailures++;
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static VOID
+TestSweep(VOID)
+{
+    //
+    // The vector path loads 32 bytes per step, so keep the records at the
+    // front of a buffer that is exactly MAX_POINT_NUM records long.
+    //
+    UINT8 records[MAX_POINT_NUM * BYTES_PER_COORD];
+
+    for (UINT8 count = 0; count <= MAX_POINT_NUM; count++)
+    {
+        for (ULONG byte = 0; byte < (ULONG)count * BYTES_PER_COORD; byte++)
+        {
+            DecodeFill(records, sizeof(records));
+
+            for (ULONG value = 0; value < 256; value++)
+            {
+                records[byte] = (UINT8)value;
+                if (!DecodeCompare(records, count))
+                    return;
+            }
+        }
+    }
+}
+
+static VOID
+TestRandom(VOID)
+{
+    UINT8 records[MAX_POINT_NUM * BYTES_PER_COORD];
+
+    for (ULONG frame = 0; frame < DECODE_RANDOM_FRAMES; frame++)
+    {
+        DecodeFill(records, sizeof(records));
+
+        if (!DecodeCompare(records, (UINT8)(DecodeRandom() % (MAX_POINT_NUM + 1))))
+            return;
+    }
+}
+
+static VOID
+TestLayout(VOID)
+{
+    //
+    // One known record, in each position of a four-record step.
+    //
+    UINT8 records[MAX_POINT_NUM * BYTES_PER_COORD] = { 0 };
+    UINT8 points[MAX_POINT_NUM * sizeof(inputpoint)];
+    const UINT8 record[BYTES_PER_COORD] = { 0x1B, 0x34, 0x12, 0x78, 0x56, 0x20, 0x00, 0xFF };
+
+    for (UINT8 slot = 0; slot < 4; slot++)
+    {
+        const UINT8* point = &points[slot * sizeof(inputpoint)];
+
+        RtlZeroMemory(records, sizeof(records));
+        RtlCopyMemory(&records[slot * BYTES_PER_COORD], record, sizeof(record));
+
+        GoodixDecodePoints(records, 4, points);
+
+        CHECK_EQ(point[0], 0x07);
+        CHECK_EQ(point[1], 0x0B);
+        CHECK_EQ(point[2] | (point[3] << 8), 0x1234);
+        CHECK_EQ(point[4] | (point[5] << 8), 0x5678);
+    }
+}
+
+int
+main(VOID)
+{
+    TestLayout();
+    TestSweep();
+    TestRandom();
+
+    return HOST_TEST_RESULT("decodetest");
+}
@@ -0,0 +1,232 @@
+/*++
+
+Module Name:
+
+    dozetest.c
+
+Abstract:
+
+    Host test of the idle governor's doze handshake. GoodixDozeEnter puts
+    the GT9xx model in doze, empty scans then raise no interrupt, and the
+    first touch wakes it through an interrupt handler that mirrors
+    OnInterruptIsr. The race where that wake reaches the controller ahead
+    of the doze command is replayed by running the handler from inside the
+    bus write that carries the command.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include "goodixsim.h"
+#include "hosttest.h"
+
+typedef struct _DOZE_HOST
+{
+    GOODIX_SIM              Sim;
+    TOUCH_BUS               Bus;
+    volatile LONG           Dozing;
+    ULONG                   Interrupts;
+    ULONG                   Frames;
+    ULONG                   Wakes;
+
+    //
+    // Service a wake before the next doze command reaches the model.
+    //
+    BOOLEAN                 WakeBeforeDoze;
+} DOZE_HOST, *PDOZE_HOST;
+
+static NTSTATUS
+DozeBusTransfer(
+    _Inout_ PDOZE_HOST Host,
+    _In_ USHORT Address,
+    _In_reads_bytes_(Length) const UINT8* Buffer,
+    _In_ ULONG Length
+)
+{
+    UCHAR tx[GOODIX_ADDR_LEN + 8];
+
+    if (Length > sizeof(tx) - GOODIX_ADDR_LEN)
+        return STATUS_INVALID_PARAMETER;
+
+    tx[0] = (UCHAR)(Address >> 8);
+    tx[1] = (UCHAR)Address;
+    RtlCopyMemory(&tx[GOODIX_ADDR_LEN], Buffer, Length);
+
+    return GoodixSimTransfer(&Host->Sim, tx, GOODIX_ADDR_LEN + Length, NULL, 0);
+}
+
+static NTSTATUS
+DozeBusRead(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _Out_writes_bytes_(Length) UINT8* Buffer,
+    _In_ ULONG Length,
+    _In_ BOOLEAN Clear
+)
+{
+    PDOZE_HOST host = (PDOZE_HOST)Context;
+    UCHAR tx[GOODIX_ADDR_LEN];
+    UINT8 clear = 0;
+    NTSTATUS status;
+
+    tx[0] = (UCHAR)(Address >> 8);
+    tx[1] = (UCHAR)Address;
+
+    status = GoodixSimTransfer(&host->Sim, tx, sizeof(tx), Buffer, Length);
+    if (NT_SUCCESS(status) && Clear)
+        status = DozeBusTransfer(host, TOUCH_INFO_ADDR, &clear, 1);
+
+    return status;
+}
+
+static VOID
+DozeWake(
+    _Inout_ PDOZE_HOST Host
+)
+{
+    UINT8 command = GOODIX_CMD_READ_COORDS;
+
+    DozeBusTransfer(Host, GOODIX_REG_COMMAND, &command, 1);
+    Host->Wakes++;
+}
+
+static NTSTATUS
+DozeBusWrite(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _In_reads_bytes_(Length) const UINT8* Buffer,
+    _In_ ULONG Length
+)
+{
+    PDOZE_HOST host = (PDOZE_HOST)Context;
+
+    if (host->WakeBeforeDoze && Address == GOODIX_REG_COMMAND && Buffer[0] == GOODIX_CMD_DOZE)
+    {
+        host->WakeBeforeDoze = FALSE;
+
+        if (InterlockedExchange(&host->Dozing, 0) != 0)
+            DozeWake(host);
+    }
+
+    return DozeBusTransfer(host, Address, Buffer, Length);
+}
+
+//
+// Same steps as OnInterruptIsr: note the wake, read and clear the frame,
+// then put the controller back to full rate.
+//
+static VOID
+DozeInterrupt(
+    _In_opt_ PVOID Context
+)
+{
+    PDOZE_HOST host = (PDOZE_HOST)Context;
+    UINT8 frame[TOUCH_READ_SIZE];
+    UINT8 count;
+    ULONG events;
+    BOOLEAN woke;
+
+    host->Interrupts++;
+
+    woke = host->Dozing && InterlockedExchange(&host->Dozing, 0) != 0;
+
+    if (NT_SUCCESS(GoodixReadFrameFrom(&host->Bus, MAX_POINT_NUM, FALSE, frame, &count, &events)))
+        host->Frames++;
+
+    if (woke)
+        DozeWake(host);
+}
+
+static VOID
+DozeHostInit(
+    _Out_ PDOZE_HOST Host
+)
+{
+    RtlZeroMemory(Host, sizeof(DOZE_HOST));
+    GoodixSimInit(&Host->Sim, 1280, 800, MAX_POINT_NUM);
+
+    Host->Sim.Interrupt = DozeInterrupt;
+    Host->Sim.InterruptContext = Host;
+    Host->Bus.Context = Host;
+    Host->Bus.Read = DozeBusRead;
+    Host->Bus.Write = DozeBusWrite;
+}
+
+static UCHAR
+Command(
+    _In_ PDOZE_HOST Host
+)
+{
+    return Host->Sim.Registers[GOODIX_REG_COMMAND - GOODIX_SIM_REG_FIRST];
+}
+
+static VOID
+TestDozeAndWake(VOID)
+{
+    DOZE_HOST host;
+    GOODIX_SIM_CONTACT contact = { 1, 100, 200, 10 };
+
+    DozeHostInit(&host);
+
+    GoodixSimScan(&host.Sim, NULL, 0);
+    CHECK_EQ(host.Interrupts, 1);
+
+    CHECK_EQ(GoodixDozeEnter(&host.Bus, &host.Dozing), STATUS_SUCCESS);
+    CHECK_EQ(host.Dozing, 1);
+    CHECK_EQ(Command(&host), GOODIX_CMD_DOZE);
+
+    //
+    // empty scans in doze raise no interrupt
+    //
+    for (int i = 0; i < 5; i++)
+        GoodixSimScan(&host.Sim, NULL, 0);
+    CHECK_EQ(host.Interrupts, 1);
+    CHECK_EQ(host.Sim.DozeScans, 5);
+
+    //
+    // the first touch is reported and wakes the controller
+    //
+    GoodixSimScan(&host.Sim, &contact, 1);
+    CHECK_EQ(host.Interrupts, 2);
+    CHECK_EQ(host.Frames, 2);
+    CHECK_EQ(host.Wakes, 1);
+    CHECK_EQ(host.Dozing, 0);
+    CHECK_EQ(Command(&host), GOODIX_CMD_READ_COORDS);
+
+    GoodixSimScan(&host.Sim, NULL, 0);
+    CHECK_EQ(host.Interrupts, 3);
+    CHECK_EQ(host.Sim.DozeScans, 5);
+}
+
+static VOID
+TestWakeAheadOfDoze(VOID)
+{
+    DOZE_HOST host;
+
+    DozeHostInit(&host);
+
+    //
+    // The wake lands before the doze command; the controller must still
+    // end up reporting at full rate with Dozing clear.
+    //
+    host.WakeBeforeDoze = TRUE;
+    CHECK_EQ(GoodixDozeEnter(&host.Bus, &host.Dozing), STATUS_SUCCESS);
+    CHECK_EQ(host.Wakes, 1);
+    CHECK_EQ(host.Dozing, 0);
+    CHECK_EQ(Command(&host), GOODIX_CMD_READ_COORDS);
+
+    GoodixSimScan(&host.Sim, NULL, 0);
+    CHECK_EQ(host.Interrupts, 1);
+    CHECK_EQ(host.Sim.DozeScans, 0);
+}
+
+int
+main(VOID)
+{
+    TestDozeAndWake();
+    TestWakeAheadOfDoze();
+
+    return HOST_TEST_RESULT("dozetest");
+}
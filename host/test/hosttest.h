@@ -0,0 +1,51 @@
+/*++
+
+Module Name:
+
+    hosttest.h
+
+Abstract:
+
+    Minimal check macros shared by the host tests. A failed check prints
+    where it failed and marks the test failed; the test keeps going so one
+    run reports every broken expectation.
+
+Environment:
+
+    User mode
+
+--*/
+
+#ifndef __HOSTTEST_H__
+#define __HOSTTEST_H__
+
+#include <stdio.h>
+
+static int HostTestFailures;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                    \
+                    __FILE__, __LINE__, #cond);                             \
+            HostTestFailures++;                                             \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                          \
+    do {                                                                    \
+        long long a_ = (long long)(actual);                                 \
+        long long e_ = (long long)(expected);                               \
+        if (a_ != e_) {                                                     \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n",           \
+                    __FILE__, __LINE__, #actual, a_, e_);                   \
+            HostTestFailures++;                                             \
+        }                                                                   \
+    } while (0)
+
+#define HOST_TEST_RESULT(name)                                              \
+    (HostTestFailures == 0                                                  \
+        ? (printf("%s: passed\n", name), 0)                                 \
+        : (printf("%s: %d check(s) failed\n", name, HostTestFailures), 1))
+
+#endif // __HOSTTEST_H__
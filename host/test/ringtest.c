@@ -0,0 +1,222 @@
+/*++
+
+Module Name:
+
+    ringtest.c
+
+Abstract:
+
+    Host test of the report ring: FIFO order and the full condition, motion
+    coalescing, and carrying lifts over with TouchReportMergeLifts when a
+    report is dropped on overflow.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include "touchcore.h"
+#include "hosttest.h"
+
+static VOID
+MakeReport(
+    _Out_ inputReport54_t* Report,
+    _In_ const UCHAR* ids,
+    _In_ const UCHAR* tips,
+    _In_ UCHAR count,
+    _In_ USHORT x
+)
+{
+    inputpoint* point = (inputpoint*)Report->points;
+
+    RtlZeroMemory(Report, sizeof(inputReport54_t));
+    Report->reportId = TOUCH_REPORT_ID;
+    Report->DIG_TouchScreenContactCount = count;
+
+    for (UCHAR i = 0; i < count; i++)
+    {
+        point[i].DIG_TouchScreenFingerState = tips[i] ? 0x07 : 0x06;
+        point[i].DIG_TouchScreenFingerContactIdentifier = ids[i];
+        point[i].GD_TouchScreenFingerXL = (BYTE)(x & 0xFF);
+        point[i].GD_TouchScreenFingerXH = (BYTE)(x >> 8);
+    }
+}
+
+static USHORT
+ReportX(
+    _In_ const inputReport54_t* Report,
+    _In_ UCHAR index
+)
+{
+    const inputpoint* point = (const inputpoint*)Report->points;
+
+    return (USHORT)(point[index].GD_TouchScreenFingerXL | (point[index].GD_TouchScreenFingerXH << 8));
+}
+
+static VOID
+TestFifo(VOID)
+{
+    REPORT_RING_CELL cells[4];
+    REPORT_RING ring;
+    inputReport54_t report;
+    REPORT_TIMES times = { 0 };
+    const UCHAR ids[] = { 1 };
+    const UCHAR down[] = { 1 };
+
+    ReportRingInit(&ring, cells, ARRAYSIZE(cells));
+
+    CHECK(!ReportRingPop(&ring, &report, &times));
+
+    for (USHORT i = 0; i < 4; i++)
+    {
+        MakeReport(&report, ids, down, 1, i);
+        times.Interrupt = i;
+        CHECK(ReportRingPush(&ring, &report, &times));
+    }
+
+    MakeReport(&report, ids, down, 1, 4);
+    CHECK(!ReportRingPush(&ring, &report, &times));
+
+    //
+    // wrap around several times
+    //
+    for (USHORT i = 0; i < 20; i++)
+    {
+        CHECK(ReportRingPop(&ring, &report, &times));
+        CHECK_EQ(ReportX(&report, 0), i);
+        CHECK_EQ(times.Interrupt, i);
+
+        MakeReport(&report, ids, down, 1, i + 4);
+        times.Interrupt = i + 4;
+        CHECK(ReportRingPush(&ring, &report, &times));
+    }
+}
+
+static VOID
+TestCoalesce(VOID)
+{
+    REPORT_RING_CELL cells[8];
+    REPORT_RING ring;
+    inputReport54_t report;
+    REPORT_TIMES times = { 0 };
+    const UCHAR ids[] = { 1, 2 };
+    const UCHAR down[] = { 1, 1 };
+    const UCHAR lift[] = { 1, 0 };
+
+    ReportRingInit(&ring, cells, ARRAYSIZE(cells));
+
+    MakeReport(&report, ids, down, 2, 10);
+    ReportRingPush(&ring, &report, &times);
+    MakeReport(&report, ids, down, 2, 11);
+    ReportRingPush(&ring, &report, &times);
+    MakeReport(&report, ids, lift, 2, 12);
+    ReportRingPush(&ring, &report, &times);
+    MakeReport(&report, ids, down, 1, 13);
+    ReportRingPush(&ring, &report, &times);
+
+    //
+    // the two motion reports merge, the lift stops the merge
+    //
+    CHECK(ReportRingPop(&ring, &report, &times));
+    CHECK(ReportRingPopMotion(&ring, &report, &times));
+    CHECK_EQ(ReportX(&report, 0), 11);
+    CHECK(!ReportRingPopMotion(&ring, &report, &times));
+
+    CHECK(ReportRingPop(&ring, &report, &times));
+    CHECK_EQ(ReportX(&report, 0), 12);
+    CHECK(!ReportRingPopMotion(&ring, &report, &times));
+
+    //
+    // a different contact set is not merged either
+    //
+    CHECK(ReportRingPop(&ring, &report, &times));
+    CHECK_EQ(report.DIG_TouchScreenContactCount, 1);
+    CHECK(!ReportRingPop(&ring, &report, &times));
+}
+
+static VOID
+TestMergeLifts(VOID)
+{
+    inputReport54_t older;
+    inputReport54_t newer;
+    inputpoint* point = (inputpoint*)newer.points;
+
+    //
+    // lift of 2 carried over behind the contacts still down
+    //
+    {
+        const UCHAR oldIds[] = { 1, 2 };
+        const UCHAR oldTips[] = { 1, 0 };
+        const UCHAR newIds[] = { 1 };
+        const UCHAR newTips[] = { 1 };
+
+        MakeReport(&older, oldIds, oldTips, 2, 100);
+        MakeReport(&newer, newIds, newTips, 1, 200);
+
+        CHECK(TouchReportMergeLifts(&older, &newer, MAX_POINT_NUM));
+        CHECK_EQ(newer.DIG_TouchScreenContactCount, 2);
+        CHECK_EQ(point[1].DIG_TouchScreenFingerContactIdentifier, 2);
+        CHECK_EQ(point[1].DIG_TouchScreenFingerState & 0x01, 0);
+        CHECK_EQ(ReportX(&newer, 1), 100);
+    }
+
+    //
+    // track ID down again in the newer report: the lift replaces it
+    //
+    {
+        const UCHAR oldIds[] = { 3 };
+        const UCHAR oldTips[] = { 0 };
+        const UCHAR newIds[] = { 3, 4 };
+        const UCHAR newTips[] = { 1, 1 };
+
+        MakeReport(&older, oldIds, oldTips, 1, 100);
+        MakeReport(&newer, newIds, newTips, 2, 200);
+
+        CHECK(TouchReportMergeLifts(&older, &newer, MAX_POINT_NUM));
+        CHECK_EQ(newer.DIG_TouchScreenContactCount, 2);
+        CHECK_EQ(point[0].DIG_TouchScreenFingerState & 0x01, 0);
+        CHECK_EQ(ReportX(&newer, 0), 100);
+    }
+
+    //
+    // already lifted in the newer report: nothing to add
+    //
+    {
+        const UCHAR ids[] = { 5 };
+        const UCHAR tips[] = { 0 };
+
+        MakeReport(&older, ids, tips, 1, 100);
+        MakeReport(&newer, ids, tips, 1, 200);
+
+        CHECK(TouchReportMergeLifts(&older, &newer, MAX_POINT_NUM));
+        CHECK_EQ(newer.DIG_TouchScreenContactCount, 1);
+        CHECK_EQ(ReportX(&newer, 0), 200);
+    }
+
+    //
+    // no room left in the newer report
+    //
+    {
+        const UCHAR oldIds[] = { 6 };
+        const UCHAR oldTips[] = { 0 };
+        const UCHAR newIds[] = { 1, 2 };
+        const UCHAR newTips[] = { 1, 1 };
+
+        MakeReport(&older, oldIds, oldTips, 1, 100);
+        MakeReport(&newer, newIds, newTips, 2, 200);
+
+        CHECK(!TouchReportMergeLifts(&older, &newer, 2));
+        CHECK_EQ(newer.DIG_TouchScreenContactCount, 2);
+    }
+}
+
+int
+main(VOID)
+{
+    TestFifo();
+    TestCoalesce();
+    TestMergeLifts();
+
+    return HOST_TEST_RESULT("ringtest");
+}
@@ -0,0 +1,387 @@
+/*++
+
+Module Name:
+
+    simtest.c
+
+Abstract:
+
+    Host test of the frame read and clear logic in GoodixReadFrameFrom,
+    driven against the GT9xx model in goodixsim.c through a TOUCH_BUS.
+    The bus can fail or corrupt reads, and the model can drop clears, so
+    the test covers the top-up, short frame, checksum re-read and missed
+    clear paths as well as the plain fused read.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include "goodixsim.h"
+#include "hosttest.h"
+
+//
+// TOUCH_BUS over the model, with fault injection: the read that is
+// operation FailOp since the log was reset fails, and the next CorruptReads
+// reads have a bit flipped in their last record. Log records the bus
+// operations in order: 'R' read, 'F' read fused with the clear, 'W' write.
+//
+typedef struct _SIM_BUS
+{
+    GOODIX_SIM              Sim;
+    ULONG                   FailOp;
+    ULONG                   CorruptReads;
+    ULONG                   Ops;
+    CHAR                    Log[16];
+} SIM_BUS, *PSIM_BUS;
+
+static VOID
+SimBusLog(
+    _Inout_ PSIM_BUS Bus,
+    _In_ CHAR Op
+)
+{
+    if (Bus->Ops < sizeof(Bus->Log) - 1)
+        Bus->Log[Bus->Ops] = Op;
+    Bus->Ops++;
+}
+
+static NTSTATUS
+SimBusRead(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _Out_writes_bytes_(Length) UINT8* Buffer,
+    _In_ ULONG Length,
+    _In_ BOOLEAN Clear
+)
+{
+    PSIM_BUS bus = (PSIM_BUS)Context;
+    UCHAR tx[GOODIX_ADDR_LEN + 1];
+    NTSTATUS status;
+
+    SimBusLog(bus, Clear ? 'F' : 'R');
+
+    if (bus->Ops == bus->FailOp)
+        return STATUS_IO_DEVICE_ERROR;
+
+    tx[0] = (UCHAR)(Address >> 8);
+    tx[1] = (UCHAR)Address;
+
+    status = GoodixSimTransfer(&bus->Sim, tx, GOODIX_ADDR_LEN, Buffer, Length);
+    if (!NT_SUCCESS(status))
+        return status;
+
+    if (bus->CorruptReads != 0)
+    {
+        bus->CorruptReads--;
+        Buffer[Length - 1 - BYTES_CHKSUM] ^= 0x10;
+    }
+
+    if (Clear)
+    {
+        tx[0] = (TOUCH_INFO_ADDR >> 8) & 0xFF;
+        tx[1] = TOUCH_INFO_ADDR & 0xFF;
+        tx[2] = 0;
+        status = GoodixSimTransfer(&bus->Sim, tx, sizeof(tx), NULL, 0);
+    }
+
+    return status;
+}
+
+static NTSTATUS
+SimBusWrite(
+    _In_ PVOID Context,
+    _In_ USHORT Address,
+    _In_reads_bytes_(Length) const UINT8* Buffer,
+    _In_ ULONG Length
+)
+{
+    PSIM_BUS bus = (PSIM_BUS)Context;
+    UCHAR tx[GOODIX_ADDR_LEN + 8];
+
+    SimBusLog(bus, 'W');
+
+    if (Length > sizeof(tx) - GOODIX_ADDR_LEN)
+        return STATUS_INVALID_PARAMETER;
+
+    tx[0] = (UCHAR)(Address >> 8);
+    tx[1] = (UCHAR)Address;
+    RtlCopyMemory(&tx[GOODIX_ADDR_LEN], Buffer, Length);
+
+    return GoodixSimTransfer(&bus->Sim, tx, GOODIX_ADDR_LEN + Length, NULL, 0);
+}
+
+static VOID
+SimBusInit(
+    _Out_ PSIM_BUS Bus,
+    _Out_ PTOUCH_BUS TouchBus
+)
+{
+    RtlZeroMemory(Bus, sizeof(SIM_BUS));
+    GoodixSimInit(&Bus->Sim, 1280, 800, MAX_POINT_NUM);
+
+    TouchBus->Context = Bus;
+    TouchBus->Read = SimBusRead;
+    TouchBus->Write = SimBusWrite;
+}
+
+static VOID
+SimBusResetLog(
+    _Inout_ PSIM_BUS Bus
+)
+{
+    Bus->Ops = 0;
+    RtlZeroMemory(Bus->Log, sizeof(Bus->Log));
+}
+
+static VOID
+Scan(
+    _Inout_ PSIM_BUS Bus,
+    _In_ UCHAR count,
+    _In_ USHORT x
+)
+{
+    GOODIX_SIM_CONTACT contacts[MAX_POINT_NUM];
+
+    for (UCHAR i = 0; i < count; i++)
+    {
+        contacts[i].Id = i;
+        contacts[i].X = (USHORT)(x + i * 100);
+        contacts[i].Y = (USHORT)(50 + i);
+        contacts[i].Size = 20;
+    }
+
+    GoodixSimScan(&Bus->Sim, contacts, count);
+}
+
+static USHORT
+RecordX(
+    _In_ const UINT8* frame,
+    _In_ UCHAR index
+)
+{
+    const UINT8* record = &frame[1 + index * BYTES_PER_COORD];
+
+    return (USHORT)(record[1] | (record[2] << 8));
+}
+
+static VOID
+TestFusedRead(VOID)
+{
+    SIM_BUS bus;
+    TOUCH_BUS touchBus;
+    UINT8 frame[TOUCH_READ_SIZE];
+    UINT8 count;
+    ULONG events;
+
+    SimBusInit(&bus, &touchBus);
+
+    Scan(&bus, 2, 300);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 2, FALSE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(count, 2);
+    CHECK_EQ(events, GOODIX_FRAME_CLEARED);
+    CHECK_EQ(RecordX(frame, 0), 300);
+    CHECK_EQ(RecordX(frame, 1), 400);
+    CHECK_EQ(bus.Ops, 1);
+    CHECK_EQ(bus.Sim.Clears, 1);
+
+    //
+    // fewer contacts than fetched needs nothing more
+    //
+    SimBusResetLog(&bus);
+    Scan(&bus, 1, 500);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 2, FALSE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(count, 1);
+    CHECK_EQ(RecordX(frame, 0), 500);
+    CHECK_EQ(bus.Ops, 1);
+
+    //
+    // lift of every contact
+    //
+    Scan(&bus, 0, 0);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 1, FALSE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(count, 0);
+    CHECK_EQ(frame[0], GOODIX_TOUCH_EVENT);
+
+    CHECK_EQ(bus.Sim.FramesHeld, 0);
+}
+
+static VOID
+TestShortFrame(VOID)
+{
+    SIM_BUS bus;
+    TOUCH_BUS touchBus;
+    UINT8 frame[TOUCH_READ_SIZE];
+    UINT8 count;
+    ULONG events;
+
+    SimBusInit(&bus, &touchBus);
+
+    //
+    // The clear went out with the read, so the remainder is not read: the
+    // frame is dropped and the next read fetches enough records.
+    //
+    Scan(&bus, 4, 100);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 1, FALSE, frame, &count, &events), STATUS_DEVICE_DATA_ERROR);
+    CHECK_EQ(count, 0);
+    CHECK_EQ(events, GOODIX_FRAME_CLEARED | GOODIX_FRAME_SHORT);
+    CHECK_EQ(frame[0] & GOODIX_TOUCH_COUNT_MASK, 4);
+    CHECK_EQ(bus.Ops, 1);
+
+    Scan(&bus, 4, 110);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 4, FALSE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(count, 4);
+    CHECK_EQ(RecordX(frame, 3), 410);
+    CHECK_EQ(bus.Sim.FramesHeld, 0);
+}
+
+static VOID
+TestTopUp(VOID)
+{
+    SIM_BUS bus;
+    TOUCH_BUS touchBus;
+    UINT8 frame[TOUCH_READ_SIZE];
+    UINT8 count;
+    ULONG events;
+
+    SimBusInit(&bus, &touchBus);
+
+    //
+    // With checksum the remainder is read first and the clear written last.
+    //
+    Scan(&bus, 5, 100);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 2, TRUE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(count, 5);
+    CHECK_EQ(events, GOODIX_FRAME_TOP_UP | GOODIX_FRAME_CLEARED);
+    CHECK(strcmp(bus.Log, "RRW") == 0);
+    CHECK_EQ(RecordX(frame, 4), 500);
+    CHECK(GoodixFrameValid(frame, count));
+    CHECK_EQ(bus.Sim.Clears, 1);
+
+    Scan(&bus, 1, 100);
+    CHECK_EQ(bus.Sim.FramesHeld, 0);
+}
+
+static VOID
+TestChecksum(VOID)
+{
+    SIM_BUS bus;
+    TOUCH_BUS touchBus;
+    UINT8 frame[TOUCH_READ_SIZE];
+    UINT8 count;
+    ULONG events;
+
+    SimBusInit(&bus, &touchBus);
+
+    //
+    // one bad read: the re-read comes before the clear and succeeds
+    //
+    Scan(&bus, 3, 100);
+    bus.CorruptReads = 1;
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 3, TRUE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(count, 3);
+    CHECK_EQ(events, GOODIX_FRAME_REREAD | GOODIX_FRAME_CLEARED);
+    CHECK(strcmp(bus.Log, "RRW") == 0);
+    CHECK_EQ(RecordX(frame, 2), 300);
+
+    //
+    // two bad reads: the frame is dropped but still cleared
+    //
+    SimBusResetLog(&bus);
+    Scan(&bus, 3, 200);
+    bus.CorruptReads = 2;
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 3, TRUE, frame, &count, &events), STATUS_CRC_ERROR);
+    CHECK_EQ(count, 0);
+    CHECK_EQ(events, GOODIX_FRAME_REREAD | GOODIX_FRAME_CORRUPT | GOODIX_FRAME_CLEARED);
+    CHECK(strcmp(bus.Log, "RRW") == 0);
+
+    Scan(&bus, 1, 300);
+    CHECK_EQ(bus.Sim.FramesHeld, 0);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 3, TRUE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(count, 1);
+    CHECK_EQ(RecordX(frame, 0), 300);
+}
+
+static VOID
+TestBusFailure(VOID)
+{
+    SIM_BUS bus;
+    TOUCH_BUS touchBus;
+    UINT8 frame[TOUCH_READ_SIZE];
+    UINT8 count;
+    ULONG events;
+    UINT8 clear = 0;
+
+    SimBusInit(&bus, &touchBus);
+
+    //
+    // A failed first read leaves the clear to the caller.
+    //
+    Scan(&bus, 2, 100);
+    bus.FailOp = 1;
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 2, FALSE, frame, &count, &events), STATUS_IO_DEVICE_ERROR);
+    CHECK_EQ(events, 0);
+    CHECK_EQ(bus.Sim.Clears, 0);
+    CHECK_EQ(touchBus.Write(touchBus.Context, TOUCH_INFO_ADDR, &clear, 1), STATUS_SUCCESS);
+    CHECK_EQ(bus.Sim.Clears, 1);
+
+    //
+    // A failed top-up still clears.
+    //
+    SimBusResetLog(&bus);
+    Scan(&bus, 4, 100);
+    bus.FailOp = 2;
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 2, TRUE, frame, &count, &events), STATUS_IO_DEVICE_ERROR);
+    CHECK_EQ(count, 0);
+    CHECK_EQ(events, GOODIX_FRAME_TOP_UP | GOODIX_FRAME_CLEARED);
+    CHECK(strcmp(bus.Log, "RRW") == 0);
+    CHECK_EQ(bus.Sim.Clears, 2);
+    CHECK_EQ(bus.Sim.FramesHeld, 0);
+}
+
+static VOID
+TestMissedClear(VOID)
+{
+    SIM_BUS bus;
+    TOUCH_BUS touchBus;
+    UINT8 frame[TOUCH_READ_SIZE];
+    UINT8 count;
+    ULONG events;
+
+    SimBusInit(&bus, &touchBus);
+
+    //
+    // The clear is lost: the next scan is held and the same frame is read
+    // again, whose clear then releases the buffer.
+    //
+    Scan(&bus, 1, 100);
+    bus.Sim.IgnoreClears = 1;
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 1, FALSE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(RecordX(frame, 0), 100);
+    CHECK_EQ(bus.Sim.Clears, 0);
+
+    Scan(&bus, 1, 200);
+    CHECK_EQ(bus.Sim.FramesHeld, 1);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 1, FALSE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(RecordX(frame, 0), 100);
+    CHECK_EQ(bus.Sim.Clears, 1);
+
+    Scan(&bus, 1, 300);
+    CHECK_EQ(bus.Sim.FramesHeld, 1);
+    CHECK_EQ(GoodixReadFrameFrom(&touchBus, 1, FALSE, frame, &count, &events), STATUS_SUCCESS);
+    CHECK_EQ(RecordX(frame, 0), 300);
+}
+
+int
+main(VOID)
+{
+    TestFusedRead();
+    TestShortFrame();
+    TestTopUp();
+    TestChecksum();
+    TestBusFailure();
+    TestMissedClear();
+
+    return HOST_TEST_RESULT("simtest");
+}
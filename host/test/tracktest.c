@@ -0,0 +1,252 @@
+/*++
+
+Module Name:
+
+    tracktest.c
+
+Abstract:
+
+    Host test of the contact tracker: a contact that leaves is lifted once,
+    where it was last reported; lifts that do not fit in the report carry
+    over to the next one; a track ID repeated within a frame is kept once;
+    and a contact that comes back while its lift is still pending is never
+    lifted.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include "touchcore.h"
+#include "hosttest.h"
+
+typedef struct _TRACK_FRAME
+{
+    inputpoint              Points[MAX_POINT_NUM];
+    UINT8                   Count;
+} TRACK_FRAME, *PTRACK_FRAME;
+
+static VOID
+TrackFrame(
+    _Out_ PTRACK_FRAME Frame,
+    _In_reads_(Count) const UCHAR* Ids,
+    _In_ UINT8 Count,
+    _In_ USHORT X
+)
+{
+    RtlZeroMemory(Frame, sizeof(TRACK_FRAME));
+    Frame->Count = Count;
+
+    for (UINT8 i = 0; i < Count; i++)
+    {
+        Frame->Points[i].DIG_TouchScreenFingerState = 0x07;
+        Frame->Points[i].DIG_TouchScreenFingerContactIdentifier = Ids[i];
+        Frame->Points[i].GD_TouchScreenFingerXL = (BYTE)((X + i) & 0xFF);
+        Frame->Points[i].GD_TouchScreenFingerXH = (BYTE)((X + i) >> 8);
+    }
+}
+
+static USHORT
+TrackX(
+    _In_ const inputpoint* Point
+)
+{
+    return (USHORT)(Point->GD_TouchScreenFingerXL | (Point->GD_TouchScreenFingerXH << 8));
+}
+
+//
+// Bit per ID of the points in the first Count with the tip down, or up.
+//
+static USHORT
+TrackIds(
+    _In_ const TRACK_FRAME* Frame,
+    _In_ UINT8 Count,
+    _In_ BOOLEAN Tip
+)
+{
+    USHORT ids = 0;
+
+    for (UINT8 i = 0; i < Count; i++)
+    {
+        if (((Frame->Points[i].DIG_TouchScreenFingerState & 0x01) != 0) == Tip)
+            ids |= (USHORT)(1 << Frame->Points[i].DIG_TouchScreenFingerContactIdentifier);
+    }
+
+    return ids;
+}
+
+static VOID
+TestLift(VOID)
+{
+    TOUCH_TRACKER tracker;
+    TRACK_FRAME frame;
+    const UCHAR both[] = { 3, 7 };
+    const UCHAR one[] = { 3 };
+    UINT8 count;
+
+    TouchTrackerReset(&tracker);
+
+    TrackFrame(&frame, both, 2, 100);
+    CHECK_EQ(TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, MAX_POINT_NUM), 2);
+    CHECK_EQ(tracker.ActiveMask, (1 << 3) | (1 << 7));
+
+    //
+    // 7 leaves: lifted at the position it was last reported at
+    //
+    TrackFrame(&frame, one, 1, 200);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, MAX_POINT_NUM);
+    CHECK_EQ(count, 2);
+    CHECK_EQ(TrackIds(&frame, count, TRUE), 1 << 3);
+    CHECK_EQ(TrackIds(&frame, count, FALSE), 1 << 7);
+    CHECK_EQ(TrackX(&frame.Points[1]), 101);
+    CHECK_EQ(tracker.ActiveMask, 1 << 3);
+
+    //
+    // and only once
+    //
+    TrackFrame(&frame, one, 1, 300);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, MAX_POINT_NUM);
+    CHECK_EQ(count, 1);
+    CHECK_EQ(TrackIds(&frame, count, FALSE), 0);
+
+    //
+    // the last contact goes, then there is nothing left to report
+    //
+    TrackFrame(&frame, NULL, 0, 0);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, MAX_POINT_NUM);
+    CHECK_EQ(count, 1);
+    CHECK_EQ(TrackIds(&frame, count, FALSE), 1 << 3);
+    CHECK_EQ(TrackX(&frame.Points[0]), 300);
+
+    TrackFrame(&frame, NULL, 0, 0);
+    CHECK_EQ(TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, MAX_POINT_NUM), 0);
+    CHECK_EQ(tracker.ActiveMask, 0);
+}
+
+static VOID
+TestCarryOver(VOID)
+{
+    TOUCH_TRACKER tracker;
+    TRACK_FRAME frame;
+    const UCHAR first[] = { 1, 2, 3 };
+    const UCHAR second[] = { 4, 5 };
+    const UCHAR third[] = { 4 };
+    USHORT lifted = 0;
+    UINT8 count;
+
+    TouchTrackerReset(&tracker);
+
+    TrackFrame(&frame, first, 3, 100);
+    CHECK_EQ(TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, 3), 3);
+
+    //
+    // The report is full with the new contacts; all three lifts wait.
+    //
+    TrackFrame(&frame, second, 2, 200);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, 2);
+    CHECK_EQ(count, 2);
+    CHECK_EQ(TrackIds(&frame, count, FALSE), 0);
+    CHECK_EQ(tracker.ActiveMask, 0x3E);
+
+    //
+    // One slot free: one lift per report until they are all out, 5's
+    // included now that it has left too.
+    //
+    for (ULONG n = 0; n < 4; n++)
+    {
+        TrackFrame(&frame, third, 1, 300);
+        count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, 2);
+        CHECK_EQ(count, 2);
+        CHECK_EQ(TrackIds(&frame, count, TRUE), 1 << 4);
+        CHECK((TrackIds(&frame, count, FALSE) & lifted) == 0);
+        lifted |= TrackIds(&frame, count, FALSE);
+    }
+
+    CHECK_EQ(lifted, (1 << 1) | (1 << 2) | (1 << 3) | (1 << 5));
+
+    TrackFrame(&frame, third, 1, 300);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, 2);
+    CHECK_EQ(count, 1);
+    CHECK_EQ(tracker.ActiveMask, 1 << 4);
+}
+
+static VOID
+TestDuplicate(VOID)
+{
+    TOUCH_TRACKER tracker;
+    TRACK_FRAME frame;
+    const UCHAR ids[] = { 2, 2, 6, 2 };
+    UINT8 count;
+
+    TouchTrackerReset(&tracker);
+
+    TrackFrame(&frame, ids, 4, 100);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, MAX_POINT_NUM);
+    CHECK_EQ(count, 2);
+    CHECK_EQ(frame.Points[0].DIG_TouchScreenFingerContactIdentifier, 2);
+    CHECK_EQ(TrackX(&frame.Points[0]), 100);
+    CHECK_EQ(frame.Points[1].DIG_TouchScreenFingerContactIdentifier, 6);
+    CHECK_EQ(TrackX(&frame.Points[1]), 102);
+    CHECK_EQ(tracker.ActiveMask, (1 << 2) | (1 << 6));
+
+    //
+    // the first occurrence is the one lifted from
+    //
+    TrackFrame(&frame, NULL, 0, 0);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, MAX_POINT_NUM);
+    CHECK_EQ(count, 2);
+    CHECK_EQ(TrackIds(&frame, count, FALSE), (1 << 2) | (1 << 6));
+    CHECK_EQ(TrackX(&frame.Points[0]), 100);
+}
+
+static VOID
+TestReturnBeforeLift(VOID)
+{
+    TOUCH_TRACKER tracker;
+    TRACK_FRAME frame;
+    const UCHAR down[] = { 1, 2 };
+    const UCHAR other[] = { 3 };
+    const UCHAR back[] = { 1, 3 };
+    UINT8 count;
+
+    TouchTrackerReset(&tracker);
+
+    TrackFrame(&frame, down, 2, 100);
+    CHECK_EQ(TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, 2), 2);
+
+    //
+    // 1 and 2 leave while the report has no room for their lifts
+    //
+    TrackFrame(&frame, other, 1, 200);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, 1);
+    CHECK_EQ(count, 1);
+    CHECK_EQ(TrackIds(&frame, count, FALSE), 0);
+
+    //
+    // 1 is back before its lift went out: it is reported down, never up,
+    // and the pending lift of 2 follows
+    //
+    TrackFrame(&frame, back, 2, 300);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, 3);
+    CHECK_EQ(count, 3);
+    CHECK_EQ(TrackIds(&frame, count, TRUE), (1 << 1) | (1 << 3));
+    CHECK_EQ(TrackIds(&frame, count, FALSE), 1 << 2);
+    CHECK_EQ(tracker.ActiveMask, (1 << 1) | (1 << 3));
+
+    TrackFrame(&frame, back, 2, 400);
+    count = TouchTrackerUpdate(&tracker, (UINT8*)frame.Points, frame.Count, 3);
+    CHECK_EQ(count, 2);
+    CHECK_EQ(TrackIds(&frame, count, FALSE), 0);
+}
+
+int
+main(VOID)
+{
+    TestLift();
+    TestCarryOver();
+    TestDuplicate();
+    TestReturnBeforeLift();
+
+    return HOST_TEST_RESULT("tracktest");
+}
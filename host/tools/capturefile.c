@@ -0,0 +1,255 @@
+/*++
+
+Module Name:
+
+    capturefile.c
+
+Abstract:
+
+    Capture file writer; see capturefile.h.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "capturefile.h"
+
+BOOLEAN
+CaptureFileCreate(
+    _Out_ PCAPTURE_FILE Capture,
+    _In_ const char* Path,
+    _In_ ULONGLONG PerfFrequency
+)
+/*++
+
+  Routine Description:
+
+    Creates the file and reserves room for the header.
+
+  Arguments:
+
+    Capture - receives the writer state
+
+    Path - file to create, replacing any existing one
+
+    PerfFrequency - ticks per second of the timestamps to be appended
+
+--*/
+{
+    TOUCH_CAPTURE_HEADER header = { 0 };
+
+    RtlZeroMemory(Capture, sizeof(CAPTURE_FILE));
+    TouchCaptureWriterInit(&Capture->Writer);
+    Capture->PerfFrequency = PerfFrequency;
+    Capture->Offset = sizeof(header);
+
+    Capture->File = fopen(Path, "wb");
+    if (Capture->File == NULL)
+    {
+        perror(Path);
+        return FALSE;
+    }
+
+    if (fwrite(&header, sizeof(header), 1, Capture->File) != 1)
+    {
+        perror(Path);
+        fclose(Capture->File);
+        Capture->File = NULL;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+BOOLEAN
+CaptureFileAppend(
+    _Inout_ PCAPTURE_FILE Capture,
+    _In_ LONGLONG Timestamp,
+    _In_reads_bytes_(1 + Count * BYTES_PER_COORD) const UINT8* Frame,
+    _In_ UCHAR Count
+)
+/*++
+
+  Routine Description:
+
+    Encodes one frame and appends its record.
+
+  Arguments:
+
+    Capture - the file, from CaptureFileCreate
+
+    Timestamp - performance counter value of the frame's interrupt
+
+    Frame - status byte followed by the point records
+
+    Count - number of point records in Frame
+
+--*/
+{
+    UCHAR record[TOUCH_CAPTURE_RECORD_MAX];
+    ULONG frame = Capture->Writer.FrameCount;
+    ULONG length;
+
+    if (frame == MAXULONG)
+        return FALSE;
+
+    if (frame == Capture->IndexCapacity)
+    {
+        ULONG capacity = max(Capture->IndexCapacity * 2, 4096);
+        ULONGLONG* index = realloc(Capture->Index, (size_t)capacity * sizeof(ULONGLONG));
+
+        if (index == NULL)
+            return FALSE;
+
+        Capture->Index = index;
+        Capture->IndexCapacity = capacity;
+    }
+
+    length = TouchCaptureEncodeFrame(&Capture->Writer, Timestamp, Frame, Count, record);
+
+    if (fwrite(record, 1, length, Capture->File) != length)
+        return FALSE;
+
+    Capture->Index[frame] = Capture->Offset;
+    Capture->Offset += length;
+
+    return TRUE;
+}
+
+BOOLEAN
+CaptureFileClose(
+    _Inout_ PCAPTURE_FILE Capture
+)
+/*++
+
+  Routine Description:
+
+    Writes the index and the header and closes the file. The writer state
+    is released whether or not that succeeds.
+
+  Return Value:
+
+    TRUE if the file was completed.
+
+--*/
+{
+    static const UCHAR padding[sizeof(ULONGLONG)] = { 0 };
+    TOUCH_CAPTURE_HEADER header = { 0 };
+    ULONG pad = (ULONG)((sizeof(ULONGLONG) - Capture->Offset % sizeof(ULONGLONG)) % sizeof(ULONGLONG));
+    BOOLEAN ok;
+
+    header.Magic = TOUCH_CAPTURE_MAGIC;
+    header.Version = TOUCH_CAPTURE_VERSION;
+    header.KeyInterval = TOUCH_CAPTURE_KEY_INTERVAL;
+    header.FrameCount = Capture->Writer.FrameCount;
+    header.PerfFrequency = Capture->PerfFrequency;
+    header.IndexOffset = Capture->Offset + pad;
+
+    ok = fwrite(padding, 1, pad, Capture->File) == pad &&
+         fwrite(Capture->Index, sizeof(ULONGLONG), header.FrameCount, Capture->File) == header.FrameCount &&
+         fseek(Capture->File, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, Capture->File) == 1;
+
+    if (fclose(Capture->File) != 0)
+        ok = FALSE;
+
+    free(Capture->Index);
+    RtlZeroMemory(Capture, sizeof(CAPTURE_FILE));
+
+    return ok;
+}
+
+BOOLEAN
+CaptureFileMap(
+    _Out_ PCAPTURE_MAP Map,
+    _In_ const char* Path
+)
+/*++
+
+  Routine Description:
+
+    Maps a capture file read-only and validates it. The mapping is page
+    aligned, as TouchCaptureOpen requires of the image.
+
+  Arguments:
+
+    Map - receives the mapping and the view of the capture
+
+    Path - capture file to map
+
+  Return Value:
+
+    TRUE if Map->View can be decoded from; the reason is printed otherwise.
+
+--*/
+{
+    struct stat status;
+    PVOID base;
+    int fd;
+
+    RtlZeroMemory(Map, sizeof(CAPTURE_MAP));
+
+    fd = open(Path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &status) != 0)
+    {
+        perror(Path);
+        if (fd >= 0)
+            close(fd);
+        return FALSE;
+    }
+
+    if (status.st_size < (off_t)sizeof(TOUCH_CAPTURE_HEADER))
+    {
+        fprintf(stderr, "%s: not a capture file\n", Path);
+        close(fd);
+        return FALSE;
+    }
+
+    base = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+    {
+        perror(Path);
+        return FALSE;
+    }
+
+    Map->Base = base;
+    Map->Length = (size_t)status.st_size;
+
+    if (!TouchCaptureOpen(base, (ULONGLONG)status.st_size, &Map->View))
+    {
+        fprintf(stderr, "%s: not a capture file\n", Path);
+        CaptureFileUnmap(Map);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+VOID
+CaptureFileUnmap(
+    _Inout_ PCAPTURE_MAP Map
+)
+/*++
+
+  Routine Description:
+
+    Releases a mapping from CaptureFileMap. Frames decoded from it stay
+    valid; the view does not.
+
+--*/
+{
+    if (Map->Base != NULL)
+        munmap(Map->Base, Map->Length);
+
+    RtlZeroMemory(Map, sizeof(CAPTURE_MAP));
+}
@@ -0,0 +1,80 @@
+/*++
+
+Module Name:
+
+    capturefile.h
+
+Abstract:
+
+    Writes capture files in the format of touchcapture.h. Records are
+    appended as the frames arrive and their offsets kept in memory; closing
+    the file pads the records, writes the index after them and fills in
+    the header, which is left zeroed until then so an unfinished file
+    never opens.
+
+    Finished files are read by mapping them and decoding frames in place,
+    as the format intends, so replaying a recording hours long neither
+    parses nor copies it up front.
+
+Environment:
+
+    User mode
+
+--*/
+
+#ifndef __CAPTUREFILE_H__
+#define __CAPTUREFILE_H__
+
+#include <stdio.h>
+
+#include "touchcapture.h"
+
+typedef struct _CAPTURE_FILE
+{
+    FILE*                   File;
+    TOUCH_CAPTURE_WRITER    Writer;
+    ULONGLONG               PerfFrequency;
+    ULONGLONG               Offset;             // end of the records written so far
+    ULONGLONG*              Index;
+    ULONG                   IndexCapacity;
+} CAPTURE_FILE, *PCAPTURE_FILE;
+
+typedef struct _CAPTURE_MAP
+{
+    PVOID                   Base;
+    size_t                  Length;
+    TOUCH_CAPTURE_VIEW      View;
+} CAPTURE_MAP, *PCAPTURE_MAP;
+
+BOOLEAN
+CaptureFileCreate(
+    _Out_ PCAPTURE_FILE Capture,
+    _In_ const char* Path,
+    _In_ ULONGLONG PerfFrequency
+);
+
+BOOLEAN
+CaptureFileAppend(
+    _Inout_ PCAPTURE_FILE Capture,
+    _In_ LONGLONG Timestamp,
+    _In_reads_bytes_(1 + Count * BYTES_PER_COORD) const UINT8* Frame,
+    _In_ UCHAR Count
+);
+
+BOOLEAN
+CaptureFileClose(
+    _Inout_ PCAPTURE_FILE Capture
+);
+
+BOOLEAN
+CaptureFileMap(
+    _Out_ PCAPTURE_MAP Map,
+    _In_ const char* Path
+);
+
+VOID
+CaptureFileUnmap(
+    _Inout_ PCAPTURE_MAP Map
+);
+
+#endif // __CAPTUREFILE_H__
@@ -0,0 +1,291 @@
+/*++
+
+Module Name:
+
+    hidcapture.c
+
+Abstract:
+
+    Records the raw frames the driver reads into a capture file (see
+    touchcapture.h), to be replayed on the host, for instance by
+    touchbench. From a device the tool starts capture, polls with
+    HIDMINI_CAPTURE_READ until the time is up or it is interrupted, then
+    stops capture. A dump of HIDMINI_CAPTURE_REPORTs saved on the target
+    can be converted the same way.
+
+    When done it prints one JSON object:
+
+        {"frames":F,"dropped":D}
+
+    dropped counts the frames the driver overwrote before they were read.
+    The tool keeps its read position itself, passing the NextSequence of
+    each report with the following READ.
+
+    Usage: hidcapture [-t seconds] <hidraw device> <capture file>
+           hidcapture <report dump> <capture file>
+
+    A dump of "-" is read from standard input.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include <signal.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "hidfeature.h"
+#include "capturefile.h"
+
+#define HID_CAPTURE_IDLE_US     2000        // wait after an empty report
+
+static volatile sig_atomic_t HidCaptureStop;
+
+typedef struct _HID_CAPTURE
+{
+    CAPTURE_FILE            File;
+    const char*             Path;
+    BOOLEAN                 Open;
+    ULONGLONG               Frames;
+    ULONGLONG               Dropped;
+    ULONG                   Sequence;           // next frame to read
+} HID_CAPTURE, *PHID_CAPTURE;
+
+static VOID
+HidCaptureSignal(
+    int Signal
+)
+{
+    UNREFERENCED_PARAMETER(Signal);
+    HidCaptureStop = 1;
+}
+
+static ULONGLONG
+HidCaptureNowNs(VOID)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ULONGLONG)now.tv_sec * 1000000000ULL + (ULONGLONG)now.tv_nsec;
+}
+
+//
+// Appends the frames of one report, creating the file on the first one
+// since the timestamp frequency comes with the reports.
+//
+static BOOLEAN
+HidCaptureAppend(
+    _Inout_ PHID_CAPTURE Capture,
+    _In_ const HIDMINI_CAPTURE_REPORT* Report
+)
+{
+    if (!Capture->Open)
+    {
+        if (!CaptureFileCreate(&Capture->File, Capture->Path, Report->PerfFrequency))
+            return FALSE;
+
+        Capture->Open = TRUE;
+    }
+
+    for (ULONG i = 0; i < min(Report->FrameCount, HIDMINI_CAPTURE_FRAMES_PER_REPORT); i++)
+    {
+        const HIDMINI_CAPTURE_FRAME* frame = &Report->Frames[i];
+        UCHAR length = min(frame->Length, HIDMINI_CAPTURE_FRAME_BYTES);
+        UCHAR count;
+
+        if (length == 0)
+            continue;
+
+        count = (UCHAR)min((length - 1) / BYTES_PER_COORD, MAX_POINT_NUM);
+
+        if (!CaptureFileAppend(&Capture->File, (LONGLONG)frame->Timestamp, frame->Bytes, count))
+        {
+            perror(Capture->Path);
+            return FALSE;
+        }
+
+        Capture->Frames++;
+    }
+
+    Capture->Dropped += Report->Dropped;
+    Capture->Sequence = Report->NextSequence;
+
+    return TRUE;
+}
+
+static BOOLEAN
+HidCaptureFinish(
+    _Inout_ PHID_CAPTURE Capture,
+    _In_ BOOLEAN Ok
+)
+{
+    HIDMINI_CAPTURE_REPORT empty = { 0 };
+
+    //
+    // A capture with no frames still gets a valid, empty file.
+    //
+    if (Ok && !Capture->Open)
+        Ok = HidCaptureAppend(Capture, &empty);
+
+    if (Capture->Open && !CaptureFileClose(&Capture->File))
+    {
+        fprintf(stderr, "%s: cannot complete the capture file\n", Capture->Path);
+        Ok = FALSE;
+    }
+
+    if (Ok)
+    {
+        printf("{\"frames\":%llu,\"dropped\":%llu}\n",
+               (unsigned long long)Capture->Frames,
+               (unsigned long long)Capture->Dropped);
+    }
+
+    return Ok;
+}
+
+static BOOLEAN
+HidCaptureFromDump(
+    _Inout_ PHID_CAPTURE Capture,
+    _In_ const char* Path
+)
+{
+    HIDMINI_CAPTURE_REPORT report;
+    FILE* file = strcmp(Path, "-") == 0 ? stdin : fopen(Path, "rb");
+    ULONG length;
+    BOOLEAN ok = TRUE;
+
+    if (file == NULL)
+    {
+        perror(Path);
+        return FALSE;
+    }
+
+    while ((length = HidFeatureLoad(file, &report, sizeof(report))) == sizeof(report))
+    {
+        if (!HidFeatureCheck((const UCHAR*)&report, HIDMINI_CONTROL_CODE_CAPTURE))
+        {
+            fprintf(stderr, "%s: not a capture report\n", Path);
+            ok = FALSE;
+            break;
+        }
+
+        if (!HidCaptureAppend(Capture, &report))
+        {
+            ok = FALSE;
+            break;
+        }
+    }
+
+    if (ok && length != 0)
+    {
+        fprintf(stderr, "%s: ends inside a report\n", Path);
+        ok = FALSE;
+    }
+
+    if (file != stdin)
+        fclose(file);
+
+    return ok;
+}
+
+static BOOLEAN
+HidCaptureFromDevice(
+    _Inout_ PHID_CAPTURE Capture,
+    _In_ const char* Path,
+    _In_ double Seconds
+)
+{
+    HIDMINI_CAPTURE_REPORT report;
+    HIDMINI_CONTROL_INFO control = { 0 };
+    ULONGLONG deadline = HidCaptureNowNs() + (ULONGLONG)(Seconds * 1e9);
+    BOOLEAN ok = TRUE;
+    int device;
+
+    device = HidFeatureOpen(Path);
+    if (device < 0)
+        return FALSE;
+
+    control.ReportId = CONTROL_COLLECTION_REPORT_ID;
+    control.ControlCode = HIDMINI_CONTROL_CODE_CAPTURE;
+    control.u.Capture.Mode = HIDMINI_CAPTURE_START;
+
+    if (!HidFeatureSet(device, &control))
+    {
+        HidFeatureClose(device);
+        return FALSE;
+    }
+
+    signal(SIGINT, HidCaptureSignal);
+    signal(SIGTERM, HidCaptureSignal);
+
+    control.u.Capture.Mode = HIDMINI_CAPTURE_READ;
+
+    while (!HidCaptureStop && (Seconds <= 0.0 || HidCaptureNowNs() < deadline))
+    {
+        control.u.Capture.Sequence = Capture->Sequence;
+
+        if (!HidFeatureRequest(device, &control, &report, sizeof(report)) ||
+            !HidCaptureAppend(Capture, &report))
+        {
+            ok = FALSE;
+            break;
+        }
+
+        if (report.FrameCount == 0)
+            usleep(HID_CAPTURE_IDLE_US);
+    }
+
+    control.u.Capture.Mode = HIDMINI_CAPTURE_STOP;
+    if (!HidFeatureSet(device, &control))
+        ok = FALSE;
+
+    HidFeatureClose(device);
+
+    return ok;
+}
+
+static int
+HidCaptureUsage(VOID)
+{
+    fprintf(stderr,
+            "usage: hidcapture [-t seconds] <hidraw device> <capture file>\n"
+            "       hidcapture <report dump> <capture file>\n");
+    return 2;
+}
+
+int
+main(int argc, char** argv)
+{
+    HID_CAPTURE capture = { 0 };
+    double seconds = 0.0;
+    BOOLEAN ok;
+    int arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-t") == 0)
+    {
+        seconds = strtod(argv[arg + 1], NULL);
+        arg += 2;
+    }
+
+    if (argc - arg != 2)
+        return HidCaptureUsage();
+
+    capture.Path = argv[arg + 1];
+
+    if (strncmp(argv[arg], HID_FEATURE_DEVICE_PREFIX, strlen(HID_FEATURE_DEVICE_PREFIX)) == 0)
+    {
+        ok = HidCaptureFromDevice(&capture, argv[arg], seconds);
+    }
+    else
+    {
+        if (seconds > 0.0)
+            return HidCaptureUsage();
+
+        ok = HidCaptureFromDump(&capture, argv[arg]);
+    }
+
+    return HidCaptureFinish(&capture, ok) ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+/*++
+
+Module Name:
+
+    hidcounters.c
+
+Abstract:
+
+    Reads the driver's performance counters (HIDMINI_COUNTERS_REPORT) and
+    prints them as one JSON object. The counters run from device start
+    and wrap, so given two snapshots, taken Interval seconds apart from a
+    device or as two report dumps, the tool prints the difference instead.
+    Fields that hold a last or largest value rather than a count are
+    printed as in the newer snapshot.
+
+    Usage: hidcounters [-i seconds] <hidraw device>
+           hidcounters <report dump> [newer report dump]
+
+    A dump of "-" is read from standard input.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hidfeature.h"
+
+typedef struct _HID_COUNTER
+{
+    const char*             Name;
+    LONG                    Offset;
+    BOOLEAN                 Gauge;
+} HID_COUNTER;
+
+#define HID_COUNTER_FIELD(f)    { #f, FIELD_OFFSET(HIDMINI_COUNTERS_REPORT, f), FALSE }
+#define HID_GAUGE_FIELD(f)      { #f, FIELD_OFFSET(HIDMINI_COUNTERS_REPORT, f), TRUE }
+
+//
+// Every ULONG of the report, in report order. BusBytes and
+// FramesByContacts are printed on their own.
+//
+static const HID_COUNTER HidCounters[] =
+{
+    HID_COUNTER_FIELD(Interrupts),
+    HID_COUNTER_FIELD(FramesDecoded),
+    HID_COUNTER_FIELD(FramesDropped),
+    HID_COUNTER_FIELD(NonTouchFrames),
+    HID_COUNTER_FIELD(SpbFailures),
+    HID_COUNTER_FIELD(AsyncFailures),
+    HID_COUNTER_FIELD(BusOperations),
+    HID_COUNTER_FIELD(ReportsCompleted),
+    HID_COUNTER_FIELD(ContactsReported),
+    HID_COUNTER_FIELD(FramesSuppressed),
+    HID_COUNTER_FIELD(FrameRereads),
+    HID_COUNTER_FIELD(CorruptFrames),
+    HID_COUNTER_FIELD(Resumes),
+    HID_GAUGE_FIELD(ResumeArmUs),
+    HID_GAUGE_FIELD(ResumeReportUs),
+    HID_COUNTER_FIELD(DozeEntries),
+    HID_COUNTER_FIELD(DozeExits),
+    HID_GAUGE_FIELD(WakeReportUs),
+    HID_GAUGE_FIELD(MaxWakeReportUs),
+    HID_COUNTER_FIELD(LiftsLost),
+    HID_COUNTER_FIELD(ShortFrames),
+};
+
+static ULONG
+HidCounterValue(
+    _In_ const HIDMINI_COUNTERS_REPORT* Report,
+    _In_ LONG Offset
+)
+{
+    ULONG value;
+
+    RtlCopyMemory(&value, (const UCHAR*)Report + Offset, sizeof(value));
+    return value;
+}
+
+//
+// Prints Newer, or Newer less Older when Older is given. Unsigned
+// subtraction keeps the difference right across a wrap.
+//
+static VOID
+HidCountersPrint(
+    _In_ const HIDMINI_COUNTERS_REPORT* Newer,
+    _In_opt_ const HIDMINI_COUNTERS_REPORT* Older,
+    _In_ double Interval
+)
+{
+    ULONG maxContacts = min(Newer->MaxContacts, HIDMINI_MAX_CONTACTS);
+
+    printf("{\"delta\":%s", Older != NULL ? "true" : "false");
+    if (Interval > 0.0)
+        printf(",\"interval_s\":%.3f", Interval);
+
+    for (ULONG i = 0; i < ARRAYSIZE(HidCounters); i++)
+    {
+        ULONG value = HidCounterValue(Newer, HidCounters[i].Offset);
+
+        if (Older != NULL && !HidCounters[i].Gauge)
+            value -= HidCounterValue(Older, HidCounters[i].Offset);
+
+        printf(",\"%s\":%lu", HidCounters[i].Name, (unsigned long)value);
+    }
+
+    printf(",\"BusBytes\":%llu",
+           (unsigned long long)(Newer->BusBytes - (Older != NULL ? Older->BusBytes : 0)));
+
+    printf(",\"FramesByContacts\":[");
+    for (ULONG i = 0; i <= maxContacts; i++)
+    {
+        ULONG value = Newer->FramesByContacts[i];
+
+        if (Older != NULL)
+            value -= Older->FramesByContacts[i];
+
+        printf("%s%lu", i != 0 ? "," : "", (unsigned long)value);
+    }
+    printf("]}\n");
+}
+
+static BOOLEAN
+HidCountersLoad(
+    _In_ const char* Path,
+    _Out_ PHIDMINI_COUNTERS_REPORT Report
+)
+{
+    FILE* file = strcmp(Path, "-") == 0 ? stdin : fopen(Path, "rb");
+    BOOLEAN ok;
+
+    if (file == NULL)
+    {
+        perror(Path);
+        return FALSE;
+    }
+
+    ok = HidFeatureLoad(file, Report, sizeof(HIDMINI_COUNTERS_REPORT)) == sizeof(HIDMINI_COUNTERS_REPORT) &&
+         HidFeatureCheck((const UCHAR*)Report, HIDMINI_CONTROL_CODE_READ_COUNTERS);
+
+    if (file != stdin)
+        fclose(file);
+
+    if (!ok)
+        fprintf(stderr, "%s: not a counters report\n", Path);
+
+    return ok;
+}
+
+static BOOLEAN
+HidCountersRead(
+    _In_ int Device,
+    _Out_ PHIDMINI_COUNTERS_REPORT Report
+)
+{
+    HIDMINI_CONTROL_INFO control = { 0 };
+
+    control.ReportId = CONTROL_COLLECTION_REPORT_ID;
+    control.ControlCode = HIDMINI_CONTROL_CODE_READ_COUNTERS;
+
+    return HidFeatureRequest(Device, &control, Report, sizeof(HIDMINI_COUNTERS_REPORT));
+}
+
+static int
+HidCountersUsage(VOID)
+{
+    fprintf(stderr,
+            "usage: hidcounters [-i seconds] <hidraw device>\n"
+            "       hidcounters <report dump> [newer report dump]\n");
+    return 2;
+}
+
+int
+main(int argc, char** argv)
+{
+    HIDMINI_COUNTERS_REPORT older;
+    HIDMINI_COUNTERS_REPORT newer;
+    double interval = 0.0;
+    int device;
+    int arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-i") == 0)
+    {
+        interval = strtod(argv[arg + 1], NULL);
+        arg += 2;
+    }
+
+    if (arg >= argc)
+        return HidCountersUsage();
+
+    if (strncmp(argv[arg], HID_FEATURE_DEVICE_PREFIX, strlen(HID_FEATURE_DEVICE_PREFIX)) != 0)
+    {
+        if (interval > 0.0 || argc - arg > 2)
+            return HidCountersUsage();
+
+        if (!HidCountersLoad(argv[arg], &newer))
+            return 1;
+
+        if (arg + 1 == argc)
+        {
+            HidCountersPrint(&newer, NULL, 0.0);
+            return 0;
+        }
+
+        older = newer;
+        if (!HidCountersLoad(argv[arg + 1], &newer))
+            return 1;
+
+        HidCountersPrint(&newer, &older, 0.0);
+        return 0;
+    }
+
+    if (argc - arg != 1)
+        return HidCountersUsage();
+
+    device = HidFeatureOpen(argv[arg]);
+    if (device < 0)
+        return 1;
+
+    if (!HidCountersRead(device, &newer))
+        goto fail;
+
+    if (interval > 0.0)
+    {
+        older = newer;
+        usleep((useconds_t)(interval * 1e6));
+
+        if (!HidCountersRead(device, &newer))
+            goto fail;
+    }
+
+    HidFeatureClose(device);
+    HidCountersPrint(&newer, interval > 0.0 ? &older : NULL, interval);
+    return 0;
+
+fail:
+    HidFeatureClose(device);
+    return 1;
+}
@@ -0,0 +1,190 @@
+/*++
+
+Module Name:
+
+    hidfeature.c
+
+Abstract:
+
+    Control collection access for the host tools; see hidfeature.h.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include "hidfeature.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/hidraw.h>
+#endif
+
+int
+HidFeatureOpen(
+    _In_ const char* Path
+)
+/*++
+
+  Routine Description:
+
+    Opens a hidraw node of the driver's control collection.
+
+  Return Value:
+
+    The device handle, or -1 with the reason printed.
+
+--*/
+{
+#ifdef __linux__
+    int device = open(Path, O_RDWR);
+
+    if (device < 0)
+        perror(Path);
+
+    return device;
+#else
+    fprintf(stderr, "%s: devices can only be opened on Linux, decode a report dump instead\n", Path);
+    return -1;
+#endif
+}
+
+VOID
+HidFeatureClose(
+    _In_ int Device
+)
+{
+#ifdef __linux__
+    close(Device);
+#else
+    UNREFERENCED_PARAMETER(Device);
+#endif
+}
+
+BOOLEAN
+HidFeatureSet(
+    _In_ int Device,
+    _In_ const HIDMINI_CONTROL_INFO* Control
+)
+/*++
+
+  Routine Description:
+
+    Sends Control to the control collection as a SetFeature.
+
+--*/
+{
+#ifdef __linux__
+    HIDMINI_CONTROL_INFO control = *Control;
+
+    if (ioctl(Device, HIDIOCSFEATURE(sizeof(control)), &control) < 0)
+    {
+        perror("SetFeature");
+        return FALSE;
+    }
+
+    return TRUE;
+#else
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(Control);
+    return FALSE;
+#endif
+}
+
+BOOLEAN
+HidFeatureRequest(
+    _In_ int Device,
+    _In_ const HIDMINI_CONTROL_INFO* Control,
+    _Out_writes_bytes_(Length) PVOID Report,
+    _In_ ULONG Length
+)
+/*++
+
+  Routine Description:
+
+    Sends Control as a SetFeature, then reads the report it selected with
+    a GetFeature of Length bytes. The driver only returns the selected
+    report to a buffer that can hold all of it, so Length must be the full
+    size of the expected report.
+
+  Return Value:
+
+    TRUE if a report of the expected type came back.
+
+--*/
+{
+#ifdef __linux__
+    PUCHAR report = (PUCHAR)Report;
+    int length;
+
+    if (!HidFeatureSet(Device, Control))
+        return FALSE;
+
+    RtlZeroMemory(report, Length);
+    report[0] = Control->ReportId;
+
+    length = ioctl(Device, HIDIOCGFEATURE(Length), report);
+    if (length < 0)
+    {
+        perror("GetFeature");
+        return FALSE;
+    }
+
+    if ((ULONG)length < Length || !HidFeatureCheck(report, Control->ControlCode))
+    {
+        fprintf(stderr, "GetFeature returned %d bytes, not the selected report\n", length);
+        return FALSE;
+    }
+
+    return TRUE;
+#else
+    UNREFERENCED_PARAMETER(Device);
+    UNREFERENCED_PARAMETER(Control);
+    UNREFERENCED_PARAMETER(Report);
+    UNREFERENCED_PARAMETER(Length);
+    return FALSE;
+#endif
+}
+
+ULONG
+HidFeatureLoad(
+    _In_ FILE* File,
+    _Out_writes_bytes_(Length) PVOID Report,
+    _In_ ULONG Length
+)
+/*++
+
+  Routine Description:
+
+    Reads the next report of Length bytes from a report dump.
+
+  Return Value:
+
+    Bytes read: Length, 0 at the end of the dump, or anything else if the
+    dump ends inside a report.
+
+--*/
+{
+    return (ULONG)fread(Report, 1, Length, File);
+}
+
+BOOLEAN
+HidFeatureCheck(
+    _In_reads_bytes_(2) const UCHAR* Report,
+    _In_ UCHAR ControlCode
+)
+/*++
+
+  Routine Description:
+
+    Checks that a report came from the control collection in answer to
+    ControlCode. Every report the control codes select starts with the
+    report ID and the control code.
+
+--*/
+{
+    return Report[0] == CONTROL_COLLECTION_REPORT_ID && Report[1] == ControlCode;
+}
@@ -0,0 +1,75 @@
+/*++
+
+Module Name:
+
+    hidfeature.h
+
+Abstract:
+
+    Access to the driver's control collection from the host tools. A
+    report is fetched the way any HID client does it: a SetFeature of a
+    HIDMINI_CONTROL_INFO selects what the next GetFeature on the same
+    handle returns. On Linux this goes through a hidraw node; elsewhere,
+    and for reports saved on the target by another HID client, the tools
+    decode a report dump from a file instead.
+
+    A report dump is the feature report exactly as GetFeature returned
+    it, report ID first.
+
+Environment:
+
+    User mode
+
+--*/
+
+#ifndef __HIDFEATURE_H__
+#define __HIDFEATURE_H__
+
+#include <stdio.h>
+#include <windows.h>
+
+#include "common.h"
+
+//
+// Sources whose path starts with this are opened as a device.
+//
+#define HID_FEATURE_DEVICE_PREFIX   "/dev/"
+
+int
+HidFeatureOpen(
+    _In_ const char* Path
+);
+
+VOID
+HidFeatureClose(
+    _In_ int Device
+);
+
+BOOLEAN
+HidFeatureSet(
+    _In_ int Device,
+    _In_ const HIDMINI_CONTROL_INFO* Control
+);
+
+BOOLEAN
+HidFeatureRequest(
+    _In_ int Device,
+    _In_ const HIDMINI_CONTROL_INFO* Control,
+    _Out_writes_bytes_(Length) PVOID Report,
+    _In_ ULONG Length
+);
+
+ULONG
+HidFeatureLoad(
+    _In_ FILE* File,
+    _Out_writes_bytes_(Length) PVOID Report,
+    _In_ ULONG Length
+);
+
+BOOLEAN
+HidFeatureCheck(
+    _In_reads_bytes_(2) const UCHAR* Report,
+    _In_ UCHAR ControlCode
+);
+
+#endif // __HIDFEATURE_H__
@@ -0,0 +1,250 @@
+/*++
+
+Module Name:
+
+    hidflight.c
+
+Abstract:
+
+    Dumps and decodes the driver's flight recorder. Reports are requested
+    from sequence 0 and then from one past the last record returned, until
+    a report comes back empty or reaches the records written before the
+    dump started, so a busy device cannot keep the dump going forever.
+
+    Each record is printed as one JSON object:
+
+        {"sequence":S,"gap":G,"timestamp":T,"time_us":U,
+         "spb_status":"0x...","status":"0x..","contacts":[[id,x,y],...]}
+
+    gap counts the records missing just before this one, overwritten or
+    being written when their report was filled. time_us is from the first
+    record printed. The contacts are the raw controller track ids and
+    coordinates, before any transform.
+
+    Usage: hidflight [-w report dump] <hidraw device>
+           hidflight <report dump>
+
+    -w saves the reports as read, to be decoded again later. A dump of
+    "-" is read from standard input.
+
+Environment:
+
+    User mode
+
+--*/
+
+#include "hidfeature.h"
+
+typedef struct _HID_FLIGHT_DECODER
+{
+    ULONGLONG               FirstTimestamp;
+    ULONG                   LastSequence;
+    ULONG                   Records;
+} HID_FLIGHT_DECODER, *PHID_FLIGHT_DECODER;
+
+static VOID
+HidFlightPrint(
+    _Inout_ PHID_FLIGHT_DECODER Decoder,
+    _In_ const HIDMINI_FLIGHT_RECORDER_REPORT* Report
+)
+{
+    for (ULONG i = 0; i < min(Report->RecordCount, HIDMINI_FLIGHT_RECORDS_PER_REPORT); i++)
+    {
+        const HIDMINI_FLIGHT_RECORD* record = &Report->Records[i];
+        ULONG gap = 0;
+        double us = 0.0;
+
+        //
+        // Reports overlap when asked for the same sequence twice; print
+        // each record once.
+        //
+        if (Decoder->Records != 0)
+        {
+            if (record->Sequence <= Decoder->LastSequence)
+                continue;
+
+            gap = record->Sequence - Decoder->LastSequence - 1;
+        }
+        else
+        {
+            Decoder->FirstTimestamp = record->Timestamp;
+        }
+
+        if (Report->PerfFrequency != 0)
+        {
+            us = (double)(LONGLONG)(record->Timestamp - Decoder->FirstTimestamp) * 1e6 /
+                 (double)Report->PerfFrequency;
+        }
+
+        printf("{\"sequence\":%lu,\"gap\":%lu,\"timestamp\":%llu,\"time_us\":%.1f,"
+               "\"spb_status\":\"0x%08lX\",\"status\":\"0x%02X\",\"contacts\":[",
+               (unsigned long)record->Sequence,
+               (unsigned long)gap,
+               (unsigned long long)record->Timestamp,
+               us,
+               (unsigned long)(ULONG)record->SpbStatus,
+               record->Status);
+
+        for (ULONG c = 0; c < min(record->ContactCount, HIDMINI_MAX_CONTACTS); c++)
+        {
+            ULONG contact = record->Contacts[c];
+
+            printf("%s[%lu,%lu,%lu]",
+                   c != 0 ? "," : "",
+                   (unsigned long)HIDMINI_FLIGHT_CONTACT_ID(contact),
+                   (unsigned long)HIDMINI_FLIGHT_CONTACT_X(contact),
+                   (unsigned long)HIDMINI_FLIGHT_CONTACT_Y(contact));
+        }
+
+        printf("]}\n");
+
+        Decoder->LastSequence = record->Sequence;
+        Decoder->Records++;
+    }
+}
+
+static int
+HidFlightDecodeDump(
+    _In_ const char* Path
+)
+{
+    HIDMINI_FLIGHT_RECORDER_REPORT report;
+    HID_FLIGHT_DECODER decoder = { 0 };
+    FILE* file = strcmp(Path, "-") == 0 ? stdin : fopen(Path, "rb");
+    ULONG reports = 0;
+    ULONG length;
+    int result = 0;
+
+    if (file == NULL)
+    {
+        perror(Path);
+        return 1;
+    }
+
+    while ((length = HidFeatureLoad(file, &report, sizeof(report))) == sizeof(report))
+    {
+        if (!HidFeatureCheck((const UCHAR*)&report, HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER))
+        {
+            fprintf(stderr, "%s: not a flight recorder report\n", Path);
+            result = 1;
+            break;
+        }
+
+        HidFlightPrint(&decoder, &report);
+        reports++;
+    }
+
+    if (result == 0 && (reports == 0 || length != 0))
+    {
+        fprintf(stderr, "%s: %s\n", Path,
+                reports == 0 ? "no flight recorder reports" : "ends inside a report");
+        result = 1;
+    }
+
+    if (file != stdin)
+        fclose(file);
+
+    return result;
+}
+
+static int
+HidFlightDumpDevice(
+    _In_ const char* Path,
+    _In_opt_ const char* DumpPath
+)
+{
+    HIDMINI_FLIGHT_RECORDER_REPORT report;
+    HIDMINI_CONTROL_INFO control = { 0 };
+    HID_FLIGHT_DECODER decoder = { 0 };
+    FILE* dump = NULL;
+    ULONG end = 0;
+    int device;
+    int result = 1;
+
+    device = HidFeatureOpen(Path);
+    if (device < 0)
+        return 1;
+
+    if (DumpPath != NULL)
+    {
+        dump = fopen(DumpPath, "wb");
+        if (dump == NULL)
+        {
+            perror(DumpPath);
+            goto exit;
+        }
+    }
+
+    control.ReportId = CONTROL_COLLECTION_REPORT_ID;
+    control.ControlCode = HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER;
+    control.u.FlightRecorder.Sequence = 0;
+
+    for (;;)
+    {
+        if (!HidFeatureRequest(device, &control, &report, sizeof(report)))
+            goto exit;
+
+        if (end == 0)
+            end = report.NextSequence;
+
+        if (report.RecordCount == 0)
+            break;
+
+        if (dump != NULL && fwrite(&report, sizeof(report), 1, dump) != 1)
+        {
+            perror(DumpPath);
+            goto exit;
+        }
+
+        HidFlightPrint(&decoder, &report);
+
+        control.u.FlightRecorder.Sequence =
+            report.Records[min(report.RecordCount, HIDMINI_FLIGHT_RECORDS_PER_REPORT) - 1].Sequence + 1;
+
+        if (control.u.FlightRecorder.Sequence >= end)
+            break;
+    }
+
+    result = 0;
+
+exit:
+    if (dump != NULL && fclose(dump) != 0)
+    {
+        perror(DumpPath);
+        result = 1;
+    }
+    HidFeatureClose(device);
+    return result;
+}
+
+int
+main(int argc, char** argv)
+{
+    const char* dumpPath = NULL;
+    int arg = 1;
+
+    if (arg + 1 < argc && strcmp(argv[arg], "-w") == 0)
+    {
+        dumpPath = argv[arg + 1];
+        arg += 2;
+    }
+
+    if (argc - arg != 1)
+    {
+        fprintf(stderr,
+                "usage: hidflight [-w report dump] <hidraw device>\n"
+                "       hidflight <report dump>\n");
+        return 2;
+    }
+
+    if (strncmp(argv[arg], HID_FEATURE_DEVICE_PREFIX, strlen(HID_FEATURE_DEVICE_PREFIX)) == 0)
+        return HidFlightDumpDevice(argv[arg], dumpPath);
+
+    if (dumpPath != NULL)
+    {
+        fprintf(stderr, "-w only applies when reading from a device\n");
+        return 2;
+    }
+
+    return HidFlightDecodeDump(argv[arg]);
+}
@@ -27,8 +27,10 @@ Environment:
 // defined especially to handle such requests.
 //
 #define  HIDMINI_CONTROL_CODE_SET_ATTRIBUTES              0x00
-#define  HIDMINI_CONTROL_CODE_DUMMY1                      0x01
-#define  HIDMINI_CONTROL_CODE_DUMMY2                      0x02
+#define  HIDMINI_CONTROL_CODE_READ_LATENCY                0x01
+#define  HIDMINI_CONTROL_CODE_READ_COUNTERS               0x02
+#define  HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER        0x03
+#define  HIDMINI_CONTROL_CODE_CAPTURE                     0x04
 
 //
 // This is the report id of the collection to which the control codes are sent
@@ -36,6 +38,54 @@ Environment:
 #define CONTROL_COLLECTION_REPORT_ID                      0x54
 #define TEST_COLLECTION_REPORT_ID                         0x02
 
+//
+// Stages of the interrupt-to-report path that the driver keeps latency
+// histograms for. Select one with HIDMINI_CONTROL_CODE_READ_LATENCY, then
+// read it back as a HIDMINI_LATENCY_REPORT with Hid_GetFeature() on
+// CONTROL_COLLECTION_REPORT_ID.
+//
+#define HIDMINI_LATENCY_STAGE_BUS         0   // ISR entry until the frame has been read
+#define HIDMINI_LATENCY_STAGE_DECODE      1   // decode and transform until queued
+#define HIDMINI_LATENCY_STAGE_PENDING     2   // queued until a pending read takes it
+#define HIDMINI_LATENCY_STAGE_TOTAL       3   // ISR entry until the read completes
+#define HIDMINI_LATENCY_STAGE_COUNT       4
+
+//
+// Bucket 0 counts samples below 1us, bucket n counts [2^(n-1), 2^n) us and
+// the last bucket counts everything longer.
+//
+#define HIDMINI_LATENCY_BUCKETS           24
+
+//
+// Largest contact count HIDMINI_COUNTERS_REPORT keeps a frame count for.
+//
+#define HIDMINI_MAX_CONTACTS              10
+
+//
+// Flight recorder records returned per HIDMINI_FLIGHT_RECORDER_REPORT, and
+// the layout of each packed contact in HIDMINI_FLIGHT_RECORD: the raw
+// controller track id and coordinates, before any transform.
+//
+#define HIDMINI_FLIGHT_RECORDS_PER_REPORT 8
+
+#define HIDMINI_FLIGHT_CONTACT_ID(c)      (((c) >> 28) & 0x0F)
+#define HIDMINI_FLIGHT_CONTACT_X(c)       (((c) >> 14) & 0x3FFF)
+#define HIDMINI_FLIGHT_CONTACT_Y(c)       ((c) & 0x3FFF)
+
+//
+// Modes of HIDMINI_CONTROL_CODE_CAPTURE. Capture streams the raw bytes
+// read from the controller: START discards anything captured before and
+// begins recording, READ has the next GetFeature from the same handle
+// return the frames recorded from the given sequence on as a
+// HIDMINI_CAPTURE_REPORT.
+//
+#define HIDMINI_CAPTURE_STOP              0
+#define HIDMINI_CAPTURE_START             1
+#define HIDMINI_CAPTURE_READ              2
+
+#define HIDMINI_CAPTURE_FRAME_BYTES       84  // status byte and ten point records, padded
+#define HIDMINI_CAPTURE_FRAMES_PER_REPORT 4
+
 #define MAXIMUM_STRING_LENGTH           (126 * sizeof(WCHAR))
 #define VHIDMINI_MANUFACTURER_STRING    L"UMDF Virtual hidmini device Manufacturer string"  
 #define VHIDMINI_PRODUCT_STRING         L"UMDF Virtual hidmini device Product string"  
@@ -71,6 +121,18 @@ typedef struct _HIDMINI_CONTROL_INFO {
     //
     union {
         MY_DEVICE_ATTRIBUTES Attributes;
+        struct {
+            UCHAR Stage;    // HIDMINI_LATENCY_STAGE_*
+            UCHAR Reset;    // clear the histogram once selected
+        } Latency;
+        struct {
+            ULONG Sequence; // first record to return, 0 for the oldest
+        } FlightRecorder;
+        struct {
+            UCHAR Mode;     // HIDMINI_CAPTURE_*
+            UCHAR Reserved[3];
+            ULONG Sequence; // READ: first frame to return, 0 for the first since START
+        } Capture;
         struct {
             ULONG Dummy1;
             ULONG Dummy2;
@@ -79,6 +141,186 @@ typedef struct _HIDMINI_CONTROL_INFO {
     
 } HIDMINI_CONTROL_INFO, * PHIDMINI_CONTROL_INFO;
 
+//
+// Feature report returned for HIDMINI_CONTROL_CODE_READ_LATENCY. Times are
+// in microseconds.
+//
+typedef struct _HIDMINI_LATENCY_REPORT {
+
+    UCHAR       ReportId;
+
+    UCHAR       ControlCode;
+
+    UCHAR       Stage;
+
+    UCHAR       BucketCount;
+
+    ULONG       Count;
+
+    ULONG       MaxUs;
+
+    ULONGLONG   SumUs;
+
+    ULONG       Buckets[HIDMINI_LATENCY_BUCKETS];
+
+} HIDMINI_LATENCY_REPORT, *PHIDMINI_LATENCY_REPORT;
+
+//
+// Feature report returned for HIDMINI_CONTROL_CODE_READ_COUNTERS. The
+// counters run from device start and wrap; readers should work with
+// differences between snapshots.
+//
+typedef struct _HIDMINI_COUNTERS_REPORT {
+
+    UCHAR       ReportId;
+
+    UCHAR       ControlCode;
+
+    UCHAR       MaxContacts;        // entries in FramesByContacts minus one
+
+    UCHAR       Reserved;
+
+    ULONG       Interrupts;
+
+    ULONG       FramesDecoded;
+
+    ULONG       FramesDropped;      // overwritten on the ring before a read took them
+
+    ULONG       NonTouchFrames;     // status byte without the touch event bit
+
+    ULONG       SpbFailures;        // failed synchronous transfers
+
+    ULONG       AsyncFailures;      // failed asynchronous frame reads
+
+    ULONG       BusOperations;
+
+    ULONGLONG   BusBytes;
+
+    ULONG       ReportsCompleted;
+
+    ULONG       ContactsReported;   // sum of contacts over all decoded frames
+
+    ULONG       FramesByContacts[HIDMINI_MAX_CONTACTS + 1];
+
+    ULONG       FramesSuppressed;   // held back by the jitter filter as unchanged
+
+    ULONG       FrameRereads;       // frames read again after a checksum mismatch
+
+    ULONG       CorruptFrames;      // frames dropped after failing the re-read too
+
+    ULONG       Resumes;            // D0 entries
+
+    ULONG       ResumeArmUs;        // last D0 entry to interrupt armed
+
+    ULONG       ResumeReportUs;     // last D0 entry to first report completed
+
+    ULONG       DozeEntries;        // controller put in doze by the idle governor
+
+    ULONG       DozeExits;          // woken by a touch
+
+    ULONG       WakeReportUs;       // last waking interrupt to first report completed
+
+    ULONG       MaxWakeReportUs;
+
+    ULONG       LiftsLost;          // lifts dropped with an overwritten report
+
+    ULONG       ShortFrames;        // more contacts than fetched after the clear
+
+} HIDMINI_COUNTERS_REPORT, *PHIDMINI_COUNTERS_REPORT;
+
+//
+// One frame read from the controller, as kept by the flight recorder.
+// Sequence numbers start at 1 and increase by one per record.
+//
+typedef struct _HIDMINI_FLIGHT_RECORD {
+
+    ULONGLONG   Timestamp;          // performance counter at interrupt
+
+    ULONG       Sequence;
+
+    LONG        SpbStatus;          // NTSTATUS of the frame read
+
+    UCHAR       Status;             // status byte at TOUCH_INFO_ADDR
+
+    UCHAR       ContactCount;       // valid entries in Contacts
+
+    UCHAR       Reserved[6];
+
+    ULONG       Contacts[HIDMINI_MAX_CONTACTS];
+
+} HIDMINI_FLIGHT_RECORD, *PHIDMINI_FLIGHT_RECORD;
+
+//
+// Feature report returned for HIDMINI_CONTROL_CODE_READ_FLIGHT_RECORDER.
+// Records are in sequence order; records overwritten or being written
+// while the report was filled are left out. To dump the recorder, start
+// at sequence 0 and ask again from the last returned sequence plus one
+// until RecordCount comes back zero.
+//
+typedef struct _HIDMINI_FLIGHT_RECORDER_REPORT {
+
+    UCHAR       ReportId;
+
+    UCHAR       ControlCode;
+
+    UCHAR       RecordCount;
+
+    UCHAR       Reserved;
+
+    ULONG       NextSequence;       // sequence the next record will get
+
+    ULONG       Depth;              // records the recorder holds
+
+    ULONGLONG   PerfFrequency;      // performance counter ticks per second
+
+    HIDMINI_FLIGHT_RECORD Records[HIDMINI_FLIGHT_RECORDS_PER_REPORT];
+
+} HIDMINI_FLIGHT_RECORDER_REPORT, *PHIDMINI_FLIGHT_RECORDER_REPORT;
+
+//
+// One frame exactly as read from TOUCH_INFO_ADDR: the status byte followed
+// by Length - 1 bytes of point records.
+//
+typedef struct _HIDMINI_CAPTURE_FRAME {
+
+    ULONGLONG   Timestamp;          // performance counter at interrupt
+
+    ULONG       Sequence;
+
+    UCHAR       Length;
+
+    UCHAR       Reserved[3];
+
+    UCHAR       Bytes[HIDMINI_CAPTURE_FRAME_BYTES];
+
+} HIDMINI_CAPTURE_FRAME, *PHIDMINI_CAPTURE_FRAME;
+
+//
+// Feature report returned for HIDMINI_CAPTURE_READ. Frames are consecutive
+// in sequence; Dropped counts the frames from the sequence asked for that
+// were overwritten before they could be read. Each reader keeps its own
+// position: the next READ asks for NextSequence.
+//
+typedef struct _HIDMINI_CAPTURE_REPORT {
+
+    UCHAR       ReportId;
+
+    UCHAR       ControlCode;
+
+    UCHAR       FrameCount;
+
+    UCHAR       Reserved;
+
+    ULONG       Dropped;
+
+    ULONG       NextSequence;       // sequence to ask for in the next READ
+
+    ULONGLONG   PerfFrequency;      // performance counter ticks per second
+
+    HIDMINI_CAPTURE_FRAME Frames[HIDMINI_CAPTURE_FRAMES_PER_REPORT];
+
+} HIDMINI_CAPTURE_REPORT, *PHIDMINI_CAPTURE_REPORT;
+
 //
 // input from device to system
 //